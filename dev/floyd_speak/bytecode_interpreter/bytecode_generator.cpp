@@ -10,6 +10,7 @@
 
 #include "pass3.h"
 #include "floyd_interpreter.h"
+#include "host_functions.h"
 
 #include <cmath>
 #include <algorithm>
@@ -622,15 +623,43 @@ expression_gen_t bcgen_resolve_member_expression(bcgenerator_t& vm, const variab
 
 	auto body_acc = body;
 
-	const auto& parent_expr = bcgen_expression(vm, {}, e._input_exprs[0], body);
-	body_acc = parent_expr._body;
-
 	const auto& struct_def = e._input_exprs[0].get_output_type().get_struct();
 	int index = find_struct_member_index(struct_def, e._variable_name);
 	QUARK_ASSERT(index != -1);
 
+	//	v[i].member on a vector with struct columns: read the member's column, don't make the struct.
+	const auto& struct_expr = e._input_exprs[0];
+	if(struct_expr._operation == expression_type::k_lookup_element && encode_as_vector_w_struct_columns(struct_expr._input_exprs[0].get_output_type())){
+		const auto& vector_expr = bcgen_expression(vm, {}, struct_expr._input_exprs[0], body_acc);
+		body_acc = vector_expr._body;
+
+		const auto& key_expr = bcgen_expression(vm, {}, struct_expr._input_exprs[1], body_acc);
+		body_acc = key_expr._body;
+
+		const auto column_reg = add_local_temp(body_acc, typeid_t::make_vector(e.get_output_type()), "temp: struct column");
+		body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_get_vector_struct_column,
+			column_reg,
+			vector_expr._out,
+			make_imm_int(index)
+		));
+
+		const auto target_reg2 = target_reg.is_empty() ? add_local_temp(body_acc, e.get_output_type(), "temp: resolve-member output") : target_reg;
+		body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_lookup_element_vector_w_inplace_elements,
+			target_reg2,
+			column_reg,
+			key_expr._out
+		));
+
+		QUARK_ASSERT(body_acc.check_invariant());
+		return { body_acc, target_reg2, intern_type(vm, *e._output_type) };
+	}
+
+	const auto& parent_expr = bcgen_expression(vm, {}, e._input_exprs[0], body);
+	body_acc = parent_expr._body;
+
 	const auto target_reg2 = target_reg.is_empty() ? add_local_temp(body_acc, e.get_output_type(), "temp: resolve-member output") : target_reg;
-	body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_get_struct_member,
+	const auto opcode = encode_as_struct_w_inplace_members(struct_expr.get_output_type()) ? bc_opcode::k_get_struct_w_inplace_members_member : bc_opcode::k_get_struct_member;
+	body_acc._instrs.push_back(bcgen_instruction_t(opcode,
 		target_reg2,
 		parent_expr._out,
 		make_imm_int(index)
@@ -665,6 +694,9 @@ expression_gen_t bcgen_lookup_element_expression(bcgenerator_t& vm, const variab
 			if(encode_as_vector_w_inplace_elements(parent_type)){
 				return bc_opcode::k_lookup_element_vector_w_inplace_elements;
 			}
+			else if(encode_as_vector_w_struct_columns(parent_type)){
+				return bc_opcode::k_lookup_element_vector_w_struct_columns;
+			}
 			else{
 				return bc_opcode::k_lookup_element_vector_w_external_elements;
 			}
@@ -836,6 +868,9 @@ bc_opcode convert_call_to_size_opcode(const typeid_t& arg1_type){
 		if(encode_as_vector_w_inplace_elements(arg1_type)){
 			return bc_opcode::k_get_size_vector_w_inplace_elements;
 		}
+		else if(encode_as_vector_w_struct_columns(arg1_type)){
+			return bc_opcode::k_get_size_vector_w_struct_columns;
+		}
 		else{
 			return bc_opcode::k_get_size_vector_w_external_elements;
 		}
@@ -866,6 +901,9 @@ bc_opcode convert_call_to_pushback_opcode(const typeid_t& arg1_type){
 		if(encode_as_vector_w_inplace_elements(arg1_type)){
 			return bc_opcode::k_pushback_vector_w_inplace_elements;
 		}
+		else if(encode_as_vector_w_struct_columns(arg1_type)){
+			return bc_opcode::k_pushback_vector_w_struct_columns;
+		}
 		else{
 			return bc_opcode::k_pushback_vector_w_external_elements;
 		}
@@ -878,6 +916,82 @@ bc_opcode convert_call_to_pushback_opcode(const typeid_t& arg1_type){
 	}
 }
 
+/*
+	A chain of map() / filter() calls, optionally ending with reduce(), that can run as one fused pipeline:
+
+		reduce(filter(map(v, f), p), init, g)
+
+	Fusing calls f(), p() and g() interleaved instead of one stage at a time, so all functions must be pure. The
+	function and init expressions must be plain loads or literals, so evaluating them early has no effects either.
+*/
+struct pipeline_match_t {
+	expression_t _source;
+
+	//	Innermost stage first.
+	std::vector<pipeline_stage> _stages;
+	std::vector<expression_t> _functions;
+
+	std::shared_ptr<expression_t> _init;
+};
+
+static bool is_simple_expression(const expression_t& e){
+	return e.get_operation() == expression_type::k_load2 || e.get_operation() == expression_type::k_literal;
+}
+
+static bool is_pipeline_function(const expression_t& e){
+	const auto type = e.get_output_type();
+	return is_simple_expression(e) && type.is_function() && type.get_function_pure() == epure::pure;
+}
+
+static std::shared_ptr<pipeline_match_t> match_pipeline(bcgenerator_t& vm, const expression_t& e){
+	std::vector<pipeline_stage> stages;
+	std::vector<expression_t> functions;
+	std::shared_ptr<expression_t> init;
+
+	const expression_t* source = &e;
+	if(
+		get_host_function_id(vm, e) == static_cast<int>(host_function_id::reduce)
+		&& e._input_exprs.size() == 4
+		&& e._input_exprs[1].get_output_type().is_vector()
+		&& is_simple_expression(e._input_exprs[2])
+		&& is_pipeline_function(e._input_exprs[3])
+	){
+		stages.push_back(pipeline_stage::k_reduce);
+		functions.push_back(e._input_exprs[3]);
+		init = std::make_shared<expression_t>(e._input_exprs[2]);
+		source = &e._input_exprs[1];
+	}
+
+	while(source->get_operation() == expression_type::k_call && stages.size() < k_pipeline_max_functions){
+		const auto id = get_host_function_id(vm, *source);
+		if(
+			(id == static_cast<int>(host_function_id::map) || id == static_cast<int>(host_function_id::filter))
+			&& source->_input_exprs.size() == 3
+			&& source->_input_exprs[1].get_output_type().is_vector()
+			&& is_pipeline_function(source->_input_exprs[2])
+		){
+			stages.push_back(id == static_cast<int>(host_function_id::map) ? pipeline_stage::k_map : pipeline_stage::k_filter);
+			functions.push_back(source->_input_exprs[2]);
+			source = &source->_input_exprs[1];
+		}
+		else{
+			break;
+		}
+	}
+
+	//	A single call gains nothing.
+	if(stages.size() < 2){
+		return nullptr;
+	}
+
+	std::reverse(stages.begin(), stages.end());
+	std::reverse(functions.begin(), functions.end());
+	return std::make_shared<pipeline_match_t>(pipeline_match_t{ *source, stages, functions, init });
+}
+
+//	Generates a call to host__pipeline() instead of the chain of calls.
+static expression_gen_t bcgen_pipeline_expression(bcgenerator_t& vm, const variable_address_t& target_reg, const expression_t& e, const pipeline_match_t& pipeline, const bcgen_body_t& body);
+
 expression_gen_t bcgen_call_expression(bcgenerator_t& vm, const variable_address_t& target_reg, const expression_t& e, const bcgen_body_t& body){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(e.check_invariant());
@@ -945,6 +1059,39 @@ expression_gen_t bcgen_call_expression(bcgenerator_t& vm, const variable_address
 	}
 
 
+	//	send("audio", m) -> send(channel_t(3), m): the name is resolved now, not on every send.
+	else if(host_function_id == static_cast<int>(host_function_id::send) && arg_count == 2){
+		//	send() uses a DYN-argument for the destination. Check it at compile time = now.
+		const auto dest_type = e._input_exprs[1].get_output_type();
+		if(dest_type.is_string() == false && dest_type != make__channel_t__type()){
+			quark::throw_runtime_error("Bad destination for send(). Require a process name or a channel_t.");
+		}
+
+		if(e._input_exprs[1].get_operation() == expression_type::k_literal && dest_type.is_string()){
+			const auto channel_names = get_channel_names(vm._ast_imm->_checked_ast._container_def);
+			const auto it = std::find(channel_names.begin(), channel_names.end(), e._input_exprs[1].get_literal().get_string_value());
+			if(it != channel_names.end()){
+				auto e2 = e;
+				e2._input_exprs[1] = expression_t::make_literal(
+					value_t::make_struct_value(make__channel_t__type(), { value_t::make_int(static_cast<int>(it - channel_names.begin())) })
+				);
+				return bcgen_call_expression(vm, target_reg, e2, body_acc);
+			}
+		}
+	}
+
+	//	a = reduce(filter(map(b, f), p), 0, g)
+	else if(
+		host_function_id == static_cast<int>(host_function_id::map)
+		|| host_function_id == static_cast<int>(host_function_id::filter)
+		|| host_function_id == static_cast<int>(host_function_id::reduce)
+	){
+		const auto pipeline = match_pipeline(vm, e);
+		if(pipeline){
+			return bcgen_pipeline_expression(vm, target_reg, e, *pipeline, body_acc);
+		}
+	}
+
 	//	Normal function call.
 	{
 		body_acc._instrs.push_back(bcgen_instruction_t(bc_opcode::k_push_frame_ptr, {}, {}, {} ));
@@ -975,6 +1122,38 @@ expression_gen_t bcgen_call_expression(bcgenerator_t& vm, const variable_address
 	}
 }
 
+static expression_gen_t bcgen_pipeline_expression(bcgenerator_t& vm, const variable_address_t& target_reg, const expression_t& e, const pipeline_match_t& pipeline, const bcgen_body_t& body){
+	const auto& globals = vm._call_stack[0]._body_ptr->_symbols._symbols;
+	const auto it = std::find_if(
+		globals.begin(),
+		globals.end(),
+		[](const std::pair<std::string, symbol_t>& symbol){ return symbol.first == k_pipeline_function_name; }
+	);
+	QUARK_ASSERT(it != globals.end());
+
+	const auto callee = expression_t::make_load2(
+		variable_address_t::make_variable_address(-1, static_cast<int>(it - globals.begin())),
+		std::make_shared<typeid_t>(it->second._value_type)
+	);
+
+	std::vector<value_t> stages;
+	for(const auto& stage: pipeline._stages){
+		stages.push_back(value_t::make_int(static_cast<int>(stage)));
+	}
+
+	std::vector<expression_t> args = {
+		pipeline._source,
+		expression_t::make_literal(value_t::make_vector_value(typeid_t::make_int(), stages))
+	};
+	for(int i = 0 ; i < k_pipeline_max_functions ; i++){
+		args.push_back(i < pipeline._functions.size() ? pipeline._functions[i] : expression_t::make_literal_int(0));
+	}
+	args.push_back(pipeline._init ? *pipeline._init : expression_t::make_literal_int(0));
+
+	const auto call = expression_t::make_call(callee, args, std::make_shared<typeid_t>(e.get_output_type()));
+	return bcgen_call_expression(vm, target_reg, call, body);
+}
+
 //??? Submit dest-register to all gen-functions = minimize temps.
 //??? Wrap itype in struct to make it typesafe.
 
@@ -1308,6 +1487,19 @@ expression_gen_t bcgen_arithmetic_expression(bcgenerator_t& vm, const variable_a
 				};
 				return conv_opcode.at(e._operation);
 			}
+			else if(encode_as_vector_w_struct_columns(type)){
+				static const std::map<expression_type, bc_opcode> conv_opcode = {
+					{ expression_type::k_arithmetic_add__2, bc_opcode::k_concat_vectors_w_struct_columns },
+					{ expression_type::k_arithmetic_subtract__2, bc_opcode::k_nop },
+					{ expression_type::k_arithmetic_multiply__2, bc_opcode::k_nop },
+					{ expression_type::k_arithmetic_divide__2, bc_opcode::k_nop },
+					{ expression_type::k_arithmetic_remainder__2, bc_opcode::k_nop },
+
+					{ expression_type::k_logical_and__2, bc_opcode::k_nop },
+					{ expression_type::k_logical_or__2, bc_opcode::k_nop }
+				};
+				return conv_opcode.at(e._operation);
+			}
 			else{
 				static const std::map<expression_type, bc_opcode> conv_opcode = {
 					{ expression_type::k_arithmetic_add__2, bc_opcode::k_concat_vectors_w_external_elements },
@@ -1492,6 +1684,24 @@ bc_static_frame_t make_frame(const bcgen_body_t& body, const std::vector<typeid_
 	return bc_static_frame_t(instrs2, symbols2, args);
 }
 
+//	A top-level "func" becomes a store of a function literal to an immutable global.
+static std::map<std::string, int> collect_global_functions(const body_t& globals){
+	std::map<std::string, int> result;
+	for(const auto& s: globals._statements){
+		if(std::holds_alternative<statement_t::store2_t>(s._contents)){
+			const auto& store = std::get<statement_t::store2_t>(s._contents);
+			const auto& e = store._expression;
+			if(store._dest_variable._parent_steps == 0 && e.get_operation() == expression_type::k_literal && e.get_literal().is_function()){
+				const auto& symbol = globals._symbols._symbols[store._dest_variable._index];
+				if(symbol.second._symbol_type == symbol_t::immutable_local){
+					result.insert({ symbol.first, e.get_literal().get_function_value() });
+				}
+			}
+		}
+	}
+	return result;
+}
+
 bc_program_t generate_bytecode(const semantic_ast_t& ast){
 	QUARK_ASSERT(ast.check_invariant());
 
@@ -1530,7 +1740,14 @@ bc_program_t generate_bytecode(const semantic_ast_t& ast){
 		}
 	}
 
-	const auto result = bc_program_t{ globals2, function_defs2, a._types, ast._checked_ast._software_system, ast._checked_ast._container_def };
+	const auto result = bc_program_t{
+		globals2,
+		function_defs2,
+		a._types,
+		ast._checked_ast._software_system,
+		ast._checked_ast._container_def,
+		collect_global_functions(ast._checked_ast._globals)
+	};
 
 //	QUARK_TRACE_SS("OUTPUT: " << json_to_pretty_string(bcprogram_to_json(result)));
 
@@ -9,11 +9,15 @@
 #include "bytecode_interpreter.h"
 
 #include "host_functions.h"
+#include "numeric_kernel.h"
 #include "text_parser.h"
 #include "ast_value.h"
 #include "ast_json.h"
 #include <sys/time.h>
 #include <algorithm>
+#include "immer/vector_transient.hpp"
+#include "immer/flex_vector_transient.hpp"
+#include "immer/algorithm.hpp"
 
 
 namespace floyd {
@@ -22,6 +26,9 @@ namespace floyd {
 void release_pod_external(bc_pod_value_t& value){
 	QUARK_ASSERT(value._external != nullptr);
 
+	if(is_small_string(value._external)){
+		return;
+	}
 	value._external->_rc--;
 	if(value._external->_rc == 0){
 		delete value._external;
@@ -29,6 +36,230 @@ void release_pod_external(bc_pod_value_t& value){
 	}
 }
 
+////////////////////////////////////////////			SMALL STRINGS
+
+
+#if FLOYD_SMALL_STRINGS
+static_assert(sizeof(bc_external_value_t*) == sizeof(uint64_t), "Small strings require 64-bit pointers.");
+#endif
+
+const bc_external_value_t* make_string_external(const char* s, size_t size){
+#if FLOYD_SMALL_STRINGS
+	if(size <= k_small_string_max_size){
+		uint64_t word = (size << 1) | 1;
+		std::memcpy(reinterpret_cast<char*>(&word) + 1, s, size);
+
+		const bc_external_value_t* result = nullptr;
+		std::memcpy(&result, &word, sizeof(result));
+		return result;
+	}
+#endif
+	return new bc_external_value_t{ std::string(s, size) };
+}
+
+const bc_external_value_t* make_string_external(std::string&& s){
+#if FLOYD_SMALL_STRINGS
+	if(s.size() <= k_small_string_max_size){
+		return make_string_external(s.data(), s.size());
+	}
+#endif
+	return new bc_external_value_t{ std::move(s) };
+}
+
+#if FLOYD_SMALL_STRINGS
+QUARK_UNIT_TEST("make_string_external()", "", "", ""){
+	const auto a = make_string_external("", 0);
+	const auto b = make_string_external("abcdefg", 7);
+	const auto c = make_string_external("abcdefgh", 8);
+	QUARK_UT_VERIFY(is_small_string(a) && get_string_view(a) == "");
+	QUARK_UT_VERIFY(is_small_string(b) && get_string_view(b) == "abcdefg");
+	QUARK_UT_VERIFY(is_small_string(c) == false && get_string_view(c) == "abcdefgh");
+	QUARK_UT_VERIFY(make_string_external(std::string("abc")) == make_string_external("abc", 3));
+
+	bc_pod_value_t pod{ ._external = c };
+	release_pod_external(pod);
+}
+
+QUARK_UNIT_TEST("make_string_external()", "", "embedded zero", ""){
+	const auto a = make_string_external("a\0b", 3);
+	QUARK_UT_VERIFY(get_string_view(a) == std::string_view("a\0b", 3));
+}
+#endif
+
+
+
+////////////////////////////////////////////			ROPE STRINGS
+
+
+const bc_external_value_t* make_string_external(const rope_t& rope){
+	if(rope.size() < k_rope_min_size){
+		std::string s;
+		s.reserve(rope.size());
+		immer::for_each_chunk(rope, [&](const char* first, const char* last){ s.append(first, last); });
+		return make_string_external(std::move(s));
+	}
+	else{
+		return new bc_external_value_t{ rope };
+	}
+}
+
+rope_string_t::rope_string_t(const rope_t& rope) :
+	_size(rope.size()),
+	_rope(std::make_shared<const rope_t>(rope)),
+	_flattened(false)
+{
+}
+
+//	Null if ext isn't a rope string or has been flattened.
+static std::shared_ptr<const rope_t> load_rope(const bc_external_value_t* const& ext){
+	return is_rope_string(ext) ? std::atomic_load(&ext->_rope_string->_rope) : nullptr;
+}
+
+rope_t get_string_rope(const bc_external_value_t* const& ext){
+	const auto rope = load_rope(ext);
+	if(rope){
+		return *rope;
+	}
+	else{
+		const auto s = get_string_view(ext);
+		return rope_t(s.begin(), s.end());
+	}
+}
+
+const bc_external_value_t* make_substring_external(const bc_external_value_t* const& ext, size_t begin, size_t end){
+	QUARK_ASSERT(begin <= end && end <= get_string_size(ext));
+
+	const auto rope = load_rope(ext);
+	if(rope){
+		if(end - begin >= k_rope_min_size){
+			return new bc_external_value_t{ rope->take(end).drop(begin) };
+		}
+		else{
+			std::string s;
+			s.reserve(end - begin);
+			immer::for_each_chunk(
+				rope->begin() + begin,
+				rope->begin() + end,
+				[&](const char* first, const char* last){ s.append(first, last); }
+			);
+			return make_string_external(std::move(s));
+		}
+	}
+	else{
+		const auto s = get_string_view(ext);
+		return make_string_external(s.data() + begin, end - begin);
+	}
+}
+
+const bc_external_value_t* concat_string_externals(const bc_external_value_t* const& a, const bc_external_value_t* const& b){
+	const auto size = get_string_size(a) + get_string_size(b);
+	if(size < k_rope_min_size){
+		const auto a2 = get_string_view(a);
+		const auto b2 = get_string_view(b);
+		std::string s;
+		s.reserve(size);
+		s.append(a2);
+		s.append(b2);
+		return make_string_external(std::move(s));
+	}
+	else{
+		return new bc_external_value_t{ get_string_rope(a) + get_string_rope(b) };
+	}
+}
+
+const bc_external_value_t* push_back_string_external(const bc_external_value_t* const& ext, char ch){
+	const auto size = get_string_size(ext) + 1;
+	if(size < k_rope_min_size){
+		const auto s = get_string_view(ext);
+		std::string s2;
+		s2.reserve(size);
+		s2.append(s);
+		s2.push_back(ch);
+		return make_string_external(std::move(s2));
+	}
+	else{
+		return new bc_external_value_t{ get_string_rope(ext).push_back(ch) };
+	}
+}
+
+std::string_view flatten_rope(const bc_external_value_t* ext){
+	QUARK_ASSERT(is_rope_string(ext));
+
+	auto& r = *ext->_rope_string;
+	std::call_once(r._flatten_once, [&](){
+		const auto rope = std::atomic_load(&r._rope);
+		std::string s;
+		s.reserve(r._size);
+		immer::for_each_chunk(*rope, [&](const char* first, const char* last){ s.append(first, last); });
+		r._flat = std::move(s);
+		r._flattened.store(true, std::memory_order_release);
+		std::atomic_store(&r._rope, std::shared_ptr<const rope_t>());
+	});
+	return std::string_view(r._flat);
+}
+
+QUARK_UNIT_TEST("concat_string_externals()", "", "", "long results are ropes"){
+	const auto a = make_string_external(std::string(1000, 'a'));
+	const auto b = make_string_external(std::string(100, 'b'));
+	const auto c = concat_string_externals(a, b);
+	QUARK_UT_VERIFY(is_rope_string(c));
+	QUARK_UT_VERIFY(get_string_size(c) == 1100);
+	QUARK_UT_VERIFY(get_string_char(c, 999) == 'a');
+	QUARK_UT_VERIFY(get_string_char(c, 1000) == 'b');
+
+	const auto d = push_back_string_external(c, 'x');
+	QUARK_UT_VERIFY(get_string_view(d) == std::string(1000, 'a') + std::string(100, 'b') + "x");
+
+	const auto e = make_substring_external(d, 990, 1010);
+	QUARK_UT_VERIFY(is_rope_string(e) == false);
+	QUARK_UT_VERIFY(get_string_view(e) == std::string(10, 'a') + std::string(10, 'b'));
+
+	const auto f = make_substring_external(c, 0, 1050);
+	QUARK_UT_VERIFY(is_rope_string(f));
+	QUARK_UT_VERIFY(get_string_view(f) == std::string(1000, 'a') + std::string(50, 'b'));
+
+	for(auto ext: { a, b, c, d, e, f }){
+		bc_pod_value_t pod{ ._external = ext };
+		release_pod_external(pod);
+	}
+}
+
+QUARK_UNIT_TEST("flatten_rope()", "", "", "the flat string replaces the rope"){
+	const auto a1 = make_string_external(std::string(1000, 'a'));
+	const auto a2 = make_string_external(std::string(100, 'b'));
+	const auto a = concat_string_externals(a1, a2);
+	QUARK_UT_VERIFY(std::atomic_load(&a->_rope_string->_rope) != nullptr);
+
+	QUARK_UT_VERIFY(get_string_view(a) == std::string(1000, 'a') + std::string(100, 'b'));
+	QUARK_UT_VERIFY(std::atomic_load(&a->_rope_string->_rope) == nullptr);
+
+	//	Still works without the rope.
+	QUARK_UT_VERIFY(get_string_size(a) == 1100);
+	QUARK_UT_VERIFY(get_string_char(a, 1000) == 'b');
+	const auto b = push_back_string_external(a, 'x');
+	QUARK_UT_VERIFY(is_rope_string(b) && get_string_size(b) == 1101 && get_string_char(b, 1100) == 'x');
+	const auto c = make_substring_external(a, 999, 1001);
+	QUARK_UT_VERIFY(get_string_view(c) == "ab");
+
+	for(auto ext: { a1, a2, a, b, c }){
+		bc_pod_value_t pod{ ._external = ext };
+		release_pod_external(pod);
+	}
+}
+
+QUARK_UNIT_TEST("concat_string_externals()", "", "", "short results are flat"){
+	const auto a = make_string_external("abc", 3);
+	const auto b = make_string_external("defgh", 5);
+	const auto c = concat_string_externals(a, b);
+	QUARK_UT_VERIFY(is_small_string(c) == false && is_rope_string(c) == false);
+	QUARK_UT_VERIFY(get_string_view(c) == "abcdefgh");
+
+	bc_pod_value_t pod{ ._external = c };
+	release_pod_external(pod);
+}
+
+
+
 ////////////////////////////////////////////			bc_value_t
 
 
@@ -55,7 +286,7 @@ bc_value_t::bc_value_t(const bc_value_t& other) :
 	QUARK_ASSERT(other.check_invariant());
 
 	if(encode_as_external(_type)){
-		_pod._external->_rc++;
+		retain_external(_pod._external);
 	}
 
 	QUARK_ASSERT(check_invariant());
@@ -178,15 +409,33 @@ bc_value_t::bc_value_t(double value) :
 bc_value_t bc_value_t::make_string(const std::string& v){
 	return bc_value_t{ v };
 }
+bc_value_t bc_value_t::make_string(std::string&& v){
+	return bc_value_t{ std::move(v) };
+}
+bc_value_t bc_value_t::make_string_from_external(const bc_external_value_t* ext){
+	QUARK_ASSERT(ext != nullptr);
+
+	bc_value_t result;
+	result._type = typeid_t::make_string();
+	result._pod._external = ext;
+	QUARK_ASSERT(result.check_invariant());
+	return result;
+}
 std::string bc_value_t::get_string_value() const{
 	QUARK_ASSERT(check_invariant());
 
-	return _pod._external->_string;
+	return std::string(get_string_view(_pod._external));
 }
 bc_value_t::bc_value_t(const std::string& value) :
 	_type(typeid_t::make_string())
 {
-	_pod._external = new bc_external_value_t{value};
+	_pod._external = make_string_external(value.data(), value.size());
+	QUARK_ASSERT(check_invariant());
+}
+bc_value_t::bc_value_t(std::string&& value) :
+	_type(typeid_t::make_string())
+{
+	_pod._external = make_string_external(std::move(value));
 	QUARK_ASSERT(check_invariant());
 }
 
@@ -243,11 +492,33 @@ bc_value_t::bc_value_t(const typeid_t& type_id) :
 bc_value_t bc_value_t::make_struct_value(const typeid_t& struct_type, const std::vector<bc_value_t>& values){
 	return bc_value_t{ struct_type, values, true };
 }
-const std::vector<bc_value_t>& bc_value_t::get_struct_value() const {
+bc_value_t bc_value_t::make_struct_value(const typeid_t& struct_type, const std::vector<bc_inplace_value_t>& values){
+	QUARK_ASSERT(struct_type.check_invariant());
+	QUARK_ASSERT(encode_as_struct_w_inplace_members(struct_type));
+
+	bc_value_t temp;
+	temp._type = struct_type;
+	temp._pod._external = new bc_external_value_t{ struct_type, values };
+	QUARK_ASSERT(temp.check_invariant());
+	return temp;
+}
+std::vector<bc_value_t> bc_value_t::get_struct_value() const {
 	QUARK_ASSERT(check_invariant());
 	QUARK_ASSERT(_type.is_struct());
 
-	return _pod._external->_struct_members;
+	if(encode_as_struct_w_inplace_members(_type)){
+		const auto& members = _type.get_struct()._members;
+		const auto& values = _pod._external->_struct_w_inplace_members;
+		std::vector<bc_value_t> result;
+		result.reserve(values.size());
+		for(size_t i = 0 ; i < values.size() ; i++){
+			result.push_back(bc_value_t(members[i]._type, values[i]));
+		}
+		return result;
+	}
+	else{
+		return _pod._external->_struct_members;
+	}
 }
 bc_value_t::bc_value_t(const typeid_t& struct_type, const std::vector<bc_value_t>& values, bool struct_tag) :
 	_type(struct_type)
@@ -259,7 +530,17 @@ bc_value_t::bc_value_t(const typeid_t& struct_type, const std::vector<bc_value_t
 	}
 #endif
 
-	_pod._external = new bc_external_value_t{ struct_type, values, true };
+	if(encode_as_struct_w_inplace_members(struct_type)){
+		std::vector<bc_inplace_value_t> values2;
+		values2.reserve(values.size());
+		for(const auto& e: values){
+			values2.push_back(e._pod._inplace);
+		}
+		_pod._external = new bc_external_value_t{ struct_type, values2 };
+	}
+	else{
+		_pod._external = new bc_external_value_t{ struct_type, values, true };
+	}
 	QUARK_ASSERT(check_invariant());
 }
 
@@ -296,7 +577,7 @@ bc_value_t::bc_value_t(const typeid_t& type, const bc_pod_value_t& internals) :
 #endif
 
 	if(encode_as_external(_type)){
-		_pod._external->_rc++;
+		retain_external(_pod._external);
 	}
 	QUARK_ASSERT(check_invariant());
 }
@@ -318,7 +599,7 @@ bc_value_t::bc_value_t(const typeid_t& type, const bc_external_handle_t& handle)
 	QUARK_ASSERT(type.check_invariant());
 	QUARK_ASSERT(handle.check_invariant());
 
-	_pod._external->_rc++;
+	retain_external(_pod._external);
 
 	QUARK_ASSERT(check_invariant());
 }
@@ -362,7 +643,7 @@ bc_external_handle_t::bc_external_handle_t(const bc_external_handle_t& other) :
 {
 	QUARK_ASSERT(other.check_invariant());
 
-	_external->_rc++;
+	retain_external(_external);
 
 	QUARK_ASSERT(check_invariant());
 }
@@ -372,7 +653,7 @@ bc_external_handle_t::bc_external_handle_t(const bc_external_value_t* ext) :
 {
 	QUARK_ASSERT(ext != nullptr);
 
-	_external->_rc++;
+	retain_external(_external);
 
 	QUARK_ASSERT(check_invariant());
 }
@@ -383,7 +664,7 @@ bc_external_handle_t::bc_external_handle_t(const bc_value_t& value) :
 	QUARK_ASSERT(value.check_invariant());
 	QUARK_ASSERT(encode_as_external(value._type));
 
-	_external->_rc++;
+	retain_external(_external);
 
 	QUARK_ASSERT(check_invariant());
 }
@@ -407,6 +688,9 @@ bc_external_handle_t& bc_external_handle_t::operator=(const bc_external_handle_t
 bc_external_handle_t::~bc_external_handle_t(){
 	QUARK_ASSERT(check_invariant());
 
+	if(is_small_string(_external)){
+		return;
+	}
 	_external->_rc--;
 	if(_external->_rc == 0){
 		delete _external;
@@ -416,7 +700,7 @@ bc_external_handle_t::~bc_external_handle_t(){
 
 bool bc_external_handle_t::check_invariant() const {
 	QUARK_ASSERT(_external != nullptr);
-	QUARK_ASSERT(_external->check_invariant());
+	QUARK_ASSERT(is_small_string(_external) || _external->check_invariant());
 	return true;
 }
 
@@ -428,6 +712,26 @@ bool encode_as_vector_w_inplace_elements(const typeid_t& type){
 	return type.is_vector() && encode_as_inplace(type.get_vector_element_type());
 }
 
+bool encode_as_struct_w_inplace_members(const typeid_t& type){
+	if(type.is_struct() == false){
+		return false;
+	}
+	const auto& members = type.get_struct()._members;
+	if(members.empty()){
+		return false;
+	}
+	for(const auto& m: members){
+		if(encode_as_inplace(m._type) == false){
+			return false;
+		}
+	}
+	return true;
+}
+
+bool encode_as_vector_w_struct_columns(const typeid_t& type){
+	return type.is_vector() && encode_as_struct_w_inplace_members(type.get_vector_element_type());
+}
+
 bool encode_as_dict_w_inplace_values(const typeid_t& type){
 	return type.is_dict() && encode_as_inplace(type.get_dict_value_type());
 }
@@ -576,6 +880,12 @@ bool bc_external_value_t::check_invariant() const{
 		QUARK_ASSERT(_vector_w_inplace_elements.empty());
 		QUARK_ASSERT(_dict_w_external_values.size() == 0);
 		QUARK_ASSERT(_dict_w_inplace_values.size() == 0);
+		if(encode_as_struct_w_inplace_members(_debug_type)){
+			QUARK_ASSERT(_struct_members.empty());
+		}
+		else{
+			QUARK_ASSERT(_struct_w_inplace_members.empty());
+		}
 
 //				QUARK_ASSERT(_struct && _struct->check_invariant());
 	}
@@ -588,6 +898,13 @@ bool bc_external_value_t::check_invariant() const{
 		QUARK_ASSERT(_vector_w_inplace_elements.empty());
 		QUARK_ASSERT(_dict_w_external_values.size() == 0);
 		QUARK_ASSERT(_dict_w_inplace_values.size() == 0);
+		if(encode_as_vector_w_struct_columns(_debug_type)){
+			QUARK_ASSERT(_vector_w_external_elements.empty());
+			QUARK_ASSERT(_vector_w_struct_columns.size() == _debug_type.get_vector_element_type().get_struct()._members.size());
+		}
+		else{
+			QUARK_ASSERT(_vector_w_struct_columns.empty());
+		}
 	}
 	else if(encoding == value_encoding::k_external__vector_pod64){
 		QUARK_ASSERT(_string.empty());
@@ -626,6 +943,27 @@ bc_external_value_t::bc_external_value_t(const std::string& s) :
 	QUARK_ASSERT(check_invariant());
 }
 
+bc_external_value_t::bc_external_value_t(std::string&& s) :
+	_rc(1),
+#if DEBUG
+	_debug_type(typeid_t::make_string()),
+#endif
+	_string(std::move(s))
+{
+	QUARK_ASSERT(check_invariant());
+}
+
+bc_external_value_t::bc_external_value_t(const rope_t& rope) :
+	_rc(1),
+#if DEBUG
+	_debug_type(typeid_t::make_string()),
+#endif
+	_rope_string(std::make_unique<rope_string_t>(rope))
+{
+	QUARK_ASSERT(rope.size() >= k_rope_min_size);
+	QUARK_ASSERT(check_invariant());
+}
+
 bc_external_value_t::bc_external_value_t(const std::shared_ptr<json_t>& s) :
 	_rc(1),
 #if DEBUG
@@ -663,7 +1001,19 @@ bc_external_value_t::bc_external_value_t(const typeid_t& type, const std::vector
 	#endif
 	QUARK_ASSERT(check_invariant());
 }
-bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::vector<bc_external_handle_t>& s) :
+bc_external_value_t::bc_external_value_t(const typeid_t& type, const std::vector<bc_inplace_value_t>& s) :
+		_rc(1),
+#if DEBUG
+	_debug_type(type),
+#endif
+	_struct_w_inplace_members(s)
+{
+	QUARK_ASSERT(type.check_invariant());
+	QUARK_ASSERT(encode_as_struct_w_inplace_members(type));
+	QUARK_ASSERT(s.size() == type.get_struct()._members.size());
+	QUARK_ASSERT(check_invariant());
+}
+bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::flex_vector<bc_external_handle_t>& s) :
 	_rc(1),
 #if DEBUG
 	_debug_type(type),
@@ -678,7 +1028,7 @@ bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::vect
 	#endif
 	QUARK_ASSERT(check_invariant());
 }
-bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::vector<bc_inplace_value_t>& s) :
+bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::flex_vector<bc_inplace_value_t>& s) :
 	_rc(1),
 #if DEBUG
 	_debug_type(type),
@@ -688,6 +1038,24 @@ bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::vect
 	QUARK_ASSERT(type.check_invariant());
 	QUARK_ASSERT(check_invariant());
 }
+bc_external_value_t::bc_external_value_t(const typeid_t& type, const std::vector<bc_value_t>& columns) :
+	_rc(1),
+#if DEBUG
+	_debug_type(type),
+#endif
+	_vector_w_struct_columns(columns)
+{
+	QUARK_ASSERT(type.check_invariant());
+	QUARK_ASSERT(encode_as_vector_w_struct_columns(type));
+	#if QUARK_ASSERT_ON
+		for(const auto& e: columns){
+			QUARK_ASSERT(e.check_invariant());
+			QUARK_ASSERT(encode_as_vector_w_inplace_elements(e._type));
+			QUARK_ASSERT(e._pod._external->_vector_w_inplace_elements.size() == columns[0]._pod._external->_vector_w_inplace_elements.size());
+		}
+	#endif
+	QUARK_ASSERT(check_invariant());
+}
 bc_external_value_t::bc_external_value_t(const typeid_t& type, const immer::map<std::string, bc_external_handle_t>& s) :
 	_rc(1),
 #if DEBUG
@@ -726,11 +1094,18 @@ bool check_external_deep(const typeid_t& type, const bc_external_value_t* ext){
 	QUARK_ASSERT(type.check_invariant());
 	QUARK_ASSERT(encode_as_external(type));
 	QUARK_ASSERT(ext != nullptr);
+
+	if(is_small_string(ext)){
+		QUARK_ASSERT(type.is_string());
+		QUARK_ASSERT(get_string_view(ext).size() <= k_small_string_max_size);
+		return true;
+	}
 	QUARK_ASSERT(ext->_rc > 0);
 
 	const auto basetype = type.get_base_type();
 
 	if(basetype == base_type::k_struct){
+		QUARK_ASSERT(ext->_struct_w_inplace_members.empty() || encode_as_struct_w_inplace_members(type));
 		for(const auto& e: ext->_struct_members){
 			QUARK_ASSERT(e.check_invariant());
 		}
@@ -741,7 +1116,13 @@ bool check_external_deep(const typeid_t& type, const bc_external_value_t* ext){
 	}
 	else if(basetype == base_type::k_vector){
 		const auto& element_type  = type.get_vector_element_type();
-		if(encode_as_external(element_type)){
+		if(encode_as_vector_w_struct_columns(type)){
+			for(const auto& e: ext->_vector_w_struct_columns){
+				QUARK_ASSERT(e.check_invariant());
+			}
+			return true;
+		}
+		else if(encode_as_external(element_type)){
 			for(const auto& e: ext->_vector_w_external_elements){
 				QUARK_ASSERT(e.check_invariant());
 			}
@@ -781,6 +1162,79 @@ bool check_external_deep(const typeid_t& type, const bc_external_value_t* ext){
 
 
 
+//////////////////////////////////////		STRUCT COLUMNS
+
+
+bc_value_t make_vector_w_struct_columns(const typeid_t& element_type, const std::vector<bc_value_t>& columns){
+	QUARK_ASSERT(element_type.check_invariant());
+
+	const auto vector_type = typeid_t::make_vector(element_type);
+	QUARK_ASSERT(encode_as_vector_w_struct_columns(vector_type));
+
+	bc_value_t temp;
+	temp._type = vector_type;
+	temp._pod._external = new bc_external_value_t{vector_type, columns};
+	QUARK_ASSERT(temp.check_invariant());
+	return temp;
+}
+
+static const bc_external_value_t* get_element_external(const bc_value_t& e){
+	return e._pod._external;
+}
+static const bc_external_value_t* get_element_external(const bc_external_handle_t& e){
+	return e._external;
+}
+
+//	Splits struct values into columns. Works on immer::vector<bc_value_t> and immer::flex_vector<bc_external_handle_t>.
+template <typename ELEMENTS>
+bc_value_t make_struct_columns_from_elements(const typeid_t& element_type, const ELEMENTS& elements){
+	const auto& members = element_type.get_struct()._members;
+
+	std::vector<immer::flex_vector<bc_inplace_value_t>::transient_type> columns(members.size());
+	for(const auto& e: elements){
+		const auto& member_values = get_element_external(e)->_struct_w_inplace_members;
+		QUARK_ASSERT(member_values.size() == members.size());
+		for(size_t m = 0 ; m < members.size() ; m++){
+			columns[m].push_back(member_values[m]);
+		}
+	}
+
+	std::vector<bc_value_t> columns2;
+	for(size_t m = 0 ; m < members.size() ; m++){
+		columns2.push_back(make_vector(members[m]._type, columns[m].persistent()));
+	}
+	return make_vector_w_struct_columns(element_type, columns2);
+}
+
+bc_value_t get_struct_columns_element(const typeid_t& element_type, const bc_external_value_t* ext, size_t index){
+	QUARK_ASSERT(element_type.check_invariant());
+	QUARK_ASSERT(index < get_struct_columns_size(ext));
+
+	const auto& columns = ext->_vector_w_struct_columns;
+	std::vector<bc_inplace_value_t> member_values;
+	member_values.reserve(columns.size());
+	for(const auto& column: columns){
+		member_values.push_back(column._pod._external->_vector_w_inplace_elements[index]);
+	}
+	return bc_value_t::make_struct_value(element_type, member_values);
+}
+
+bc_value_t push_back_struct_columns(const typeid_t& element_type, const bc_external_value_t* ext, const bc_external_value_t* element){
+	QUARK_ASSERT(element_type.check_invariant());
+	QUARK_ASSERT(element != nullptr && element->_struct_w_inplace_members.size() == ext->_vector_w_struct_columns.size());
+
+	const auto& member_values = element->_struct_w_inplace_members;
+	return transform_struct_columns(
+		element_type,
+		ext,
+		[&](size_t member_index, const immer::flex_vector<bc_inplace_value_t>& column){
+			return column.push_back(member_values[member_index]);
+		}
+	);
+}
+
+
+
 const immer::vector<bc_value_t> get_vector(const bc_value_t& value){
 	QUARK_ASSERT(value.check_invariant());
 	QUARK_ASSERT(value._type.is_vector());
@@ -795,6 +1249,14 @@ const immer::vector<bc_value_t> get_vector(const bc_value_t& value){
 		}
 		return result;
 	}
+	else if(encode_as_vector_w_struct_columns(value._type)){
+		auto result = immer::vector<bc_value_t>().transient();
+		const auto size = get_struct_columns_size(value._pod._external);
+		for(size_t i = 0 ; i < size ; i++){
+			result.push_back(get_struct_columns_element(element_type, value._pod._external, i));
+		}
+		return result.persistent();
+	}
 	else{
 		immer::vector<bc_value_t> result;
 		for(const auto& e: value._pod._external->_vector_w_external_elements){
@@ -807,15 +1269,16 @@ const immer::vector<bc_value_t> get_vector(const bc_value_t& value){
 
 
 
-const immer::vector<bc_external_handle_t>* get_vector_external_elements(const bc_value_t& value){
+const immer::flex_vector<bc_external_handle_t>* get_vector_external_elements(const bc_value_t& value){
 	QUARK_ASSERT(value.check_invariant());
 	QUARK_ASSERT(value._type.is_vector());
 	QUARK_ASSERT(encode_as_vector_w_inplace_elements(value._type) == false);
+	QUARK_ASSERT(encode_as_vector_w_struct_columns(value._type) == false);
 
 	return &value._pod._external->_vector_w_external_elements;
 }
 
-const immer::vector<bc_inplace_value_t>* get_vector_inplace_elements(const bc_value_t& value){
+const immer::flex_vector<bc_inplace_value_t>* get_vector_inplace_elements(const bc_value_t& value){
 	QUARK_ASSERT(value.check_invariant());
 	QUARK_ASSERT(value._type.is_vector());
 	QUARK_ASSERT(encode_as_vector_w_inplace_elements(value._type) == true);
@@ -833,7 +1296,7 @@ bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_valu
 
 	const auto vector_type = typeid_t::make_vector(element_type);
 	if(encode_as_vector_w_inplace_elements(vector_type)){
-		immer::vector<bc_inplace_value_t> elements2;
+		immer::flex_vector<bc_inplace_value_t> elements2;
 		for(const auto& e: elements){
 			elements2 = elements2.push_back(e._pod._inplace);
 		}
@@ -844,8 +1307,11 @@ bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_valu
 		QUARK_ASSERT(temp.check_invariant());
 		return temp;
 	}
+	else if(encode_as_vector_w_struct_columns(vector_type)){
+		return make_struct_columns_from_elements(element_type, elements);
+	}
 	else{
-		immer::vector<bc_external_handle_t> elements2;
+		immer::flex_vector<bc_external_handle_t> elements2;
 		for(const auto& e: elements){
 			elements2 = elements2.push_back(bc_external_handle_t(e));
 		}
@@ -858,7 +1324,7 @@ bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_valu
 	}
 }
 
-bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_external_handle_t>& elements){
+bc_value_t make_vector(const typeid_t& element_type, const immer::flex_vector<bc_external_handle_t>& elements){
 	QUARK_ASSERT(element_type.check_invariant());
 #if QUARK_ASSERT_ON
 	for(const auto& e: elements) {
@@ -869,6 +1335,10 @@ bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_exte
 	const auto vector_type = typeid_t::make_vector(element_type);
 	QUARK_ASSERT(encode_as_vector_w_inplace_elements(vector_type) == false);
 
+	if(encode_as_vector_w_struct_columns(vector_type)){
+		return make_struct_columns_from_elements(element_type, elements);
+	}
+
 	bc_value_t temp;
 	temp._type = vector_type;
 	temp._pod._external = new bc_external_value_t{vector_type, elements};
@@ -876,7 +1346,7 @@ bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_exte
 	return temp;
 }
 
-bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_inplace_value_t>& elements){
+bc_value_t make_vector(const typeid_t& element_type, const immer::flex_vector<bc_inplace_value_t>& elements){
 	QUARK_ASSERT(element_type.check_invariant());
 
 	const auto vector_type = typeid_t::make_vector(element_type);
@@ -935,6 +1405,19 @@ const base_type lookup_full_basetype(const interpreter_t& vm, const bc_typeid_t&
 int get_global_n_pos(int n){
 	return k_frame_overhead + n;
 }
+std::vector<bc_value_t> copy_globals(const interpreter_t& vm){
+	QUARK_ASSERT(vm.check_invariant());
+
+	const auto& global_frame = vm._imm->_program._globals;
+	std::vector<bc_value_t> result;
+	for(int i = 0 ; i < global_frame._locals.size() ; i++){
+		//	Use the type of the frame's initial value, not the symbol's: internal symbols can differ.
+		const auto& type = global_frame._locals[i]._type;
+		result.push_back(vm._stack.load_value(get_global_n_pos(i), type));
+	}
+	return result;
+}
+
 int get_local_n_pos(int frame_pos, int n){
 	return frame_pos + n;
 }
@@ -997,7 +1480,6 @@ bc_value_t update_struct_member_shallow(interpreter_t& vm, const bc_value_t& obj
 	QUARK_ASSERT(member_name.empty() == false);
 	QUARK_ASSERT(new_value.check_invariant());
 
-	const auto& values = obj.get_struct_value();
 	const auto& struct_def = obj._type.get_struct();
 
 	int member_index = find_struct_member_index(struct_def, member_name);
@@ -1012,7 +1494,14 @@ bc_value_t update_struct_member_shallow(interpreter_t& vm, const bc_value_t& obj
 	const auto dest_member_entry = struct_def._members[member_index];
 #endif
 
-	auto values2 = values;
+	//	Structs with inplace members: copy the flat block, set one slot.
+	if(encode_as_struct_w_inplace_members(obj._type)){
+		auto values2 = obj._pod._external->_struct_w_inplace_members;
+		values2[member_index] = new_value._pod._inplace;
+		return bc_value_t::make_struct_value(obj._type, values2);
+	}
+
+	auto values2 = obj._pod._external->_struct_members;
 	values2[member_index] = new_value;
 
 	auto s2 = bc_value_t::make_struct_value(obj._type, values2);
@@ -1092,6 +1581,21 @@ bc_value_t update_vector_element(interpreter_t& vm, const bc_value_t vec, int64_
 			return s2;
 		}
 	}
+	else if(encode_as_vector_w_struct_columns(vec._type)){
+		if(lookup_index >= get_struct_columns_size(vec._pod._external)){
+			quark::throw_runtime_error("Vector lookup out of bounds.");
+		}
+		else{
+			const auto& member_values = value._pod._external->_struct_w_inplace_members;
+			return transform_struct_columns(
+				element_type,
+				vec._pod._external,
+				[&](size_t member_index, const immer::flex_vector<bc_inplace_value_t>& column){
+					return column.set(lookup_index, member_values[member_index]);
+				}
+			);
+		}
+	}
 	else{
 		const auto obj = vec;
 		auto v2 = *get_vector_external_elements(obj);
@@ -1277,10 +1781,10 @@ int bc_compare_struct_true_deep(const std::vector<bc_value_t>& left, const std::
 	return 0;
 }
 
-int bc_compare_vectors_obj(const immer::vector<bc_external_handle_t>& left, const immer::vector<bc_external_handle_t>& right, const typeid_t& type){
+int bc_compare_vectors_obj(const immer::flex_vector<bc_external_handle_t>& left, const immer::flex_vector<bc_external_handle_t>& right, const typeid_t& type){
 	QUARK_ASSERT(type.is_vector());
 
-	const auto& shared_count = std::min(left.size(), right.size());
+	const auto shared_count = std::min(left.size(), right.size());
 	const auto& element_type = typeid_t(type.get_vector_element_type());
 	for(int i = 0 ; i < shared_count ; i++){
 		const auto element_result = bc_compare_value_true_deep(bc_value_t(element_type, left[i]), bc_value_t(element_type, right[i]), element_type);
@@ -1325,19 +1829,57 @@ int compare_ints(const bc_inplace_value_t& left, const bc_inplace_value_t& right
 	}
 }
 int compare_doubles(const bc_inplace_value_t& left, const bc_inplace_value_t& right){
-	if(left._double < right._double){
-		return -1;
+	return compare_double_values(left._double, right._double);
+}
+
+int compare_inplace_values(const bc_inplace_value_t& left, const bc_inplace_value_t& right, const typeid_t& type){
+	if(type.is_bool()){
+		return compare_bools(left, right);
 	}
-	else if(left._double > right._double){
-		return 1;
+	else if(type.is_int()){
+		return compare_ints(left, right);
 	}
 	else{
+		QUARK_ASSERT(type.is_double());
+		return compare_doubles(left, right);
+	}
+}
+
+//	Same order as comparing the struct values one by one, without making them.
+int bc_compare_vectors_struct_columns(const bc_external_value_t* left, const bc_external_value_t* right, const typeid_t& type){
+	QUARK_ASSERT(encode_as_vector_w_struct_columns(type));
+
+	const auto left_size = get_struct_columns_size(left);
+	const auto right_size = get_struct_columns_size(right);
+	const auto shared_count = std::min(left_size, right_size);
+	const auto& left_columns = left->_vector_w_struct_columns;
+	const auto& right_columns = right->_vector_w_struct_columns;
+	for(size_t i = 0 ; i < shared_count ; i++){
+		for(size_t m = 0 ; m < left_columns.size() ; m++){
+			const auto diff = compare_inplace_values(
+				left_columns[m]._pod._external->_vector_w_inplace_elements[i],
+				right_columns[m]._pod._external->_vector_w_inplace_elements[i],
+				left_columns[m]._type.get_vector_element_type()
+			);
+			if(diff != 0){
+				return diff;
+			}
+		}
+	}
+	if(left_size == right_size){
 		return 0;
 	}
+	else if(left_size > right_size){
+		return -1;
+	}
+	else{
+		return +1;
+	}
 }
 
-int bc_compare_vectors_bool(const immer::vector<bc_inplace_value_t>& left, const immer::vector<bc_inplace_value_t>& right){
-	const auto& shared_count = std::min(left.size(), right.size());
+
+int bc_compare_vectors_bool(const immer::flex_vector<bc_inplace_value_t>& left, const immer::flex_vector<bc_inplace_value_t>& right){
+	const auto shared_count = std::min(left.size(), right.size());
 	for(int i = 0 ; i < shared_count ; i++){
 		int result = compare_bools(left[i], right[i]);
 		if(result != 0){
@@ -1354,8 +1896,8 @@ int bc_compare_vectors_bool(const immer::vector<bc_inplace_value_t>& left, const
 		return +1;
 	}
 }
-int bc_compare_vectors_int(const immer::vector<bc_inplace_value_t>& left, const immer::vector<bc_inplace_value_t>& right){
-	const auto& shared_count = std::min(left.size(), right.size());
+int bc_compare_vectors_int(const immer::flex_vector<bc_inplace_value_t>& left, const immer::flex_vector<bc_inplace_value_t>& right){
+	const auto shared_count = std::min(left.size(), right.size());
 	for(int i = 0 ; i < shared_count ; i++){
 		int result = compare_ints(left[i], right[i]);
 		if(result != 0){
@@ -1372,8 +1914,8 @@ int bc_compare_vectors_int(const immer::vector<bc_inplace_value_t>& left, const
 		return +1;
 	}
 }
-int bc_compare_vectors_double(const immer::vector<bc_inplace_value_t>& left, const immer::vector<bc_inplace_value_t>& right){
-	const auto& shared_count = std::min(left.size(), right.size());
+int bc_compare_vectors_double(const immer::flex_vector<bc_inplace_value_t>& left, const immer::flex_vector<bc_inplace_value_t>& right){
+	const auto shared_count = std::min(left.size(), right.size());
 	for(int i = 0 ; i < shared_count ; i++){
 		int result = compare_doubles(left[i], right[i]);
 		if(result != 0){
@@ -1653,17 +2195,7 @@ int bc_compare_value_true_deep(const bc_value_t& left, const bc_value_t& right,
 		return compare(left.get_int_value() - right.get_int_value());
 	}
 	else if(type.is_double()){
-		const auto a = left.get_double_value();
-		const auto b = right.get_double_value();
-		if(a > b){
-			return 1;
-		}
-		else if(a < b){
-			return -1;
-		}
-		else{
-			return 0;
-		}
+		return compare_double_values(left.get_double_value(), right.get_double_value());
 	}
 	else if(type.is_string()){
 		return bc_compare_string(left.get_string_value(), right.get_string_value());
@@ -1681,7 +2213,21 @@ int bc_compare_value_true_deep(const bc_value_t& left, const bc_value_t& right,
 	}
 	else if(type.is_struct()){
 		//	Make sure the EXACT struct types are the same -- not only that they are both structs
-		return bc_compare_struct_true_deep(left.get_struct_value(), right.get_struct_value(), type0);
+		if(encode_as_struct_w_inplace_members(type)){
+			const auto& members = type.get_struct()._members;
+			const auto& left_values = left._pod._external->_struct_w_inplace_members;
+			const auto& right_values = right._pod._external->_struct_w_inplace_members;
+			for(size_t i = 0 ; i < members.size() ; i++){
+				const auto diff = compare_inplace_values(left_values[i], right_values[i], members[i]._type);
+				if(diff != 0){
+					return diff;
+				}
+			}
+			return 0;
+		}
+		else{
+			return bc_compare_struct_true_deep(left._pod._external->_struct_members, right._pod._external->_struct_members, type0);
+		}
 	}
 	else if(type.is_vector()){
 		if(false){
@@ -1695,6 +2241,9 @@ int bc_compare_value_true_deep(const bc_value_t& left, const bc_value_t& right,
 		else if(type.get_vector_element_type().is_double()){
 			return bc_compare_vectors_double(left._pod._external->_vector_w_inplace_elements, right._pod._external->_vector_w_inplace_elements);
 		}
+		else if(encode_as_vector_w_struct_columns(type)){
+			return bc_compare_vectors_struct_columns(left._pod._external, right._pod._external, type0);
+		}
 		else{
 			const auto& left_vec = get_vector_external_elements(left);
 			const auto& right_vec = get_vector_external_elements(right);
@@ -1729,6 +2278,125 @@ int bc_compare_value_true_deep(const bc_value_t& left, const bc_value_t& right,
 	}
 }
 
+static size_t hash_combine(size_t seed, size_t v){
+	return seed ^ (v + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+static size_t hash_inplace_value(const bc_inplace_value_t& value, const typeid_t& type){
+	if(type.is_bool()){
+		return std::hash<bool>()(value._bool);
+	}
+	else if(type.is_int()){
+		return std::hash<int64_t>()(value._int64);
+	}
+	else if(type.is_double()){
+		//	-0.0 == 0.0 and all NaNs are equal so they must hash the same.
+		if(std::isnan(value._double)){
+			return 1;
+		}
+		return value._double == 0.0 ? 0 : std::hash<double>()(value._double);
+	}
+	else{
+		QUARK_ASSERT(false);
+		quark::throw_exception();
+	}
+}
+
+size_t bc_hash_value(const bc_value_t& value, const typeid_t& type){
+	QUARK_ASSERT(value.check_invariant());
+
+	if(type.is_undefined() || type.is_void()){
+		return 0;
+	}
+	else if(type.is_bool() || type.is_int() || type.is_double()){
+		return hash_inplace_value(value._pod._inplace, type);
+	}
+	else if(type.is_string()){
+		return std::hash<std::string_view>()(get_string_view(value._pod._external));
+	}
+	else if(type.is_json_value()){
+		return std::hash<std::string>()(json_to_compact_string(*value._pod._external->_json_value));
+	}
+	else if(type.is_typeid()){
+		return std::hash<std::string>()(typeid_to_compact_string(value._pod._external->_typeid_value));
+	}
+	else if(encode_as_struct_w_inplace_members(type)){
+		const auto& members = type.get_struct()._members;
+		const auto& values = value._pod._external->_struct_w_inplace_members;
+		size_t result = values.size();
+		for(size_t i = 0 ; i < values.size() ; i++){
+			result = hash_combine(result, hash_inplace_value(values[i], members[i]._type));
+		}
+		return result;
+	}
+	else if(type.is_struct()){
+		const auto& members = value._pod._external->_struct_members;
+		const auto& struct_def = type.get_struct();
+		size_t result = members.size();
+		for(int i = 0 ; i < members.size() ; i++){
+			result = hash_combine(result, bc_hash_value(members[i], struct_def._members[i]._type));
+		}
+		return result;
+	}
+	else if(type.is_vector()){
+		const auto& element_type = type.get_vector_element_type();
+		if(encode_as_vector_w_inplace_elements(type)){
+			const auto& elements = value._pod._external->_vector_w_inplace_elements;
+			size_t result = elements.size();
+			for(const auto& e: elements){
+				result = hash_combine(result, hash_inplace_value(e, element_type));
+			}
+			return result;
+		}
+		else if(encode_as_vector_w_struct_columns(type)){
+			//	Hashes each row like bc_hash_value() hashes a struct.
+			const auto& columns = value._pod._external->_vector_w_struct_columns;
+			const auto size = get_struct_columns_size(value._pod._external);
+			size_t result = size;
+			for(size_t i = 0 ; i < size ; i++){
+				size_t row = columns.size();
+				for(const auto& column: columns){
+					row = hash_combine(row, hash_inplace_value(column._pod._external->_vector_w_inplace_elements[i], column._type.get_vector_element_type()));
+				}
+				result = hash_combine(result, row);
+			}
+			return result;
+		}
+		else{
+			const auto& elements = value._pod._external->_vector_w_external_elements;
+			size_t result = elements.size();
+			for(const auto& e: elements){
+				result = hash_combine(result, bc_hash_value(bc_value_t(element_type, e), element_type));
+			}
+			return result;
+		}
+	}
+
+	//	Summing the entries makes the hash independent of iteration order.
+	else if(type.is_dict()){
+		const auto& value_type = type.get_dict_value_type();
+		size_t result = 0;
+		if(encode_as_dict_w_inplace_values(type)){
+			for(const auto& e: value._pod._external->_dict_w_inplace_values){
+				result += hash_combine(std::hash<std::string>()(e.first), hash_inplace_value(e.second, value_type));
+			}
+		}
+		else{
+			for(const auto& e: get_dict_value(value)){
+				result += hash_combine(std::hash<std::string>()(e.first), bc_hash_value(bc_value_t(value_type, e.second), value_type));
+			}
+		}
+		return result;
+	}
+	else if(type.is_function()){
+		return std::hash<int>()(value.get_function_value());
+	}
+	else{
+		QUARK_ASSERT(false);
+		quark::throw_exception();
+	}
+}
+
 extern const std::map<bc_opcode, opcode_info_t> k_opcode_info = {
 	{ bc_opcode::k_nop, { "nop", opcode_info_t::encoding::k_e_0000 }},
 
@@ -1742,16 +2410,20 @@ extern const std::map<bc_opcode, opcode_info_t> k_opcode_info = {
 	{ bc_opcode::k_copy_reg_external_value, { "copy_reg_external_value", opcode_info_t::encoding::k_q_0rr0 } },
 
 	{ bc_opcode::k_get_struct_member, { "get_struct_member", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_get_struct_w_inplace_members_member, { "get_struct_w_inplace_members_member", opcode_info_t::encoding::k_s_0rri } },
+	{ bc_opcode::k_get_vector_struct_column, { "get_vector_struct_column", opcode_info_t::encoding::k_s_0rri } },
 
 	{ bc_opcode::k_lookup_element_string, { "lookup_element_string", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_lookup_element_json_value, { "lookup_element_jsonvalue", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_lookup_element_vector_w_external_elements, { "lookup_element_vector_w_external_elements", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_lookup_element_vector_w_inplace_elements, { "lookup_element_vector_w_inplace_elements", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_lookup_element_vector_w_struct_columns, { "lookup_element_vector_w_struct_columns", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_lookup_element_dict_w_external_values, { "lookup_element_dict_w_external_values", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_lookup_element_dict_w_inplace_values, { "lookup_element_dict_w_inplace_values", opcode_info_t::encoding::k_o_0rrr } },
 
 	{ bc_opcode::k_get_size_vector_w_external_elements, { "get_size_vector_w_external_elements", opcode_info_t::encoding::k_q_0rr0 } },
 	{ bc_opcode::k_get_size_vector_w_inplace_elements, { "get_size_vector_w_inplace_elements", opcode_info_t::encoding::k_q_0rr0 } },
+	{ bc_opcode::k_get_size_vector_w_struct_columns, { "get_size_vector_w_struct_columns", opcode_info_t::encoding::k_q_0rr0 } },
 	{ bc_opcode::k_get_size_dict_w_external_values, { "get_size_dict_w_external_values", opcode_info_t::encoding::k_q_0rr0 } },
 	{ bc_opcode::k_get_size_dict_w_inplace_values, { "get_size_dict_w_inplace_values", opcode_info_t::encoding::k_q_0rr0 } },
 	{ bc_opcode::k_get_size_string, { "get_size_string", opcode_info_t::encoding::k_q_0rr0 } },
@@ -1759,6 +2431,7 @@ extern const std::map<bc_opcode, opcode_info_t> k_opcode_info = {
 
 	{ bc_opcode::k_pushback_vector_w_external_elements, { "pushback_vector_w_external_elements", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_pushback_vector_w_inplace_elements, { "pushback_vector_w_inplace_elements", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_pushback_vector_w_struct_columns, { "pushback_vector_w_struct_columns", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_pushback_string, { "pushback_string", opcode_info_t::encoding::k_o_0rrr } },
 
 	{ bc_opcode::k_call, { "call", opcode_info_t::encoding::k_s_0rri } },
@@ -1769,6 +2442,7 @@ extern const std::map<bc_opcode, opcode_info_t> k_opcode_info = {
 	{ bc_opcode::k_concat_strings, { "concat_strings", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_concat_vectors_w_external_elements, { "concat_vectors_w_external_elements", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_concat_vectors_w_inplace_elements, { "concat_vectors_pod64", opcode_info_t::encoding::k_o_0rrr } },
+	{ bc_opcode::k_concat_vectors_w_struct_columns, { "concat_vectors_w_struct_columns", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_subtract_double, { "subtract_double", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_subtract_int, { "subtract_int", opcode_info_t::encoding::k_o_0rrr } },
 	{ bc_opcode::k_multiply_double, { "multiply_double", opcode_info_t::encoding::k_o_0rrr } },
@@ -2092,7 +2766,7 @@ json_t interpreter_stack_t::stack_to_json() const{
 		const auto bc_pod = _entries[i];
 		const auto bc = bc_value_t(debug_type, bc_pod);
 
-		bool unwritten = ext && bc._pod._external->_debug__is_unwritten_external_value;
+		bool unwritten = ext && is_small_string(bc._pod._external) == false && bc._pod._external->_debug__is_unwritten_external_value;
 
 		auto a = json_t::make_array({
 			json_t(i),
@@ -2160,6 +2834,16 @@ bc_value_t call_function_bc(interpreter_t& vm, const bc_value_t& f, const bc_val
 		}
 #endif
 
+		const auto memo_cache = get_memo_cache(*vm._imm, f.get_function_value());
+		size_t memo_hash = 0;
+		if(memo_cache != nullptr){
+			memo_hash = memo_cache->hash_args(args, arg_count);
+			bc_value_t cached;
+			if(memo_cache->lookup(memo_hash, args, arg_count, cached)){
+				return cached;
+			}
+		}
+
 		vm._stack.save_frame();
 
 		//??? use exts-info inside function_def.
@@ -2177,6 +2861,7 @@ bc_value_t call_function_bc(interpreter_t& vm, const bc_value_t& f, const bc_val
 			}
 		}
 
+		const auto print_count = vm._print_output.size();
 		vm._stack.open_frame(*function_def._frame_ptr, arg_count);
 		const auto& result = execute_instructions(vm, function_def._frame_ptr->_instructions);
 		vm._stack.close_frame(*function_def._frame_ptr);
@@ -2184,6 +2869,9 @@ bc_value_t call_function_bc(interpreter_t& vm, const bc_value_t& f, const bc_val
 		vm._stack.restore_frame();
 
 		if(vm._imm->_program._types[result.first].is_void() == false){
+			if(memo_cache != nullptr && vm._print_output.size() == print_count){
+				memo_cache->insert(memo_hash, args, arg_count, result.second);
+			}
 			return result.second;
 		}
 		else{
@@ -2256,6 +2944,12 @@ json_t bcvalue_to_json(const bc_value_t& v){
 				result.push_back(json_t(element_value2));
 			}
 		}
+		else if(encode_as_vector_w_struct_columns(v._type)){
+			const auto size = get_struct_columns_size(v._pod._external);
+			for(size_t i = 0 ; i < size ; i++){
+				result.push_back(bcvalue_to_json(get_struct_columns_element(element_type, v._pod._external, i)));
+			}
+		}
 		else{
 			const auto vec = get_vector_external_elements(v);
 			for(int i = 0 ; i < vec->size() ; i++){
@@ -2298,27 +2992,230 @@ json_t bcvalue_and_type_to_json(const bc_value_t& v){
 
 
 
+//////////////////////////////////////////		memo_cache_t
+
+
+memo_cache_t::memo_cache_t(const std::string& function_name, const typeid_t& function_type, int64_t max_entries) :
+	_function_name(function_name),
+	_function_type(function_type),
+	_max_entries(max_entries),
+	_hit_count(0),
+	_miss_count(0)
+{
+	QUARK_ASSERT(function_type.is_function());
+	QUARK_ASSERT(max_entries > 0);
+}
+
+size_t memo_cache_t::hash_args(const bc_value_t args[], int arg_count) const{
+	const auto& arg_types = _function_type.get_function_args();
+	QUARK_ASSERT(arg_count == arg_types.size());
+
+	size_t result = arg_count;
+	for(int i = 0 ; i < arg_count ; i++){
+		result = hash_combine(result, bc_hash_value(args[i], arg_types[i]));
+	}
+	return result;
+}
+
+bool memo_cache_t::args_equal(const entry_t& entry, const bc_value_t args[], int arg_count) const{
+	const auto& arg_types = _function_type.get_function_args();
+	for(int i = 0 ; i < arg_count ; i++){
+		const auto& type = arg_types[i];
+		if(type.is_function()){
+			if(entry._args[i].get_function_value() != args[i].get_function_value()){
+				return false;
+			}
+		}
+		else if(bc_compare_value_true_deep(entry._args[i], args[i], type) != 0){
+			return false;
+		}
+	}
+	return true;
+}
+
+memo_cache_t::entry_it_t memo_cache_t::find(size_t hash, const bc_value_t args[], int arg_count){
+	const auto range = _index.equal_range(hash);
+	for(auto it = range.first ; it != range.second ; it++){
+		if(args_equal(*it->second, args, arg_count)){
+			return it->second;
+		}
+	}
+	return _entries.end();
+}
+
+bool memo_cache_t::lookup(size_t hash, const bc_value_t args[], int arg_count, bc_value_t& result){
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const auto it = find(hash, args, arg_count);
+	if(it != _entries.end()){
+		_entries.splice(_entries.begin(), _entries, it);
+		result = it->_result;
+		_hit_count++;
+		return true;
+	}
+	else{
+		_miss_count++;
+		return false;
+	}
+}
+
+void memo_cache_t::insert(size_t hash, const bc_value_t args[], int arg_count, const bc_value_t& result){
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	//	Another thread may have computed the same call meanwhile.
+	if(find(hash, args, arg_count) != _entries.end()){
+		return;
+	}
+
+	_entries.push_front(entry_t{ hash, std::vector<bc_value_t>(args, args + arg_count), result });
+	_index.insert({ hash, _entries.begin() });
+
+	if(_entries.size() > _max_entries){
+		const auto oldest = std::prev(_entries.end());
+		const auto range = _index.equal_range(oldest->_hash);
+		for(auto it = range.first ; it != range.second ; it++){
+			if(it->second == oldest){
+				_index.erase(it);
+				break;
+			}
+		}
+		_entries.erase(oldest);
+	}
+}
+
+size_t memo_cache_t::get_entry_count() const{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _entries.size();
+}
+
+
+static bool contains_function_type(const typeid_t& type){
+	if(type.is_function()){
+		return true;
+	}
+	else if(type.is_struct()){
+		const auto& members = type.get_struct()._members;
+		return std::find_if(members.begin(), members.end(), [](const member_t& m){ return contains_function_type(m._type); }) != members.end();
+	}
+	else if(type.is_vector()){
+		return contains_function_type(type.get_vector_element_type());
+	}
+	else if(type.is_dict()){
+		return contains_function_type(type.get_dict_value_type());
+	}
+	else{
+		return false;
+	}
+}
+
+static std::vector<std::shared_ptr<memo_cache_t>> make_memo_caches(const bc_program_t& program){
+	const auto& tweaks = program._container_def._memoize_tweaks;
+	if(tweaks.empty()){
+		return {};
+	}
+
+	std::vector<std::shared_ptr<memo_cache_t>> result(program._function_defs.size());
+	for(const auto& tweak: tweaks){
+		const auto& name = tweak.first;
+		const auto it = program._global_functions.find(name);
+		if(it == program._global_functions.end()){
+			quark::throw_runtime_error("Memoize tweaker: unknown function \"" + name + "\".");
+		}
+
+		const auto function_id = it->second;
+		const auto& function_def = program._function_defs[function_id];
+		const auto& function_type = function_def._function_type;
+		if(function_def._host_function_id != 0){
+			quark::throw_runtime_error("Memoize tweaker: \"" + name + "\" is a host function.");
+		}
+		if(function_type.get_function_pure() != epure::pure){
+			quark::throw_runtime_error("Memoize tweaker: \"" + name + "\" is not pure.");
+		}
+		if(function_type.get_function_return().is_void()){
+			quark::throw_runtime_error("Memoize tweaker: \"" + name + "\" returns void.");
+		}
+
+		//	Function values are compared by identity, but only as direct arguments.
+		for(const auto& arg_type: function_type.get_function_args()){
+			if(arg_type.is_function() == false && contains_function_type(arg_type)){
+				quark::throw_runtime_error("Memoize tweaker: \"" + name + "\" has arguments that contain functions.");
+			}
+		}
+
+		result[function_id] = std::make_shared<memo_cache_t>(name, function_type, tweak.second);
+	}
+	return result;
+}
+
+void trace_memo_stats(const interpreter_imm_t& imm){
+	if(imm._memo_caches.empty()){
+		return;
+	}
+
+	QUARK_SCOPED_TRACE("memoize tweakers:");
+	for(const auto& cache: imm._memo_caches){
+		if(cache){
+			QUARK_TRACE_SS(
+				cache->_function_name
+				<< ": hits: " << cache->_hit_count
+				<< ", misses: " << cache->_miss_count
+				<< ", entries: " << cache->get_entry_count() << "/" << cache->_max_entries
+			);
+		}
+	}
+}
+
+
 //////////////////////////////////////////		interpreter_t
 
 
 
-interpreter_t::interpreter_t(const bc_program_t& program, interpreter_handler_i* handler) :
-	_stack(nullptr),
-	_handler(handler)
-{
+//	Lookup table from host-function ID to an implementation of that host function in the interpreter.
+//	The same for all programs: make it once.
+static const std::map<int, HOST_FUNCTION_PTR>& get_host_function_table(){
+	static const auto table = [](){
+		std::map<int, HOST_FUNCTION_PTR> result;
+		for(auto& hf_kv: get_host_functions()){
+			const auto& function_id = hf_kv.second._signature._function_id;
+			const auto& function_ptr = hf_kv.second._f;
+			result.insert({ function_id, function_ptr });
+		}
+		return result;
+	}();
+	return table;
+}
+
+std::shared_ptr<interpreter_imm_t> make_interpreter_imm(const bc_program_t& program){
 	QUARK_ASSERT(program.check_invariant());
 
-	//	Make lookup table from host-function ID to an implementation of that host function in the interpreter.
-	const auto& host_functions = get_host_functions();
-	std::map<int, HOST_FUNCTION_PTR> host_functions2;
-	for(auto& hf_kv: host_functions){
-		const auto& function_id = hf_kv.second._signature._function_id;
-		const auto& function_ptr = hf_kv.second._f;
-		host_functions2.insert({ function_id, function_ptr });
+	const auto memo_caches = make_memo_caches(program);
+
+	//	A memoized function keeps going through its cache, that's what the tweaker asks for.
+	std::vector<std::shared_ptr<const numeric_kernel_t>> numeric_kernels;
+	for(int i = 0 ; i < program._function_defs.size() ; i++){
+		const auto memoized = memo_caches.empty() == false && memo_caches[i] != nullptr;
+		numeric_kernels.push_back(memoized ? nullptr : make_numeric_kernel(program._function_defs[i]));
+	}
+
+	std::unordered_map<std::string, int> channel_ids;
+	const auto channel_names = get_channel_names(program._container_def);
+	for(int i = 0 ; i < channel_names.size() ; i++){
+		channel_ids.insert({ channel_names[i], i });
 	}
 
 	const auto start_time = std::chrono::high_resolution_clock::now();
-	_imm = std::make_shared<interpreter_imm_t>(interpreter_imm_t{start_time, program, host_functions2});
+	return std::make_shared<interpreter_imm_t>(
+		interpreter_imm_t{start_time, program, get_host_function_table(), memo_caches, numeric_kernels, channel_ids}
+	);
+}
+
+
+interpreter_t::interpreter_t(const std::shared_ptr<interpreter_imm_t>& imm, interpreter_handler_i* handler) :
+	_imm(imm),
+	_handler(handler),
+	_stack(nullptr)
+{
+	QUARK_ASSERT(imm && imm->_program.check_invariant());
 
 	interpreter_stack_t temp(&_imm->_program._globals);
 	temp.swap(_stack);
@@ -2329,8 +3226,40 @@ interpreter_t::interpreter_t(const bc_program_t& program, interpreter_handler_i*
 	/*const auto& r =*/ execute_instructions(*this, _imm->_program._globals._instructions);
 	QUARK_ASSERT(check_invariant());
 }
+
+interpreter_t::interpreter_t(const bc_program_t& program, interpreter_handler_i* handler) :
+	interpreter_t(make_interpreter_imm(program), handler)
+{
+}
+
 interpreter_t::interpreter_t(const bc_program_t& program) : interpreter_t(program, nullptr) {}
 
+interpreter_t::interpreter_t(const std::shared_ptr<interpreter_imm_t>& imm, interpreter_handler_i* handler, const std::vector<bc_value_t>& globals) :
+	_imm(imm),
+	_handler(handler),
+	_stack(nullptr)
+{
+	QUARK_ASSERT(imm && imm->_program.check_invariant());
+
+	const auto& global_frame = _imm->_program._globals;
+	QUARK_ASSERT(globals.size() == global_frame._locals.size());
+
+	interpreter_stack_t temp(&global_frame);
+	temp.swap(_stack);
+	_stack.save_frame();
+	_stack.open_frame(global_frame, 0);
+
+	for(int i = 0 ; i < globals.size() ; i++){
+		if(global_frame._locals_exts[i]){
+			_stack.replace_external_value(k_frame_overhead + i, globals[i]);
+		}
+		else{
+			_stack.replace_inplace_value(k_frame_overhead + i, globals[i]);
+		}
+	}
+	QUARK_ASSERT(check_invariant());
+}
+
 void interpreter_t::swap(interpreter_t& other) throw(){
 	other._imm.swap(this->_imm);
 	std::swap(other._handler, this->_handler);
@@ -2427,7 +3356,7 @@ void execute_new_vector_obj(interpreter_t& vm, int16_t dest_reg, int16_t target_
 	const int arg0_stack_pos = vm._stack.size() - arg_count;
 //	bool is_element_ext = encode_as_external(element_type);
 
-	immer::vector<bc_external_handle_t> elements2;
+	immer::flex_vector<bc_external_handle_t> elements2;
 	for(int i = 0 ; i < arg_count ; i++){
 		const auto pos = arg0_stack_pos + i;
 		QUARK_ASSERT(vm._stack._debug_types[pos] == element_type);
@@ -2559,7 +3488,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			release_pod_external(regs[i._a]);
 			const auto& new_value_pod = globals[i._b];
 			regs[i._a] = new_value_pod;
-			new_value_pod._external->_rc++;
+			retain_external(new_value_pod._external);
 			break;
 		}
 		case bc_opcode::k_load_global_inplace_value: {
@@ -2577,7 +3506,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			release_pod_external(globals[i._a]);
 			const auto& new_value_pod = regs[i._b];
 			globals[i._a] = new_value_pod;
-			new_value_pod._external->_rc++;
+			retain_external(new_value_pod._external);
 			break;
 		}
 		case bc_opcode::k_store_global_inplace_value: {
@@ -2606,7 +3535,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			release_pod_external(regs[i._a]);
 			const auto& new_value_pod = regs[i._b];
 			regs[i._a] = new_value_pod;
-			new_value_pod._external->_rc++;
+			retain_external(new_value_pod._external);
 			break;
 		}
 
@@ -2690,7 +3619,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 #endif
 
 			const auto& new_value_pod = regs[i._a];
-			new_value_pod._external->_rc++;
+			retain_external(new_value_pod._external);
 			stack._entries[stack._stack_size] = new_value_pod;
 			stack._stack_size++;
 #if DEBUG
@@ -2798,26 +3727,49 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			bool ext = frame_ptr->_exts[i._a];
 			if(ext){
 				release_pod_external(regs[i._a]);
-				value_pod._external->_rc++;
+				retain_external(value_pod._external);
 			}
 			regs[i._a] = value_pod;
 			QUARK_ASSERT(vm.check_invariant());
 			break;
 		}
 
+		case bc_opcode::k_get_struct_w_inplace_members_member: {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg__inplace_value(i._a));
+			QUARK_ASSERT(stack.check_reg_struct(i._b));
+
+			regs[i._a]._inplace = regs[i._b]._external->_struct_w_inplace_members[i._c];
+			QUARK_ASSERT(vm.check_invariant());
+			break;
+		}
+
+		case bc_opcode::k_get_vector_struct_column: {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_struct_columns(i._b));
+
+			const auto& column_pod = regs[i._b]._external->_vector_w_struct_columns[i._c]._pod;
+			retain_external(column_pod._external);
+			release_pod_external(regs[i._a]);
+			regs[i._a] = column_pod;
+			QUARK_ASSERT(vm.check_invariant());
+			break;
+		}
+
 		case bc_opcode::k_lookup_element_string: {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_int(i._a));
 			QUARK_ASSERT(stack.check_reg_string(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
-			const auto& s = regs[i._b]._external->_string;
+			const auto& s = regs[i._b]._external;
 			const auto lookup_index = regs[i._c]._inplace._int64;
-			if(lookup_index < 0 || lookup_index >= s.size()){
+			if(lookup_index < 0 || lookup_index >= get_string_size(s)){
 				quark::throw_runtime_error("Lookup in string: out of bounds.");
 			}
 			else{
-				regs[i._a]._inplace._int64 = s[lookup_index];
+				regs[i._a]._inplace._int64 = get_string_char(s, lookup_index);
 			}
 			QUARK_ASSERT(vm.check_invariant());
 			break;
@@ -2837,7 +3789,8 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			if(parent_json_value->is_object()){
 				QUARK_ASSERT(stack.check_reg_string(i._c));
 
-				const auto& lookup_key = regs[i._c]._external->_string;
+				std::string temp;
+				const auto& lookup_key = get_std_string(regs[i._c]._external, temp);
 
 				//	get_object_element() throws if key can't be found.
 				const auto& value = parent_json_value->get_object_element(lookup_key);
@@ -2845,7 +3798,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 				//??? no need to create full bc_value_t here! We only need pod.
 				const auto value2 = bc_value_t::make_json_value(value);
 
-				value2._pod._external->_rc++;
+				retain_external(value2._pod._external);
 				release_pod_external(regs[i._a]);
 				regs[i._a] = value2._pod;
 			}
@@ -2863,7 +3816,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 					//??? no need to create full bc_value_t here! We only need pod.
 					const auto value2 = bc_value_t::make_json_value(value);
 
-					value2._pod._external->_rc++;
+					retain_external(value2._pod._external);
 					release_pod_external(regs[i._a]);
 					regs[i._a] = value2._pod;
 				}
@@ -2888,7 +3841,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			}
 			else{
 				auto handle = vec[lookup_index];
-				handle._external->_rc++;
+				retain_external(handle._external);
 				release_pod_external(regs[i._a]);
 				regs[i._a]._external = handle._external;
 			}
@@ -2897,7 +3850,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 		}
 		case bc_opcode::k_lookup_element_vector_w_inplace_elements: {
 			QUARK_ASSERT(vm.check_invariant());
-			QUARK_ASSERT(stack.check_reg_int(i._a));
+			QUARK_ASSERT(stack.check_reg__inplace_value(i._a));
 			QUARK_ASSERT(stack.check_reg_vector_w_inplace_elements(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
@@ -2913,20 +3866,40 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			break;
 		}
 
+		case bc_opcode::k_lookup_element_vector_w_struct_columns: {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_struct(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_struct_columns(i._b));
+			QUARK_ASSERT(stack.check_reg_int(i._c));
+
+			const auto& vector_type = frame_ptr->_symbols[i._b].second._value_type;
+			const auto lookup_index = regs[i._c]._inplace._int64;
+			if(lookup_index < 0 || lookup_index >= get_struct_columns_size(regs[i._b]._external)){
+				quark::throw_runtime_error("Lookup in vector: out of bounds.");
+			}
+			else{
+				const auto element = get_struct_columns_element(vector_type.get_vector_element_type(), regs[i._b]._external, lookup_index);
+				vm._stack.write_register__external_value(i._a, element);
+			}
+			QUARK_ASSERT(vm.check_invariant());
+			break;
+		}
+
 		case bc_opcode::k_lookup_element_dict_w_external_values: {
 			QUARK_ASSERT(stack.check_reg__external_value(i._a));
 			QUARK_ASSERT(stack.check_reg_dict_w_external_values(i._b));
 			QUARK_ASSERT(stack.check_reg_string(i._c));
 
 			const auto& entries = regs[i._b]._external->_dict_w_external_values;
-			const auto& lookup_key = regs[i._c]._external->_string;
+			std::string temp;
+			const auto& lookup_key = get_std_string(regs[i._c]._external, temp);
 			const auto found_ptr = entries.find(lookup_key);
 			if(found_ptr == nullptr){
 				quark::throw_runtime_error("Lookup in dict: key not found.");
 			}
 			else{
 				const auto& handle = *found_ptr;
-				handle._external->_rc++;
+				retain_external(handle._external);
 				release_pod_external(regs[i._a]);
 				regs[i._a]._external = handle._external;
 			}
@@ -2938,7 +3911,8 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			QUARK_ASSERT(stack.check_reg_string(i._c));
 
 			const auto& entries = regs[i._b]._external->_dict_w_inplace_values;
-			const auto& lookup_key = regs[i._c]._external->_string;
+			std::string temp;
+			const auto& lookup_key = get_std_string(regs[i._c]._external, temp);
 			const auto found_ptr = entries.find(lookup_key);
 			if(found_ptr == nullptr){
 				quark::throw_runtime_error("Lookup in dict: key not found.");
@@ -2960,6 +3934,16 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			QUARK_ASSERT(vm.check_invariant());
 			break;
 		}
+		case bc_opcode::k_get_size_vector_w_struct_columns: {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_int(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_struct_columns(i._b));
+			QUARK_ASSERT(i._c == 0);
+
+			regs[i._a]._inplace._int64 = get_struct_columns_size(regs[i._b]._external);
+			QUARK_ASSERT(vm.check_invariant());
+			break;
+		}
 		case bc_opcode::k_get_size_vector_w_inplace_elements: {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_int(i._a));
@@ -3000,7 +3984,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			QUARK_ASSERT(stack.check_reg_string(i._b));
 			QUARK_ASSERT(i._c == 0);
 
-			regs[i._a]._inplace._int64 = regs[i._b]._external->_string.size();
+			regs[i._a]._inplace._int64 = get_string_size(regs[i._b]._external);
 			QUARK_ASSERT(vm.check_invariant());
 			break;
 		}
@@ -3062,20 +4046,31 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			break;
 		}
 
+		case bc_opcode::k_pushback_vector_w_struct_columns: {
+			QUARK_ASSERT(vm.check_invariant());
+			QUARK_ASSERT(stack.check_reg_vector_w_struct_columns(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_struct_columns(i._b));
+			QUARK_ASSERT(stack.check_reg_struct(i._c));
+
+			const auto& type = frame_ptr->_symbols[i._a].second._value_type;
+			const auto& element_type = type.get_vector_element_type();
+
+			const auto vec2 = push_back_struct_columns(element_type, regs[i._b]._external, regs[i._c]._external);
+			vm._stack.write_register__external_value(i._a, vec2);
+			QUARK_ASSERT(vm.check_invariant());
+			break;
+		}
+
 		case bc_opcode::k_pushback_string: {
 			QUARK_ASSERT(vm.check_invariant());
 			QUARK_ASSERT(stack.check_reg_string(i._a));
 			QUARK_ASSERT(stack.check_reg_string(i._b));
 			QUARK_ASSERT(stack.check_reg_int(i._c));
 
-			std::string str2 = regs[i._b]._external->_string;
 			const auto ch = regs[i._c]._inplace._int64;
-			str2.push_back(static_cast<char>(ch));
-
-			//??? optimize - bypass bc_value_t
-			//??? always allocates a new bc_external_value_t!
-			const auto str3 = bc_value_t::make_string(str2);
-			vm._stack.write_register__external_value(i._a, str3);
+			auto prev_copy = regs[i._a];
+			regs[i._a]._external = push_back_string_external(regs[i._b]._external, static_cast<char>(ch));
+			release_pod_external(prev_copy);
 			QUARK_ASSERT(vm.check_invariant());
 			break;
 		}
@@ -3143,9 +4138,29 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			else{
 				QUARK_ASSERT(function_def_dynamic_arg_count == 0);
 
+				//	Memoize tweaker. The arguments are already on the stack, the caller pops them.
+				const auto memo_cache = get_memo_cache(*vm._imm, function_id);
+				std::vector<bc_value_t> memo_args;
+				size_t memo_hash = 0;
+				if(memo_cache != nullptr){
+					const int arg0_stack_pos = stack.size() - callee_arg_count;
+					for(int a = 0 ; a < callee_arg_count ; a++){
+						memo_args.push_back(stack.load_value(arg0_stack_pos + a, function_def._args[a]._type));
+					}
+					memo_hash = memo_cache->hash_args(memo_args.data(), callee_arg_count);
+
+					bc_value_t cached;
+					if(memo_cache->lookup(memo_hash, memo_args.data(), callee_arg_count, cached)){
+						stack.write_register(i._a, cached);
+						QUARK_ASSERT(vm.check_invariant());
+						break;
+					}
+				}
+
 				//	We need to remember the global pos where to store return value, since we're switching frame to call function.
 				int result_reg_pos = static_cast<int>(stack._current_frame_entry_ptr - &stack._entries[0]) + i._a;
 
+				const auto print_count = vm._print_output.size();
 				stack.open_frame(*function_def._frame_ptr, callee_arg_count);
 				const auto& result = execute_instructions(vm, function_def._frame_ptr->_instructions);
 				stack.close_frame(*function_def._frame_ptr);
@@ -3155,6 +4170,9 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 				regs = stack._current_frame_entry_ptr;
 
 				if(function_return_type.is_void() == false){
+					if(memo_cache != nullptr && vm._print_output.size() == print_count){
+						memo_cache->insert(memo_hash, memo_args.data(), callee_arg_count, result.second);
+					}
 
 					//	Cannot store via register, we have not yet executed k_pop_frame_ptr that restores our frame.
 					if(function_def._return_is_ext){
@@ -3185,7 +4203,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 		}
 
 		case bc_opcode::k_new_vector_w_external_elements: {
-			QUARK_ASSERT(stack.check_reg_vector_w_external_elements(i._a));
+			QUARK_ASSERT(stack.check_reg__external_value(i._a));
 			QUARK_ASSERT(i._b >= 0);
 			QUARK_ASSERT(i._c >= 0);
 
@@ -3210,7 +4228,7 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			const auto arg_count = i._c;
 
 			const int arg0_stack_pos = vm._stack.size() - arg_count;
-			immer::vector<bc_inplace_value_t> elements2;
+			immer::flex_vector<bc_inplace_value_t> elements2;
 			for(int a = 0 ; a < arg_count ; a++){
 				const auto pos = arg0_stack_pos + a;
 				elements2 = elements2.push_back(stack._entries[pos]._inplace);
@@ -3384,12 +4402,8 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			QUARK_ASSERT(stack.check_reg_string(i._b));
 			QUARK_ASSERT(stack.check_reg_string(i._c));
 
-			//	??? No need to create bc_value_t here.
-			const auto s = regs[i._b]._external->_string + regs[i._c]._external->_string;
-			const auto value = bc_value_t::make_string(s);
 			auto prev_copy = regs[i._a];
-			value._pod._external->_rc++;
-			regs[i._a] = value._pod;
+			regs[i._a]._external = concat_string_externals(regs[i._b]._external, regs[i._c]._external);
 			release_pod_external(prev_copy);
 			break;
 		}
@@ -3403,13 +4417,8 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			const auto& element_type = vector_type.get_vector_element_type();
 			QUARK_ASSERT(encode_as_vector_w_inplace_elements(vector_type) == false);
 
-			//	Copy left into new vector.
-			immer::vector<bc_external_handle_t> elements2 = regs[i._b]._external->_vector_w_external_elements;
-
-			const auto& right_elements = regs[i._c]._external->_vector_w_external_elements;
-			for(const auto& e: right_elements){
-				elements2 = elements2.push_back(e);
-			}
+			//	flex_vector concatenation is O(log n) and shares the nodes of both sides.
+			const auto& elements2 = regs[i._b]._external->_vector_w_external_elements + regs[i._c]._external->_vector_w_external_elements;
 			const auto& value2 = make_vector(element_type, elements2);
 			stack.write_register__external_value(i._a, value2);
 			break;
@@ -3423,18 +4432,32 @@ std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const
 			const auto& element_type = vector_type.get_vector_element_type();
 			QUARK_ASSERT(encode_as_vector_w_inplace_elements(vector_type) == true);
 
-			//	Copy left into new vector.
-			auto elements2 = regs[i._b]._external->_vector_w_inplace_elements;
-
-			const auto& right_elements = regs[i._c]._external->_vector_w_inplace_elements;
-			for(const auto& e: right_elements){
-				elements2 = elements2.push_back(e);
-			}
+			const auto& elements2 = regs[i._b]._external->_vector_w_inplace_elements + regs[i._c]._external->_vector_w_inplace_elements;
 			const auto& value2 = make_vector(element_type, elements2);
 			stack.write_register__external_value(i._a, value2);
 			break;
 		}
 
+		case bc_opcode::k_concat_vectors_w_struct_columns: {
+			QUARK_ASSERT(stack.check_reg_vector_w_struct_columns(i._a));
+			QUARK_ASSERT(stack.check_reg_vector_w_struct_columns(i._b));
+			QUARK_ASSERT(stack.check_reg_vector_w_struct_columns(i._c));
+
+			const auto& vector_type = frame_ptr->_symbols[i._a].second._value_type;
+			const auto& element_type = vector_type.get_vector_element_type();
+
+			const auto& right_columns = regs[i._c]._external->_vector_w_struct_columns;
+			const auto& value2 = transform_struct_columns(
+				element_type,
+				regs[i._b]._external,
+				[&](size_t member_index, const immer::flex_vector<bc_inplace_value_t>& column){
+					return column + right_columns[member_index]._pod._external->_vector_w_inplace_elements;
+				}
+			);
+			stack.write_register__external_value(i._a, value2);
+			break;
+		}
+
 		case bc_opcode::k_subtract_double: {
 			QUARK_ASSERT(stack.check_reg_double(i._a));
 			QUARK_ASSERT(stack.check_reg_double(i._b));
@@ -3577,14 +4600,15 @@ std::shared_ptr<value_entry_t> find_global_symbol2(const interpreter_t& vm, cons
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(s.size() > 0);
 
+	//	Search from the back: a global that shadows a host function comes after it.
 	const auto& symbols = vm._imm->_program._globals._symbols;
     const auto& it = std::find_if(
-    	symbols.begin(),
-    	symbols.end(),
+    	symbols.rbegin(),
+    	symbols.rend(),
     	[&s](const std::pair<std::string, bc_symbol_t>& e) { return e.first == s; }
 	);
-	if(it != symbols.end()){
-		const auto index = static_cast<int>(it - symbols.begin());
+	if(it != symbols.rend()){
+		const auto index = static_cast<int>(symbols.rend() - it - 1);
 		const auto pos = get_global_n_pos(index);
 		QUARK_ASSERT(pos >= 0 && pos < vm._stack.size());
 
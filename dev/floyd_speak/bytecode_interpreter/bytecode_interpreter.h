@@ -28,12 +28,20 @@
 #include "quark.h"
 
 #include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
 #include <vector>
 #include <map>
+#include <list>
+#include <unordered_map>
+#include <mutex>
 #include <atomic>
 #include <chrono>
 #include "immer/vector.hpp"
 #include "immer/map.hpp"
+#include "immer/flex_vector.hpp"
 
 
 
@@ -41,6 +49,7 @@ namespace floyd {
 struct interpreter_t;
 struct bc_program_t;
 struct bc_static_frame_t;
+struct numeric_kernel_t;
 
 struct bc_value_t;
 union bc_pod_value_t;
@@ -80,6 +89,109 @@ union bc_pod_value_t {
 
 void release_pod_external(bc_pod_value_t& value);
 
+//	Bumps the RC of an external value. Defined below bc_external_value_t.
+inline void retain_external(const bc_external_value_t* ext);
+
+
+//////////////////////////////////////		SMALL STRINGS
+
+/*
+	Strings of up to 7 bytes are stored inside the pod's 64 bits instead of in a bc_external_value_t: no heap
+	allocation and no reference count. They use the _external member, tagged with bit 0, which is never set in a
+	real bc_external_value_t pointer.
+
+	Byte 0 is (size << 1) | 1, bytes 1 - 7 are the characters and the unused bytes are 0, so equal small strings
+	have equal bits.
+
+	A string is always a small string when it fits, make_string_external() takes care of that.
+
+	This needs 64-bit pointers and a little-endian CPU. On other targets, like 32-bit Emscripten, FLOYD_SMALL_STRINGS
+	is 0 and all strings are bc_external_value_t:s. Define FLOYD_SMALL_STRINGS to 0 to turn them off anywhere.
+*/
+
+#ifndef FLOYD_SMALL_STRINGS
+	#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && UINTPTR_MAX == UINT64_MAX
+		#define FLOYD_SMALL_STRINGS 1
+	#else
+		#define FLOYD_SMALL_STRINGS 0
+	#endif
+#endif
+
+const size_t k_small_string_max_size = 7;
+
+inline bool is_small_string(const bc_external_value_t* ext){
+#if FLOYD_SMALL_STRINGS
+	return (reinterpret_cast<uintptr_t>(ext) & 1) != 0;
+#else
+	return false;
+#endif
+}
+
+//	Returns a small string or a new bc_external_value_t with RC 1.
+const bc_external_value_t* make_string_external(const char* s, size_t size);
+const bc_external_value_t* make_string_external(std::string&& s);
+
+//	Works for all kinds of strings. ext must be a variable that outlives the returned view: a small string's
+//	characters are stored inside it. Defined below bc_external_value_t.
+inline std::string_view get_string_view(const bc_external_value_t* const& ext);
+
+
+//////////////////////////////////////		ROPE STRINGS
+
+/*
+	Long strings made by concatenation, push_back(), subset() and replace() are stored as ropes: an
+	immer::flex_vector<char> that concatenates, slices and appends in O(log n) without copying the characters. This
+	makes building a big string piece by piece linear instead of quadratic.
+
+	The size and [] read the rope directly. Everything that needs the characters in one piece -- print(), file
+	writes, sha1, comparisons -- goes through get_string_view(), which flattens the rope into a std::string the first
+	time. The flat string then replaces the rope, so the characters are never kept twice.
+
+	Shorter strings are always flat: copying them is cheaper than a rope.
+*/
+
+const size_t k_rope_min_size = 1024;
+
+typedef immer::flex_vector<char> rope_t;
+
+//	Only rope strings allocate one of these, other values just have a null pointer.
+struct rope_string_t {
+	explicit rope_string_t(const rope_t& rope);
+
+	const size_t _size;
+
+	//	Null once flattened. Read and clear with std::atomic_load() / std::atomic_store(): a reader keeps the rope it got
+	//	alive even if another thread flattens the string meanwhile.
+	std::shared_ptr<const rope_t> _rope;
+
+	//	Written once by flatten_rope(), immutable after that.
+	std::string _flat;
+	std::atomic<bool> _flattened;
+	std::once_flag _flatten_once;
+};
+
+//	Returns a small string, a flat string or a rope string, depending on the size.
+const bc_external_value_t* make_string_external(const rope_t& rope);
+
+//	Returns the characters as a rope: O(1) for a rope string, otherwise they are copied.
+rope_t get_string_rope(const bc_external_value_t* const& ext);
+
+//	Characters [begin, end) of ext, without flattening it.
+const bc_external_value_t* make_substring_external(const bc_external_value_t* const& ext, size_t begin, size_t end);
+
+const bc_external_value_t* concat_string_externals(const bc_external_value_t* const& a, const bc_external_value_t* const& b);
+const bc_external_value_t* push_back_string_external(const bc_external_value_t* const& ext, char ch);
+
+//	Makes the std::string of a rope string, once, and drops the rope. Thread safe.
+std::string_view flatten_rope(const bc_external_value_t* ext);
+
+//	Defined below bc_external_value_t.
+inline bool is_rope_string(const bc_external_value_t* const& ext);
+
+//	Defined below bc_external_value_t.
+inline size_t get_string_size(const bc_external_value_t* const& ext);
+inline char get_string_char(const bc_external_value_t* const& ext, size_t index);
+
 
 //////////////////////////////////////		value_encoding
 
@@ -105,6 +217,14 @@ enum class value_encoding {
 
 bool encode_as_inplace(const typeid_t& type);
 bool encode_as_vector_w_inplace_elements(const typeid_t& type);
+
+//	Vectors of structs with only bool, int and double members, like [pixel_t], are stored as one
+//	inplace vector per member instead of one external struct value per element. See STRUCT COLUMNS.
+bool encode_as_vector_w_struct_columns(const typeid_t& type);
+
+//	Structs with only bool, int and double members, like vector2_t, keep their members as one flat block of
+//	bc_inplace_value_t:s. The member types come from the struct type, not from each member.
+bool encode_as_struct_w_inplace_members(const typeid_t& type);
 bool encode_as_dict_w_inplace_values(const typeid_t& type);
 value_encoding type_to_encoding(const typeid_t& type);
 
@@ -171,8 +291,15 @@ struct bc_value_t {
 
 	//////////////////////////////////////		string
 	public: static bc_value_t make_string(const std::string& v);
+
+	//	Takes over v's buffer instead of copying it.
+	public: static bc_value_t make_string(std::string&& v);
+
+	//	Takes over ext, from make_string_external() etc. Doesn't bump RC.
+	public: static bc_value_t make_string_from_external(const bc_external_value_t* ext);
 	public: std::string get_string_value() const;
 	private: explicit bc_value_t(const std::string& value);
+	private: explicit bc_value_t(std::string&& value);
 
 
 	//////////////////////////////////////		json_value
@@ -189,7 +316,10 @@ struct bc_value_t {
 
 	//////////////////////////////////////		struct
 	public: static bc_value_t make_struct_value(const typeid_t& struct_type, const std::vector<bc_value_t>& values);
-	public: const std::vector<bc_value_t>& get_struct_value() const;
+	public: static bc_value_t make_struct_value(const typeid_t& struct_type, const std::vector<bc_inplace_value_t>& values);
+
+	//	Makes bc_value_t:s of the members of structs with inplace members.
+	public: std::vector<bc_value_t> get_struct_value() const;
 	private: explicit bc_value_t(const typeid_t& struct_type, const std::vector<bc_value_t>& values, bool struct_tag);
 
 
@@ -255,11 +385,15 @@ bool check_external_deep(const typeid_t& type, const bc_external_value_t* ext);
 
 struct bc_external_value_t {
 	public: bc_external_value_t(const std::string& s);
+	public: bc_external_value_t(std::string&& s);
+	public: explicit bc_external_value_t(const rope_t& rope);
 	public: bc_external_value_t(const std::shared_ptr<json_t>& s);
 	public: bc_external_value_t(const typeid_t& s);
 	public: bc_external_value_t(const typeid_t& type, const std::vector<bc_value_t>& s, bool struct_tag);
-	public: bc_external_value_t(const typeid_t& type, const immer::vector<bc_external_handle_t>& s);
-	public: bc_external_value_t(const typeid_t& type, const immer::vector<bc_inplace_value_t>& s);
+	public: bc_external_value_t(const typeid_t& type, const std::vector<bc_inplace_value_t>& s);
+	public: bc_external_value_t(const typeid_t& type, const immer::flex_vector<bc_external_handle_t>& s);
+	public: bc_external_value_t(const typeid_t& type, const immer::flex_vector<bc_inplace_value_t>& s);
+	public: bc_external_value_t(const typeid_t& type, const std::vector<bc_value_t>& columns);
 	public: bc_external_value_t(const typeid_t& type, const immer::map<std::string, bc_external_handle_t>& s);
 	public: bc_external_value_t(const typeid_t& type, const immer::map<std::string, bc_inplace_value_t>& s);
 
@@ -278,26 +412,134 @@ struct bc_external_value_t {
 	public: typeid_t _debug_type;
 #endif
 	public: std::string _string;
+
+	//	Rope strings keep their characters here, _string stays empty.
+	public: std::unique_ptr<rope_string_t> _rope_string;
+
 	public: std::shared_ptr<json_t> _json_value;
 	public: typeid_t _typeid_value = typeid_t::make_undefined();
 	public: std::vector<bc_value_t> _struct_members;
-	public: immer::vector<bc_external_handle_t> _vector_w_external_elements;
-	public: immer::vector<bc_inplace_value_t> _vector_w_inplace_elements;
+
+	//	Used instead of _struct_members by structs where encode_as_struct_w_inplace_members() is true.
+	public: std::vector<bc_inplace_value_t> _struct_w_inplace_members;
+	public: immer::flex_vector<bc_external_handle_t> _vector_w_external_elements;
+	public: immer::flex_vector<bc_inplace_value_t> _vector_w_inplace_elements;
+
+	//	One [bool] / [int] / [double] vector value per struct member, all the same size.
+	public: std::vector<bc_value_t> _vector_w_struct_columns;
 	public: immer::map<std::string, bc_external_handle_t> _dict_w_external_values;
 	public: immer::map<std::string, bc_inplace_value_t> _dict_w_inplace_values;
 };
 
 
+inline void retain_external(const bc_external_value_t* ext){
+	if(is_small_string(ext) == false){
+		ext->_rc++;
+	}
+}
+
+inline std::string_view get_string_view(const bc_external_value_t* const& ext){
+	if(is_small_string(ext)){
+		const auto bytes = reinterpret_cast<const char*>(&ext);
+		return std::string_view(bytes + 1, static_cast<unsigned char>(bytes[0]) >> 1);
+	}
+	else if(ext->_rope_string){
+		return flatten_rope(ext);
+	}
+	else{
+		return std::string_view(ext->_string);
+	}
+}
+
+inline bool is_rope_string(const bc_external_value_t* const& ext){
+	return is_small_string(ext) == false && ext->_rope_string != nullptr;
+}
+
+inline size_t get_string_size(const bc_external_value_t* const& ext){
+	if(is_rope_string(ext)){
+		return ext->_rope_string->_size;
+	}
+	else{
+		return get_string_view(ext).size();
+	}
+}
+
+//	Doesn't flatten: reading one character of a big string that is being built must stay O(log n).
+inline char get_string_char(const bc_external_value_t* const& ext, size_t index){
+	if(is_rope_string(ext)){
+		const auto& r = *ext->_rope_string;
+		if(r._flattened.load(std::memory_order_acquire)){
+			return r._flat[index];
+		}
+		const auto rope = std::atomic_load(&r._rope);
+		return rope ? (*rope)[index] : flatten_rope(ext)[index];
+	}
+	else{
+		return get_string_view(ext)[index];
+	}
+}
+
+//	For APIs that take a std::string, like immer::map::find(). Returns ext's own std::string, or copies a small string
+//	into temp: it fits in std::string's internal buffer, so that doesn't allocate either.
+inline const std::string& get_std_string(const bc_external_value_t* ext, std::string& temp){
+	if(is_small_string(ext)){
+		temp.assign(get_string_view(ext));
+		return temp;
+	}
+	else if(ext->_rope_string){
+		flatten_rope(ext);
+		return ext->_rope_string->_flat;
+	}
+	else{
+		return ext->_string;
+	}
+}
+
+
 ////////////////////////////////////////////			FREE
 
 
 const immer::vector<bc_value_t> get_vector(const bc_value_t& value);
-const immer::vector<bc_external_handle_t>* get_vector_external_elements(const bc_value_t& value);
-const immer::vector<bc_inplace_value_t>* get_vector_inplace_elements(const bc_value_t& value);
+const immer::flex_vector<bc_external_handle_t>* get_vector_external_elements(const bc_value_t& value);
+const immer::flex_vector<bc_inplace_value_t>* get_vector_inplace_elements(const bc_value_t& value);
 
 bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_value_t>& elements);
-bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_external_handle_t>& elements);
-bc_value_t make_vector(const typeid_t& element_type, const immer::vector<bc_inplace_value_t>& elements);
+bc_value_t make_vector(const typeid_t& element_type, const immer::flex_vector<bc_external_handle_t>& elements);
+bc_value_t make_vector(const typeid_t& element_type, const immer::flex_vector<bc_inplace_value_t>& elements);
+
+
+
+//////////////////////////////////////		STRUCT COLUMNS
+
+/*
+	A [pixel_t] vector, where pixel_t only has bool, int and double members, keeps its elements as columns: one
+	[int] / [double] / [bool] vector per member. There are no per-element struct values to allocate, reference
+	count and chase pointers to. v[i].red reads straight from the red column. v[i] makes a struct value on demand.
+*/
+
+bc_value_t make_vector_w_struct_columns(const typeid_t& element_type, const std::vector<bc_value_t>& columns);
+
+inline size_t get_struct_columns_size(const bc_external_value_t* ext){
+	return ext->_vector_w_struct_columns[0]._pod._external->_vector_w_inplace_elements.size();
+}
+
+bc_value_t get_struct_columns_element(const typeid_t& element_type, const bc_external_value_t* ext, size_t index);
+bc_value_t push_back_struct_columns(const typeid_t& element_type, const bc_external_value_t* ext, const bc_external_value_t* element);
+
+//	Makes a new vector by running f(member_index, column) -> column on each column.
+template <typename F>
+bc_value_t transform_struct_columns(const typeid_t& element_type, const bc_external_value_t* ext, const F& f){
+	const auto& columns = ext->_vector_w_struct_columns;
+	std::vector<bc_value_t> columns2;
+	columns2.reserve(columns.size());
+	for(size_t member_index = 0 ; member_index < columns.size() ; member_index++){
+		const auto& column = columns[member_index];
+		const auto column2 = f(member_index, column._pod._external->_vector_w_inplace_elements);
+		columns2.push_back(make_vector(column._type.get_vector_element_type(), column2));
+	}
+	return make_vector_w_struct_columns(element_type, columns2);
+}
+
 
 const immer::map<std::string, bc_external_handle_t>& get_dict_value(const bc_value_t& value);
 bc_value_t make_dict(const typeid_t& value_type, const immer::map<std::string, bc_external_handle_t>& entries);
@@ -306,6 +548,21 @@ bc_value_t make_dict(const typeid_t& value_type, const immer::map<std::string, b
 json_t bcvalue_to_json(const bc_value_t& v);
 int bc_compare_value_true_deep(const bc_value_t& left, const bc_value_t& right, const typeid_t& type);
 int bc_compare_value_exts(const bc_external_handle_t& left, const bc_external_handle_t& right, const typeid_t& type);
+int compare_inplace_values(const bc_inplace_value_t& left, const bc_inplace_value_t& right, const typeid_t& type);
+
+//	Total order for doubles: NaN sorts after every number and all NaNs are equal. Used by all double comparisons,
+//	so sort(), == and < and the structural hash agree.
+inline int compare_double_values(double left, double right){
+	const bool left_nan = std::isnan(left);
+	const bool right_nan = std::isnan(right);
+	if(left_nan || right_nan){
+		return (left_nan ? 1 : 0) - (right_nan ? 1 : 0);
+	}
+	return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+//	Structural hash: values that bc_compare_value_true_deep() says are equal get the same hash.
+size_t bc_hash_value(const bc_value_t& value, const typeid_t& type);
 
 
 
@@ -392,6 +649,24 @@ enum class bc_opcode: uint8_t {
 	*/
 	k_get_struct_member,
 
+	/*
+		Same as k_get_struct_member, for structs with inplace members.
+
+		A: Register: where to put result
+		B: Register: struct object
+		C: IMMEDIATE: member-index
+	*/
+	k_get_struct_w_inplace_members_member,
+
+	/*
+		Gets the column of one member from a vector with struct columns. v[i].member becomes this + a lookup in the column.
+
+		A: Register: where to put result: a [bool] / [int] / [double] vector
+		B: Register: vector with struct columns
+		C: IMMEDIATE: member-index
+	*/
+	k_get_vector_struct_column,
+
 	/*
 		A: Register: where to put result
 		B: Register: string object/vector object/json_value/dict
@@ -401,6 +676,7 @@ enum class bc_opcode: uint8_t {
 	k_lookup_element_json_value,
 	k_lookup_element_vector_w_external_elements,
 	k_lookup_element_vector_w_inplace_elements,
+	k_lookup_element_vector_w_struct_columns,
 	k_lookup_element_dict_w_external_values,
 	k_lookup_element_dict_w_inplace_values,
 
@@ -411,6 +687,7 @@ enum class bc_opcode: uint8_t {
 	*/
 	k_get_size_vector_w_external_elements,
 	k_get_size_vector_w_inplace_elements,
+	k_get_size_vector_w_struct_columns,
 	k_get_size_dict_w_external_values,
 	k_get_size_dict_w_inplace_values,
 	k_get_size_string,
@@ -423,6 +700,7 @@ enum class bc_opcode: uint8_t {
 	*/
 	k_pushback_vector_w_external_elements,
 	k_pushback_vector_w_inplace_elements,
+	k_pushback_vector_w_struct_columns,
 	k_pushback_string,
 
 	/*
@@ -447,6 +725,7 @@ enum class bc_opcode: uint8_t {
 	k_concat_strings,
 	k_concat_vectors_w_external_elements,
 	k_concat_vectors_w_inplace_elements,
+	k_concat_vectors_w_struct_columns,
 
 	k_subtract_double,
 	k_subtract_int,
@@ -499,7 +778,7 @@ enum class bc_opcode: uint8_t {
 	k_new_1,
 
 	/*
-		Creates a new vector containing object-elements, like strings, structs etc.
+		Creates a new vector containing object-elements, like strings, structs etc. Also vectors with struct columns.
 
 		A: Register: where to put resulting value
 		B: IMMEDIATE: itype T = [E], describing output type of vector, like [int] or [my_pixel].
@@ -809,6 +1088,10 @@ struct bc_program_t {
 	public: std::vector<typeid_t> _types;
 	public: software_system_t _software_system;
 	public: container_t _container_def;
+
+	//	Name -> function ID for each function defined at the top level. Function values are only stored to their
+	//	globals when the global instructions run, this finds them without running anything.
+	public: std::map<std::string, int> _global_functions;
 };
 
 json_t bcprogram_to_json(const bc_program_t& program);
@@ -1025,7 +1308,7 @@ struct interpreter_stack_t {
 		bool is_ext = _current_frame_ptr->_exts[reg];
 		if(is_ext){
 			auto prev_copy = _current_frame_entry_ptr[reg];
-			value._pod._external->_rc++;
+			retain_external(value._pod._external);
 			_current_frame_entry_ptr[reg] = value._pod;
 			release_pod_external(prev_copy);
 		}
@@ -1044,7 +1327,7 @@ struct interpreter_stack_t {
 		QUARK_ASSERT(_current_frame_ptr->_symbols[reg].second._value_type == value._type);
 
 		auto prev_copy = _current_frame_entry_ptr[reg];
-		value._pod._external->_rc++;
+		retain_external(value._pod._external);
 		_current_frame_entry_ptr[reg] = value._pod;
 		release_pod_external(prev_copy);
 
@@ -1098,6 +1381,14 @@ struct interpreter_stack_t {
 		QUARK_ASSERT(check_reg(reg));
 		QUARK_ASSERT(_current_frame_ptr->_symbols[reg].second._value_type.is_vector());
 		QUARK_ASSERT(encode_as_vector_w_inplace_elements(_current_frame_ptr->_symbols[reg].second._value_type) == false);
+		QUARK_ASSERT(encode_as_vector_w_struct_columns(_current_frame_ptr->_symbols[reg].second._value_type) == false);
+		return true;
+	}
+
+	public: bool check_reg_vector_w_struct_columns(const int reg) const{
+		QUARK_ASSERT(check_invariant());
+		QUARK_ASSERT(check_reg(reg));
+		QUARK_ASSERT(encode_as_vector_w_struct_columns(_current_frame_ptr->_symbols[reg].second._value_type) == true);
 		return true;
 	}
 
@@ -1188,7 +1479,7 @@ struct interpreter_stack_t {
 		QUARK_ASSERT(encode_as_external(value._type) == true);
 #endif
 
-		value._pod._external->_rc++;
+		retain_external(value._pod._external);
 		_entries[_stack_size] = value._pod;
 		_stack_size++;
 #if DEBUG
@@ -1258,7 +1549,7 @@ struct interpreter_stack_t {
 		QUARK_ASSERT(_debug_types[pos] == value._type);
 
 		auto prev_copy = _entries[pos];
-		value._pod._external->_rc++;
+		retain_external(value._pod._external);
 		_entries[pos] = value._pod;
 		release_pod_external(prev_copy);
 
@@ -1340,20 +1631,103 @@ struct interpreter_stack_t {
 */
 struct interpreter_handler_i {
 	virtual ~interpreter_handler_i(){};
-	virtual void on_send(const std::string& process_id, const json_t& message) = 0;
+	//	message can be any value. It's immutable, so the runtime can hand it to the receiver as it is.
+	virtual void on_send(const std::string& process_id, const bc_value_t& message) = 0;
+
+	//	channel_id is from get_channel_names().
+	virtual void on_send(int channel_id, const bc_value_t& message) = 0;
+};
+
+
+//////////////////////////////////////		memo_cache_t
+
+/*
+	The memoize tweaker: remembers the results of one pure function, keyed on its argument values.
+	Holds max _max_entries results and evicts the least recently used one.
+	print() is pure but has output: a call that printed, directly or deeper down, isn't cached, so its output is
+	never lost on a cache hit.
+	One cache is shared by all interpreters that use the same program image, from any thread.
+*/
+
+struct memo_cache_t {
+	public: memo_cache_t(const std::string& function_name, const typeid_t& function_type, int64_t max_entries);
+	public: memo_cache_t(const memo_cache_t& other) = delete;
+	public: memo_cache_t& operator=(const memo_cache_t& other) = delete;
+
+	//	Hash outside of the lock, then use the hash for both lookup() and insert().
+	public: size_t hash_args(const bc_value_t args[], int arg_count) const;
+
+	//	Returns true and sets result if the function has been called with these arguments before.
+	public: bool lookup(size_t hash, const bc_value_t args[], int arg_count, bc_value_t& result);
+	public: void insert(size_t hash, const bc_value_t args[], int arg_count, const bc_value_t& result);
+
+	public: size_t get_entry_count() const;
+
+
+	////////////////////////		INTERNALS
+
+	private: struct entry_t {
+		size_t _hash;
+		std::vector<bc_value_t> _args;
+		bc_value_t _result;
+	};
+	private: typedef std::list<entry_t>::iterator entry_it_t;
+
+	private: bool args_equal(const entry_t& entry, const bc_value_t args[], int arg_count) const;
+	private: entry_it_t find(size_t hash, const bc_value_t args[], int arg_count);
+
+
+	////////////////////////		STATE
+
+	public: const std::string _function_name;
+	public: const typeid_t _function_type;
+	public: const int64_t _max_entries;
+
+	public: std::atomic<int64_t> _hit_count;
+	public: std::atomic<int64_t> _miss_count;
+
+	private: mutable std::mutex _mutex;
+
+	//	Most recently used first.
+	private: std::list<entry_t> _entries;
+	private: std::unordered_multimap<size_t, entry_it_t> _index;
 };
 
 
 //////////////////////////////////////		interpreter_imm_t
 
-//	Holds static = immutable state the interpreter wants to keep around.
+/*
+	Holds static = immutable state the interpreter wants to keep around: the compiled program image.
+	Make it once per program and share it between any number of interpreters, worker threads and processes.
+	Each interpreter_t only owns its stack and its globals.
+	IMMUTABLE - safe to read from many threads at once. The memo caches lock internally.
+*/
 
 struct interpreter_imm_t {
 	public: const std::chrono::time_point<std::chrono::high_resolution_clock> _start_time;
 	public: const bc_program_t _program;
 	public: const std::map<int, HOST_FUNCTION_PTR> _host_functions;
+
+	//	One entry per function definition, nullptr if the function has no memoize tweaker.
+	//	Empty when the program has no memoize tweakers at all.
+	public: const std::vector<std::shared_ptr<memo_cache_t>> _memo_caches;
+
+	//	One entry per function definition, nullptr if the function can't run as a numeric kernel.
+	public: const std::vector<std::shared_ptr<const numeric_kernel_t>> _numeric_kernels;
+
+	//	Process name -> channel ID, from get_channel_names(). For get_channel().
+	public: const std::unordered_map<std::string, int> _channel_ids;
 };
 
+//	Sets up memo caches for the memoize tweakers in program._container_def.
+std::shared_ptr<interpreter_imm_t> make_interpreter_imm(const bc_program_t& program);
+
+inline memo_cache_t* get_memo_cache(const interpreter_imm_t& imm, int function_id){
+	return imm._memo_caches.empty() ? nullptr : imm._memo_caches[function_id].get();
+}
+
+void trace_memo_stats(const interpreter_imm_t& imm);
+
 
 //////////////////////////////////////		value_entry_t
 
@@ -1378,6 +1752,13 @@ struct value_entry_t {
 struct interpreter_t {
 	public: explicit interpreter_t(const bc_program_t& program);
 	public: explicit interpreter_t(const bc_program_t& program, interpreter_handler_i* handler);
+
+	//	Attaches to an existing program image and runs the global instructions to setup its own globals.
+	public: explicit interpreter_t(const std::shared_ptr<interpreter_imm_t>& imm, interpreter_handler_i* handler);
+
+	//	Makes a worker interpreter that shares an existing program image. Its global frame starts as a copy of
+	//	*globals* (one value per global, in frame order). The global instructions are NOT run again.
+	public: explicit interpreter_t(const std::shared_ptr<interpreter_imm_t>& imm, interpreter_handler_i* handler, const std::vector<bc_value_t>& globals);
 	public: interpreter_t(const interpreter_t& other) = delete;
 	public: const interpreter_t& operator=(const interpreter_t& other)= delete;
 #if DEBUG
@@ -1402,6 +1783,9 @@ struct interpreter_t {
 
 int get_global_n_pos(int n);
 
+//	Copies the current values of all globals, in frame order. Use to setup worker interpreters.
+std::vector<bc_value_t> copy_globals(const interpreter_t& vm);
+
 bc_value_t call_function_bc(interpreter_t& vm, const bc_value_t& f, const bc_value_t args[], int arg_count);
 json_t interpreter_to_json(const interpreter_t& vm);
 std::pair<bc_typeid_t, bc_value_t> execute_instructions(interpreter_t& vm, const std::vector<bc_instruction_t>& instructions);
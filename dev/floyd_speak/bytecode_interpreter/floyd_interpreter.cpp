@@ -14,10 +14,16 @@
 #include "pass3.h"
 #include "host_functions.h"
 #include "bytecode_generator.h"
+#include "process_scheduler.h"
+#include "mpsc_queue.h"
+#include "thread_priority.h"
 
 #include <thread>
 #include <deque>
+#include <unordered_map>
 #include <future>
+#include <chrono>
+#include <atomic>
 
 #include <pthread.h>
 #include <condition_variable>
@@ -104,6 +110,12 @@ value_t bc_to_value(const bc_value_t& value){
 				vec2.push_back(value_t::make_double(e._double));
 			}
 		}
+		else if(encode_as_vector_w_struct_columns(type)){
+			const auto size = get_struct_columns_size(value._pod._external);
+			for(size_t i = 0 ; i < size ; i++){
+				vec2.push_back(bc_to_value(get_struct_columns_element(element_type, value._pod._external, i)));
+			}
+		}
 		else{
 			for(const auto& e: value._pod._external->_vector_w_external_elements){
 				QUARK_ASSERT(e.check_invariant());
@@ -195,27 +207,27 @@ bc_value_t value_to_bc(const value_t& value){
 
 		if(encode_as_vector_w_inplace_elements(vector_type)){
 			const auto& vec = value.get_vector_value();
-			immer::vector<bc_inplace_value_t> vec2;
+			immer::flex_vector<bc_inplace_value_t> vec2;
 			if(element_type.is_bool()){
 				for(const auto& e: vec){
-					vec2.push_back(bc_inplace_value_t{._bool = e.get_bool_value()});
+					vec2 = vec2.push_back(bc_inplace_value_t{._bool = e.get_bool_value()});
 				}
 			}
 			else if(element_type.is_int()){
 				for(const auto& e: vec){
-					vec2.push_back(bc_inplace_value_t{._int64 = e.get_int_value()});
+					vec2 = vec2.push_back(bc_inplace_value_t{._int64 = e.get_int_value()});
 				}
 			}
 			else if(element_type.is_double()){
 				for(const auto& e: vec){
-					vec2.push_back(bc_inplace_value_t{._double = e.get_double_value()});
+					vec2 = vec2.push_back(bc_inplace_value_t{._double = e.get_double_value()});
 				}
 			}
 			return make_vector(element_type, vec2);
 		}
 		else{
 			const auto& vec = value.get_vector_value();
-			immer::vector<bc_external_handle_t> vec2;
+			immer::flex_vector<bc_external_handle_t> vec2;
 			for(const auto& e: vec){
 				const auto bc = value_to_bc(e);
 				const auto hand = bc_external_handle_t(bc);
@@ -508,105 +520,588 @@ std::string get_current_thread_name(){
 
 struct process_interface {
 	virtual ~process_interface(){};
-	virtual void on_message(const json_t& message) = 0;
+	virtual void on_message(const bc_value_t& message) = 0;
 	virtual void on_init() = 0;
 };
 
 
-//	NOTICE: Each process inbox has its own mutex + condition variable. No mutex protects cout.
-struct process_t {
-	std::condition_variable _inbox_condition_variable;
-	std::mutex _inbox_mutex;
-	std::deque<json_t> _inbox;
+/*
+	A process with an inbox capacity in container-def gets this inbox instead of the clock's lock-free one: the policies
+	need to look at and change the messages that are waiting. Messages from the process's own clock go here too, so
+	everything that waits counts. The clock moves them all to _pending at the start of each tick.
+*/
+struct bounded_inbox_t {
+	inbox_config_t _config;
+
+	std::mutex _mutex;
+	std::condition_variable _not_full;
+	std::deque<bc_value_t> _messages;
+
+	//	The process has stopped or the container is shutting down: messages are dropped and nobody blocks.
+	bool _closed = false;
 
+	//	Counters, traced with -t.
+	int64_t _max_depth = 0;
+	int64_t _dropped = 0;
+	int64_t _coalesced = 0;
+	int64_t _blocked_sends = 0;
+};
+
+//	NOTICE: A process is only ever run by its clock's executor, so the interpreter, the state and _pending need no lock.
+//	No mutex protects cout.
+struct process_t {
 	std::string _name_key;
 	std::string _function_key;
-	std::thread::id _thread_id;
+	int _clock_index = -1;
 
 	std::shared_ptr<interpreter_t> _interpreter;
 	std::shared_ptr<value_entry_t> _init_function;
 	std::shared_ptr<value_entry_t> _process_function;
-	value_t _process_state;
+
+	//	Optional "__batch" variant of the process function: gets up to _max_batch_size messages per call, as a vector.
+	std::shared_ptr<value_entry_t> _batch_function;
+	int64_t _max_batch_size = 0;
+
+	//	Type of the process function's message argument. Messages are converted to it when they are sent.
+	typeid_t _message_type = typeid_t::make_json_value();
+
+	//	Kept as the interpreter's own value between messages, so handling a message doesn't depend on its size.
+	bc_value_t _process_state;
+
+	//	Messages to handle in the clock's next tick.
+	std::vector<bc_value_t> _pending;
+
+	//	What the clock's timer sends, already converted to the message type.
+	bc_value_t _tick_message;
+
+	//	Null = unbounded.
+	std::unique_ptr<bounded_inbox_t> _bounded_inbox;
+	bool _stopped = false;
 
 
 	std::shared_ptr<process_interface> _processor;
 };
 
+struct process_message_t {
+	int _process_id;
+	bc_value_t _message;
+};
+
+/*
+	All processes synced to one clock bus run on the same executor, one tick at a time, in the order they are listed in
+	the container-def. A tick delivers each process the messages that were waiting for it when the tick started.
+	Messages between processes on the same clock go straight into _pending and arrive next tick: no atomics, no locks and
+	the same order every run.
+*/
+struct clock_stats_t {
+	std::atomic<int64_t> _ticks { 0 };
+
+	//	Ticks that were still running when the next tick was due.
+	std::atomic<int64_t> _deadline_misses { 0 };
+
+	//	Ticks that were dropped because the clock hadn't even started on the previous tick when they were due.
+	std::atomic<int64_t> _skipped_ticks { 0 };
+
+	//	Worst delay from when a tick was due to when it started: wakeup + scheduling jitter.
+	std::atomic<int64_t> _max_lateness_ns { 0 };
+
+	bool _realtime_granted = false;
+	bool _pinned = false;
+};
+
+struct clock_executor_t {
+	std::string _name;
+	std::vector<int> _process_ids;
+	bool _initialized = false;
+	int _live_count = 0;
+	std::atomic<bool> _done { false };
+
+	//	Messages from processes on other clocks. Lock-free, any thread can push. Drained at the start of each tick.
+	mpsc_queue_t<process_message_t> _inbox;
+
+	clock_timer_t _timer;
+
+	//	When the timer's pending tick was due, in steady_clock nanoseconds. 0 = no timer tick pending.
+	std::atomic<int64_t> _timer_due_ns { 0 };
+
+	clock_stats_t _stats;
+
+	//	The clock's index in the scheduler. -1 when the clock runs on its own thread instead.
+	int _task_index = -1;
+};
+
 struct process_runtime_t {
 	container_t _container;
-	std::map<std::string, std::string> _process_infos;
 	std::thread::id _main_thread_id;
 
+	//	Index is the process ID, which is also its channel ID: see get_channel_names().
 	std::vector<std::shared_ptr<process_t>> _processes;
-	std::vector<std::thread> _worker_threads;
+	std::vector<std::shared_ptr<clock_executor_t>> _clocks;
+
+	//	For send() with a process name that wasn't resolved at compile time.
+	std::unordered_map<std::string, int> _process_ids_by_name;
+
+	//	Multiplexes the clocks onto a few worker threads. Only set while the container runs.
+	process_scheduler_t* _scheduler = nullptr;
+
+	//	Tells the timer thread and the dedicated clock threads to quit, when the container is done or has failed.
+	std::atomic<bool> _stop { false };
+	std::mutex _timer_mutex;
+	std::condition_variable _timer_wake;
 };
 
 /*
 ??? have ONE runtime PER computer or one per interpreter?
-??? Separate system-interpreter (all processes and many clock busses) vs ONE thread of execution?
 */
 
-void send_message(process_runtime_t& runtime, int process_id, const json_t& message){
-	auto& process = *runtime._processes[process_id];
+//	"stop" terminates any process, whatever its message type.
+bool is_stop_message(const bc_value_t& message){
+	if(message._type.is_string()){
+		return message.get_string_value() == "stop";
+	}
+	else if(message._type.is_json_value()){
+		const auto& j = message.get_json_value();
+		return j.is_string() && j.get_string() == "stop";
+	}
+	else{
+		return false;
+	}
+}
+
+//	Messages are immutable values: usually the receiver gets the very same bc_value_t as the sender. Process functions
+//	that take a json_value get other types converted to JSON, which is what send() used to require.
+bc_value_t make_process_message(const process_t& process, const bc_value_t& message){
+	if(message._type == process._message_type || is_stop_message(message)){
+		return message;
+	}
+	else if(process._message_type.is_json_value()){
+		return bc_value_t::make_json_value(value_to_ast_json(bc_to_value(message), json_tags::k_plain)._value);
+	}
+	else{
+		quark::throw_runtime_error(
+			"Process \"" + process._name_key + "\" takes messages of type " + typeid_to_compact_string(process._message_type)
+			+ ", cannot send " + typeid_to_compact_string(message._type) + "."
+		);
+	}
+}
+
+//	What identifies a message for k_coalesce: a struct member or JSON object member, else the whole message.
+bc_value_t get_coalesce_key(const bc_value_t& message, const std::string& key){
+	if(key.empty() == false){
+		if(message._type.is_struct()){
+			const auto member_index = find_struct_member_index(message._type.get_struct(), key);
+			if(member_index != -1){
+				return message.get_struct_value()[member_index];
+			}
+		}
+		else if(message._type.is_json_value()){
+			const auto& j = message.get_json_value();
+			if(j.is_object() && j.does_object_element_exist(key)){
+				return bc_value_t::make_json_value(j.get_object_element(key));
+			}
+		}
+	}
+	return message;
+}
+
+bool is_same_coalesce_key(const bc_value_t& a, const bc_value_t& b){
+	return a._type == b._type && bc_compare_value_true_deep(a, b, a._type) == 0;
+}
 
-    {
-        std::lock_guard<std::mutex> lk(process._inbox_mutex);
-        process._inbox.push_front(message);
-        QUARK_TRACE("Notifying...");
-    }
-    process._inbox_condition_variable.notify_one();
-//    process._inbox_condition_variable.notify_all();
+//	Makes room by dropping the oldest message, but never a "stop". Returns false if there was nothing to drop.
+bool drop_oldest_message(bounded_inbox_t& inbox){
+	const auto it = std::find_if(inbox._messages.begin(), inbox._messages.end(), [](const bc_value_t& m){ return is_stop_message(m) == false; });
+	if(it == inbox._messages.end()){
+		return false;
+	}
+	inbox._messages.erase(it);
+	inbox._dropped++;
+	return true;
 }
 
-void process_process(process_runtime_t& runtime, int process_id){
+void push_bounded_message(bounded_inbox_t& inbox, const bc_value_t& message, bool may_block){
+	std::unique_lock<std::mutex> lock(inbox._mutex);
+	if(inbox._closed){
+		return;
+	}
+
+	const auto capacity = inbox._config._capacity;
+	const auto policy = inbox._config._policy;
+	const auto is_full = [&](){ return static_cast<int64_t>(inbox._messages.size()) >= capacity; };
+
+	if(is_stop_message(message)){
+	}
+	else if(policy == inbox_policy::k_coalesce){
+		const auto key = get_coalesce_key(message, inbox._config._coalesce_key);
+		const auto it = std::find_if(inbox._messages.begin(), inbox._messages.end(), [&](const bc_value_t& m){
+			return is_stop_message(m) == false && is_same_coalesce_key(get_coalesce_key(m, inbox._config._coalesce_key), key);
+		});
+		if(it != inbox._messages.end()){
+			*it = message;
+			inbox._coalesced++;
+			return;
+		}
+		if(is_full()){
+			drop_oldest_message(inbox);
+		}
+	}
+	else if(is_full()){
+		//	k_block can't wait for a receiver on the sender's own clock: drop the message like k_drop_newest.
+		if(policy == inbox_policy::k_drop_newest || (policy == inbox_policy::k_block && may_block == false)){
+			inbox._dropped++;
+			return;
+		}
+		else if(policy == inbox_policy::k_drop_oldest){
+			drop_oldest_message(inbox);
+		}
+		else if(policy == inbox_policy::k_block){
+			inbox._blocked_sends++;
+			inbox._not_full.wait(lock, [&](){ return inbox._closed || is_full() == false; });
+			if(inbox._closed){
+				return;
+			}
+		}
+	}
+
+	inbox._messages.push_back(message);
+	inbox._max_depth = std::max(inbox._max_depth, static_cast<int64_t>(inbox._messages.size()));
+}
+
+void close_bounded_inbox(bounded_inbox_t& inbox){
+	{
+		std::lock_guard<std::mutex> lock(inbox._mutex);
+		inbox._closed = true;
+		inbox._messages.clear();
+	}
+	inbox._not_full.notify_all();
+}
+
+//	from_process_id is -1 when the message doesn't come from a process.
+void send_message(process_runtime_t& runtime, int from_process_id, int process_id, const bc_value_t& message){
 	auto& process = *runtime._processes[process_id];
-	bool stop = false;
+	const auto message2 = make_process_message(process, message);
+
+	const auto same_clock = from_process_id != -1 && runtime._processes[from_process_id]->_clock_index == process._clock_index;
+
+	//	Same clock: we are running on its executor right now.
+	if(same_clock && process._bounded_inbox == nullptr){
+		if(process._stopped == false){
+			process._pending.push_back(message2);
+		}
+	}
+	else if(same_clock){
+		push_bounded_message(*process._bounded_inbox, message2, false);
+	}
+	else{
+		auto& clock = *runtime._clocks[process._clock_index];
+		if(process._bounded_inbox){
+			push_bounded_message(*process._bounded_inbox, message2, true);
+		}
+		else{
+			clock._inbox.push(process_message_t{ process_id, message2 });
+		}
+
+		//	A clock with its own thread picks up the message on its next tick.
+		if(clock._task_index != -1){
+			QUARK_TRACE("Notifying...");
+			runtime._scheduler->notify(clock._task_index);
+		}
+	}
+}
+
+int64_t get_steady_time_ns(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t get_period_ns(const clock_timer_t& timer){
+	return std::max(int64_t(1), static_cast<int64_t>(timer._period_ms * 1000000.0));
+}
+
+//	A clock takes at most this many messages from other clocks into one tick.
+static const int k_max_inbox_messages_per_tick = 256;
+
+//	For processes with a __batch function but no entry in the container-def's "batches".
+static const int64_t k_default_max_batch_size = 64;
 
-	const auto thread_name = get_current_thread_name();
+void handle_message(process_t& process, const bc_value_t& message){
+	QUARK_TRACE_SS("RECEIVED: " << typeid_to_compact_string(message._type));
 
 	if(process._processor){
-		process._processor->on_init();
+		process._processor->on_message(message);
+	}
+
+	if(process._process_function != nullptr){
+		const bc_value_t args[] = { process._process_state, message };
+		process._process_state = call_function_bc(*process._interpreter, process._process_function->_value, args, 2);
+	}
+}
+
+//	One call to the process's __batch function, with messages [begin, end).
+void handle_message_batch(process_t& process, std::vector<bc_value_t>::const_iterator begin, std::vector<bc_value_t>::const_iterator end){
+	QUARK_TRACE_SS("RECEIVED BATCH: " << (end - begin));
+
+	if(process._processor){
+		for(auto it = begin ; it != end ; it++){
+			process._processor->on_message(*it);
+		}
+	}
+
+	immer::vector<bc_value_t> messages;
+	for(auto it = begin ; it != end ; it++){
+		messages = messages.push_back(*it);
+	}
+	const bc_value_t args[] = { process._process_state, make_vector(process._message_type, messages) };
+	process._process_state = call_function_bc(*process._interpreter, process._batch_function->_value, args, 2);
+}
+
+void stop_process(clock_executor_t& clock, process_t& process){
+	QUARK_TRACE_SS(get_current_thread_name() << ": STOP " << process._name_key);
+	process._stopped = true;
+	process._pending.clear();
+	if(process._bounded_inbox){
+		close_bounded_inbox(*process._bounded_inbox);
 	}
+	clock._live_count--;
+}
+
+//	Runs one tick of the clock on the calling worker. The first tick starts with the init functions.
+process_scheduler_t::slice_result run_clock_tick(process_runtime_t& runtime, int clock_index){
+	auto& clock = *runtime._clocks[clock_index];
 
-	if(process._init_function != nullptr){
-		const std::vector<value_t> args = {};
-		process._process_state = call_function(*process._interpreter, bc_to_value(process._init_function->_value), args);
+	if(clock._initialized == false){
+		clock._initialized = true;
+
+		for(const auto process_id: clock._process_ids){
+			auto& process = *runtime._processes[process_id];
+			if(process._processor){
+				process._processor->on_init();
+			}
+			if(process._init_function != nullptr){
+				process._process_state = call_function_bc(*process._interpreter, process._init_function->_value, nullptr, 0);
+			}
+		}
 	}
 
-	while(stop == false){
-		json_t message;
-		{
-			std::unique_lock<std::mutex> lk(process._inbox_mutex);
+	//	The timer's "tick" goes after the messages that have already arrived.
+	const auto timer_due_ns = clock._timer_due_ns.exchange(0);
+	if(timer_due_ns != 0){
+		const auto lateness_ns = get_steady_time_ns() - timer_due_ns;
+		auto max_lateness_ns = clock._stats._max_lateness_ns.load();
+		while(lateness_ns > max_lateness_ns && clock._stats._max_lateness_ns.compare_exchange_weak(max_lateness_ns, lateness_ns)){
+		}
+	}
 
-        	QUARK_TRACE_SS(thread_name << ": waiting......");
-			process._inbox_condition_variable.wait(lk, [&]{ return process._inbox.empty() == false; });
-        	QUARK_TRACE_SS(thread_name << ": continue");
+	std::vector<process_message_t> incoming;
+	clock._inbox.pop_batch(incoming, k_max_inbox_messages_per_tick);
+	for(auto& e: incoming){
+		auto& process = *runtime._processes[e._process_id];
+		if(process._stopped == false){
+			process._pending.push_back(std::move(e._message));
+		}
+	}
 
-			//	Pop message.
-			QUARK_ASSERT(process._inbox.empty() == false);
-			message = process._inbox.back();
-			process._inbox.pop_back();
+	for(const auto process_id: clock._process_ids){
+		auto& process = *runtime._processes[process_id];
+		if(process._bounded_inbox && process._stopped == false){
+			auto& inbox = *process._bounded_inbox;
+			{
+				std::lock_guard<std::mutex> lock(inbox._mutex);
+				process._pending.insert(process._pending.end(), inbox._messages.begin(), inbox._messages.end());
+				inbox._messages.clear();
+			}
+			inbox._not_full.notify_all();
 		}
-		QUARK_TRACE_SS("RECEIVED: " << json_to_pretty_string(message));
+	}
 
-		if(message.is_string() && message.get_string() == "stop"){
-			stop = true;
-        	QUARK_TRACE_SS(thread_name << ": STOP");
+	if(timer_due_ns != 0){
+		for(const auto process_id: clock._process_ids){
+			auto& process = *runtime._processes[process_id];
+			if(process._stopped == false){
+				process._pending.push_back(process._tick_message);
+			}
 		}
-		else{
-			if(process._processor){
-				process._processor->on_message(message);
+	}
+
+	//	Take every process's batch before running any of them: what they send each other now is for the next tick.
+	std::vector<std::vector<bc_value_t>> batches(clock._process_ids.size());
+	for(int i = 0 ; i < batches.size() ; i++){
+		batches[i].swap(runtime._processes[clock._process_ids[i]]->_pending);
+	}
+
+	for(int i = 0 ; i < batches.size() ; i++){
+		auto& process = *runtime._processes[clock._process_ids[i]];
+		const auto& batch = batches[i];
+		auto it = batch.cbegin();
+		while(it != batch.cend()){
+			if(is_stop_message(*it)){
+				stop_process(clock, process);
+				break;
+			}
+			else if(process._batch_function != nullptr){
+				//	Everything up to the next "stop", at most _max_batch_size messages.
+				auto end = it;
+				while(end != batch.cend() && end - it < process._max_batch_size && is_stop_message(*end) == false){
+					end++;
+				}
+				handle_message_batch(process, it, end);
+				it = end;
+			}
+			else{
+				handle_message(process, *it);
+				it++;
+			}
+		}
+	}
+
+	if(timer_due_ns != 0){
+		clock._stats._ticks++;
+		if(get_steady_time_ns() > timer_due_ns + get_period_ns(clock._timer)){
+			clock._stats._deadline_misses++;
+		}
+	}
+
+	if(clock._live_count == 0){
+		clock._done = true;
+		return process_scheduler_t::slice_result::k_done;
+	}
+
+	const auto more = clock._inbox.empty() == false || std::any_of(
+		clock._process_ids.begin(),
+		clock._process_ids.end(),
+		[&](int process_id){
+			const auto& process = *runtime._processes[process_id];
+			if(process._pending.empty() == false){
+				return true;
+			}
+			else if(process._bounded_inbox){
+				std::lock_guard<std::mutex> lock(process._bounded_inbox->_mutex);
+				return process._bounded_inbox->_messages.empty() == false;
+			}
+			else{
+				return false;
 			}
+		}
+	);
+	return more ? process_scheduler_t::slice_result::k_yield : process_scheduler_t::slice_result::k_idle;
+}
 
-			if(process._process_function != nullptr){
-				const std::vector<value_t> args = { process._process_state, value_t::make_json_value(message) };
-				const auto& state2 = call_function(*process._interpreter, bc_to_value(process._process_function->_value), args);
-				process._process_state = state2;
+//	One thread drives the timers of all clocks that run on the scheduler. A tick that is due while the clock hasn't started
+//	on the previous one is skipped, so a clock that can't keep up doesn't pile up ticks.
+void run_clock_timers(process_runtime_t& runtime, const std::vector<int>& clock_indexes){
+	const auto start_ns = get_steady_time_ns();
+	std::vector<int64_t> next_due_ns;
+	for(const auto clock_index: clock_indexes){
+		next_due_ns.push_back(start_ns + get_period_ns(runtime._clocks[clock_index]->_timer));
+	}
+
+	std::unique_lock<std::mutex> lock(runtime._timer_mutex);
+	while(runtime._stop == false){
+		const auto earliest_ns = *std::min_element(next_due_ns.begin(), next_due_ns.end());
+		const auto earliest = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(earliest_ns));
+		runtime._timer_wake.wait_until(lock, earliest, [&](){ return runtime._stop.load(); });
+		if(runtime._stop){
+			break;
+		}
+
+		const auto now_ns = get_steady_time_ns();
+		for(int i = 0 ; i < clock_indexes.size() ; i++){
+			auto& clock = *runtime._clocks[clock_indexes[i]];
+			if(next_due_ns[i] <= now_ns && clock._done == false){
+				int64_t expected = 0;
+				if(clock._timer_due_ns.compare_exchange_strong(expected, next_due_ns[i])){
+					runtime._scheduler->notify(clock._task_index);
+				}
+				else{
+					clock._stats._skipped_ticks++;
+				}
+
+				const auto period_ns = get_period_ns(clock._timer);
+				next_due_ns[i] += period_ns;
+				while(next_due_ns[i] <= now_ns){
+					next_due_ns[i] += period_ns;
+					clock._stats._skipped_ticks++;
+				}
 			}
 		}
 	}
 }
 
+//	A clock with its own thread: sleeps until the next tick is due, then runs it right there. Messages from other clocks
+//	are handled in the next tick.
+void run_dedicated_clock(process_runtime_t& runtime, int clock_index){
+	auto& clock = *runtime._clocks[clock_index];
+
+#ifdef __APPLE__
+	pthread_setname_np(("clock " + clock._name).substr(0, 15).c_str());
+#endif
+	if(clock._timer._realtime){
+		clock._stats._realtime_granted = make_current_thread_realtime();
+	}
+	if(clock._timer._cpu != -1){
+		clock._stats._pinned = pin_current_thread_to_cpu(clock._timer._cpu);
+	}
+
+	const auto period_ns = get_period_ns(clock._timer);
+	auto due_ns = get_steady_time_ns();
+	while(runtime._stop == false){
+		clock._timer_due_ns = due_ns;
+		if(run_clock_tick(runtime, clock_index) == process_scheduler_t::slice_result::k_done){
+			break;
+		}
+
+		due_ns += period_ns;
+		const auto now_ns = get_steady_time_ns();
+		while(due_ns <= now_ns){
+			due_ns += period_ns;
+			clock._stats._skipped_ticks++;
+		}
+		std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(due_ns)));
+	}
+}
+
+void trace_clock_stats(const process_runtime_t& runtime){
+	QUARK_SCOPED_TRACE("clock timers:");
+	for(const auto& clock: runtime._clocks){
+		if(clock->_timer._period_ms > 0.0){
+			const auto& stats = clock->_stats;
+			QUARK_TRACE_SS(
+				clock->_name
+				<< ": ticks: " << stats._ticks
+				<< ", deadline misses: " << stats._deadline_misses
+				<< ", skipped: " << stats._skipped_ticks
+				<< ", max lateness: " << stats._max_lateness_ns / 1000 << " us"
+				<< (clock->_timer._realtime ? (stats._realtime_granted ? ", SCHED_FIFO" : ", SCHED_FIFO refused") : "")
+				<< (clock->_timer._cpu != -1 ? (stats._pinned ? ", pinned" : ", pinning refused") : "")
+			);
+		}
+	}
+}
+
+//	Wakes up senders blocked on full inboxes when the container fails.
+void close_all_bounded_inboxes(process_runtime_t& runtime){
+	for(const auto& process: runtime._processes){
+		if(process->_bounded_inbox){
+			close_bounded_inbox(*process->_bounded_inbox);
+		}
+	}
+}
+
+void trace_inbox_stats(const process_runtime_t& runtime){
+	QUARK_SCOPED_TRACE("bounded inboxes:");
+	for(const auto& process: runtime._processes){
+		if(process->_bounded_inbox){
+			const auto& inbox = *process->_bounded_inbox;
+			QUARK_TRACE_SS(
+				process->_name_key
+				<< ": max depth: " << inbox._max_depth << "/" << inbox._config._capacity
+				<< ", dropped: " << inbox._dropped
+				<< ", coalesced: " << inbox._coalesced
+				<< ", blocked sends: " << inbox._blocked_sends
+			);
+		}
+	}
+}
+
 std::map<std::string, value_t> run_container_int(const bc_program_t& program, const std::vector<floyd::value_t>& args, const std::string& container_key){
 	process_runtime_t runtime;
 	runtime._main_thread_id = std::this_thread::get_id();
@@ -630,67 +1125,209 @@ std::map<std::string, value_t> run_container_int(const bc_program_t& program, co
 
 	runtime._container = program._container_def;
 
-	runtime._process_infos = reduce(runtime._container._clock_busses, std::map<std::string, std::string>(), [](const std::map<std::string, std::string>& acc, const std::pair<std::string, clock_bus_t>& e){
-		auto acc2 = acc;
-		acc2.insert(e.second._processes.begin(), e.second._processes.end());
-		return acc2;
-	});
-
+	//	One handler per process, so send() knows who is sending.
 	struct my_interpreter_handler_t : public interpreter_handler_i {
-		my_interpreter_handler_t(process_runtime_t& runtime) : _runtime(runtime) {}
+		my_interpreter_handler_t(process_runtime_t& runtime, int process_id) : _runtime(runtime), _process_id(process_id) {}
+
+		virtual void on_send(const std::string& process_id, const bc_value_t& message){
+			const auto it = _runtime._process_ids_by_name.find(process_id);
+			if(it != _runtime._process_ids_by_name.end()){
+				send_message(_runtime, _process_id, it->second, message);
+			}
+		}
 
-		virtual void on_send(const std::string& process_id, const json_t& message){
-			const auto it = std::find_if(_runtime._processes.begin(), _runtime._processes.end(), [&](const std::shared_ptr<process_t>& process){ return process->_name_key == process_id; });
-			if(it != _runtime._processes.end()){
-				const auto process_index = it - _runtime._processes.begin();
-				send_message(_runtime, static_cast<int>(process_index), message);
+		virtual void on_send(int channel_id, const bc_value_t& message){
+			if(channel_id < 0 || channel_id >= _runtime._processes.size()){
+				quark::throw_runtime_error("Unknown channel " + std::to_string(channel_id) + ".");
 			}
+			send_message(_runtime, _process_id, channel_id, message);
 		}
 
 		process_runtime_t& _runtime;
+		int _process_id;
 	};
-	auto my_interpreter_handler = my_interpreter_handler_t{runtime};
+	std::vector<std::unique_ptr<my_interpreter_handler_t>> handlers;
+
+
+	//	All processes run the same program: they share one program image and only get their own stack + globals.
+	const auto imm = make_interpreter_imm(program);
+
+	for(const auto& clock_bus: runtime._container._clock_busses){
+		auto clock = std::make_shared<clock_executor_t>();
+		clock->_name = clock_bus.first;
+
+		for(const auto& t: clock_bus.second._processes){
+			const auto process_id = static_cast<int>(runtime._processes.size());
+			handlers.push_back(std::make_unique<my_interpreter_handler_t>(runtime, process_id));
+
+			auto process = std::make_shared<process_t>();
+			process->_name_key = t.first;
+			process->_function_key = t.second;
+			process->_clock_index = static_cast<int>(runtime._clocks.size());
+			process->_interpreter = std::make_shared<interpreter_t>(imm, handlers.back().get());
+			process->_init_function = find_global_symbol2(*process->_interpreter, t.second + "__init");
+			process->_process_function = find_global_symbol2(*process->_interpreter, t.second);
+			if(process->_process_function != nullptr){
+				const auto process_args = process->_process_function->_symbol._value_type.get_function_args();
+				if(process_args.size() == 2){
+					process->_message_type = process_args[1];
+				}
+			}
 
+			//	Defining f__batch(state, [message]) switches the process to batched delivery.
+			process->_batch_function = find_global_symbol2(*process->_interpreter, t.second + "__batch");
+			if(process->_batch_function != nullptr){
+				const auto batch_args = process->_batch_function->_symbol._value_type.get_function_args();
+				const auto element_type = batch_args.size() == 2 && batch_args[1].is_vector() ? batch_args[1].get_vector_element_type() : typeid_t::make_undefined();
+				if(element_type.is_undefined() || (process->_process_function != nullptr && element_type != process->_message_type)){
+					quark::throw_runtime_error(
+						"Function \"" + t.second + "__batch\" needs to take the state and a vector of "
+						+ (process->_process_function != nullptr ? typeid_to_compact_string(process->_message_type) : "messages") + "."
+					);
+				}
+				process->_message_type = element_type;
 
-	for(const auto& t: runtime._process_infos){
-		auto process = std::make_shared<process_t>();
-		process->_name_key = t.first;
-		process->_function_key = t.second;
-		process->_interpreter = std::make_shared<interpreter_t>(program, &my_interpreter_handler);
-		process->_init_function = find_global_symbol2(*process->_interpreter, t.second + "__init");
-		process->_process_function = find_global_symbol2(*process->_interpreter, t.second);
+				const auto batch_size_it = runtime._container._batch_sizes.find(t.first);
+				process->_max_batch_size = batch_size_it != runtime._container._batch_sizes.end() ? batch_size_it->second : k_default_max_batch_size;
+			}
+			else if(runtime._container._batch_sizes.count(t.first) > 0){
+				quark::throw_runtime_error("Process \"" + t.first + "\" has a batch size but there is no function \"" + t.second + "__batch\".");
+			}
 
-		runtime._processes.push_back(process);
-	}
+			if(clock_bus.second._timer._period_ms > 0.0){
+				process->_tick_message = make_process_message(*process, bc_value_t::make_string("tick"));
+			}
+
+			const auto inbox_it = runtime._container._inboxes.find(t.first);
+			if(inbox_it != runtime._container._inboxes.end()){
+				process->_bounded_inbox = std::make_unique<bounded_inbox_t>();
+				process->_bounded_inbox->_config = inbox_it->second;
+			}
 
-	//	Remember that current thread (main) is also a thread, no need to create a worker thread for one process.
-	runtime._processes[0]->_thread_id = runtime._main_thread_id;
+			runtime._processes.push_back(process);
+			runtime._process_ids_by_name.insert({ t.first, process_id });
+			clock->_process_ids.push_back(process_id);
+		}
 
-	for(int process_id = 1 ; process_id < runtime._processes.size() ; process_id++){
-		runtime._worker_threads.push_back(std::thread([&](int process_id){
+		clock->_live_count = static_cast<int>(clock->_process_ids.size());
+		clock->_timer = clock_bus.second._timer;
+		if(clock->_live_count > 0){
+			runtime._clocks.push_back(clock);
+		}
+	}
 
-//			const auto native_thread = thread::native_handle();
+	//	Clocks that asked for real-time priority or a CPU get their own thread. The rest are tasks for the scheduler:
+	//	clocks run in parallel on a few worker threads, the processes of one clock never do.
+	std::vector<int> task_clock_indexes;
+	std::vector<int> timer_clock_indexes;
+	std::vector<int> dedicated_clock_indexes;
+	for(int clock_index = 0 ; clock_index < runtime._clocks.size() ; clock_index++){
+		auto& clock = *runtime._clocks[clock_index];
+		if(clock._timer._period_ms > 0.0 && (clock._timer._realtime || clock._timer._cpu != -1)){
+			dedicated_clock_indexes.push_back(clock_index);
+		}
+		else{
+			clock._task_index = static_cast<int>(task_clock_indexes.size());
+			task_clock_indexes.push_back(clock_index);
+			if(clock._timer._period_ms > 0.0){
+				timer_clock_indexes.push_back(clock_index);
+			}
+		}
+	}
 
-			std::stringstream thread_name;
-			thread_name << std::string() << "process " << process_id << " thread";
-#ifdef __APPLE__
-			pthread_setname_np(/*pthread_self(),*/ thread_name.str().c_str());
-#endif
+	QUARK_ASSERT(get_channel_names(runtime._container).size() == runtime._processes.size());
 
-			process_process(runtime, process_id);
-		}, process_id));
+	for(const auto& e: runtime._container._inboxes){
+		if(runtime._process_ids_by_name.count(e.first) == 0){
+			quark::throw_runtime_error("Inbox for unknown process \"" + e.first + "\".");
+		}
 	}
 
-	process_process(runtime, 0);
+	//	A sender blocked on a full inbox holds on to its worker thread. Give each clock a worker so the receiver can
+	//	always run and make room.
+	const auto task_count = static_cast<int>(task_clock_indexes.size());
+	const auto blocking = std::any_of(runtime._container._inboxes.begin(), runtime._container._inboxes.end(), [](const std::pair<std::string, inbox_config_t>& e){
+		return e.second._policy == inbox_policy::k_block;
+	});
+	process_scheduler_t scheduler(blocking ? std::max(1, task_count) : get_process_worker_count(task_count));
+	runtime._scheduler = &scheduler;
+
+	std::mutex error_mutex;
+	std::exception_ptr error;
+	std::vector<std::thread> dedicated_threads;
+	std::thread timer_thread;
+
+	//	Started once the scheduler is running: a dedicated clock's first tick may send() to a scheduler clock at once.
+	const auto start_threads = [&](){
+		for(const auto clock_index: dedicated_clock_indexes){
+			dedicated_threads.push_back(std::thread([&, clock_index](){
+				try {
+					run_dedicated_clock(runtime, clock_index);
+				}
+				catch(...){
+					{
+						std::lock_guard<std::mutex> lock(error_mutex);
+						if(!error){
+							error = std::current_exception();
+						}
+					}
+					runtime._stop = true;
+					close_all_bounded_inboxes(runtime);
+					scheduler.cancel(std::current_exception());
+				}
+			}));
+		}
+		if(timer_clock_indexes.empty() == false){
+			timer_thread = std::thread([&](){ run_clock_timers(runtime, timer_clock_indexes); });
+		}
+	};
+
+	//	The calling thread (main) waits until every process has received "stop".
+	try {
+		scheduler.run(
+			task_count,
+			[&](int worker_index, int task_index){
+				return run_clock_tick(runtime, task_clock_indexes[task_index]);
+			},
+			start_threads
+		);
+	}
+	catch(...){
+		std::lock_guard<std::mutex> lock(error_mutex);
+		if(!error){
+			error = std::current_exception();
+		}
+		runtime._stop = true;
+		close_all_bounded_inboxes(runtime);
+	}
 
-	for(auto &t: runtime._worker_threads){
+	//	The dedicated clocks may still be running: wait for them before stopping the timer thread.
+	for(auto& t: dedicated_threads){
 		t.join();
 	}
+	{
+		std::lock_guard<std::mutex> lock(runtime._timer_mutex);
+		runtime._stop = true;
+	}
+	runtime._timer_wake.notify_all();
+	if(timer_thread.joinable()){
+		timer_thread.join();
+	}
+	runtime._scheduler = nullptr;
+
+	if(error){
+		std::rethrow_exception(error);
+	}
+
+	trace_clock_stats(runtime);
+	trace_inbox_stats(runtime);
+
+	trace_memo_stats(*imm);
 
 #if 0
 	const auto result_vec = mapf<pair<string, value_t>>(
 		runtime._processes,
-		[](const auto& process){ return pair<string, value_t>{ process->_name_key, process->_process_state };}
+		[](const auto& process){ return pair<string, value_t>{ process->_name_key, bc_to_value(process->_process_state) };}
 	);
 	std::map<string, value_t> result_map;
 	for(const auto& e: result_vec){
@@ -721,10 +1358,12 @@ std::map<std::string, value_t> run_container(const bc_program_t& program, const
 //			const auto bc_args = value_to_bc(arg_vec);
 			const auto& result = call_function(*vm, bc_to_value(main_function->_value), { arg_vec });
 			print_vm_printlog(*vm);
+			trace_memo_stats(*vm->_imm);
 			return {{ "main()", result }};
 		}
 		else{
 			print_vm_printlog(*vm);
+			trace_memo_stats(*vm->_imm);
 			return {{ "global", value_t::make_void() }};
 		}
 	}
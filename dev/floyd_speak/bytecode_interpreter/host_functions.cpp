@@ -17,6 +17,7 @@
 #include <thread>
 #include <chrono>
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include "text_parser.h"
@@ -24,6 +25,11 @@
 #include "sha1_class.h"
 #include "ast_value.h"
 #include "ast_json.h"
+#include "task_pool.h"
+#include "numeric_kernel.h"
+#include "immer/vector_transient.hpp"
+#include "immer/flex_vector_transient.hpp"
+#include "immer/algorithm.hpp"
 
 
 namespace floyd {
@@ -279,6 +285,19 @@ typeid_t make__absolute_path_t__type(){
 	return temp;
 }
 
+/*
+	A process, already looked up. send() to it needs no name lookup. See get_channel().
+
+	Not in k_builtin_types_and_constants: the member name can't be written in Floyd, so a program's own
+	struct { int id } is never taken for a channel. pass3 adds the name channel_t.
+*/
+typeid_t make__channel_t__type(){
+	const auto temp = typeid_t::make_struct2({
+		{ typeid_t::make_int(), "#channel_id" }
+	});
+	return temp;
+}
+
 /*
 	struct file_pos_t {
 		int pos
@@ -603,6 +622,25 @@ bc_value_t host__find(interpreter_t& vm, const bc_value_t args[], int arg_count)
 			int result = index == size ? -1 : static_cast<int>(index);
 			return bc_value_t::make_int(result);
 		}
+		else if(encode_as_vector_w_struct_columns(obj._type)){
+			//	Compares member by member, straight from the columns.
+			const auto& columns = obj._pod._external->_vector_w_struct_columns;
+			const auto& wanted_members = wanted._pod._external->_struct_w_inplace_members;
+			const auto size = get_struct_columns_size(obj._pod._external);
+			for(size_t index = 0 ; index < size ; index++){
+				size_t m = 0;
+				while(
+					m < columns.size()
+					&& compare_inplace_values(columns[m]._pod._external->_vector_w_inplace_elements[index], wanted_members[m], columns[m]._type.get_vector_element_type()) == 0
+				){
+					m++;
+				}
+				if(m == columns.size()){
+					return bc_value_t::make_int(static_cast<int>(index));
+				}
+			}
+			return bc_value_t::make_int(-1);
+		}
 		else{
 			const auto& vec = *get_vector_external_elements(obj);
 			const auto size = vec.size();
@@ -739,16 +777,10 @@ bc_value_t host__subset(interpreter_t& vm, const bc_value_t args[], int arg_coun
 
 	//??? Move functionallity into seprate function.
 	if(obj._type.is_string()){
-		const auto str = obj.get_string_value();
-		const auto start2 = std::min(start, static_cast<int64_t>(str.size()));
-		const auto end2 = std::min(end, static_cast<int64_t>(str.size()));
-
-		string str2;
-		for(auto i = start2 ; i < end2 ; i++){
-			str2.push_back(str[i]);
-		}
-		const auto v = bc_value_t::make_string(str2);
-		return v;
+		const auto size = static_cast<int64_t>(get_string_size(obj._pod._external));
+		const auto start2 = std::min(start, size);
+		const auto end2 = std::max(start2, std::min(end, size));
+		return bc_value_t::make_string_from_external(make_substring_external(obj._pod._external, start2, end2));
 	}
 	else if(obj._type.is_vector()){
 		if(encode_as_vector_w_inplace_elements(obj._type)){
@@ -756,22 +788,31 @@ bc_value_t host__subset(interpreter_t& vm, const bc_value_t args[], int arg_coun
 			const auto& vec = obj._pod._external->_vector_w_inplace_elements;
 			const auto start2 = std::min(start, static_cast<int64_t>(vec.size()));
 			const auto end2 = std::min(end, static_cast<int64_t>(vec.size()));
-			immer::vector<bc_inplace_value_t> elements2;
-			for(auto i = start2 ; i < end2 ; i++){
-				elements2 = elements2.push_back(vec[i]);
-			}
+			//	take() / drop() share the nodes of vec, no elements are copied.
+			const auto elements2 = vec.take(end2).drop(start2);
 			const auto v = make_vector(element_type, elements2);
 			return v;
 		}
+		else if(encode_as_vector_w_struct_columns(obj._type)){
+			const auto& element_type = obj._type.get_vector_element_type();
+			const auto size = static_cast<int64_t>(get_struct_columns_size(obj._pod._external));
+			const auto start2 = std::min(start, size);
+			const auto end2 = std::min(end, size);
+			return transform_struct_columns(
+				element_type,
+				obj._pod._external,
+				[&](size_t member_index, const immer::flex_vector<bc_inplace_value_t>& column){
+					return column.take(end2).drop(start2);
+				}
+			);
+		}
 		else{
 			const auto& vec = obj._pod._external->_vector_w_external_elements;
 			const auto element_type = obj._type.get_vector_element_type();
 			const auto start2 = std::min(start, static_cast<int64_t>(vec.size()));
 			const auto end2 = std::min(end, static_cast<int64_t>(vec.size()));
-			immer::vector<bc_external_handle_t> elements2;
-			for(auto i = start2 ; i < end2 ; i++){
-				elements2 = elements2.push_back(vec[i]);
-			}
+			//	take() / drop() share the nodes of vec, no elements are copied.
+			const auto elements2 = vec.take(end2).drop(start2);
 			const auto v = make_vector(element_type, elements2);
 			return v;
 		}
@@ -801,14 +842,27 @@ bc_value_t host__replace(interpreter_t& vm, const bc_value_t args[], int arg_cou
 	}
 
 	if(obj._type.is_string()){
-		const auto str = obj.get_string_value();
-		const auto start2 = std::min(start, static_cast<int64_t>(str.size()));
-		const auto end2 = std::min(end, static_cast<int64_t>(str.size()));
-		const auto new_bits = args[3].get_string_value();
-
-		string str2 = str.substr(0, start2) + new_bits + str.substr(end2);
-		const auto v = bc_value_t::make_string(str2);
-		return v;
+		const auto size = static_cast<int64_t>(get_string_size(obj._pod._external));
+		const auto start2 = std::min(start, size);
+		const auto end2 = std::min(end, size);
+		const auto new_size = get_string_size(args[3]._pod._external);
+
+		//	Big results become ropes: the unchanged parts are shared with obj, not copied.
+		if(start2 + new_size + (size - end2) >= k_rope_min_size){
+			const auto rope = get_string_rope(obj._pod._external);
+			const auto rope2 = rope.take(start2) + get_string_rope(args[3]._pod._external) + rope.drop(end2);
+			return bc_value_t::make_string_from_external(make_string_external(rope2));
+		}
+		else{
+			const auto str = get_string_view(obj._pod._external);
+			const auto new_bits = get_string_view(args[3]._pod._external);
+			string str2;
+			str2.reserve(start2 + new_bits.size() + (size - end2));
+			str2.append(str.substr(0, start2));
+			str2.append(new_bits);
+			str2.append(str.substr(end2));
+			return bc_value_t::make_string(std::move(str2));
+		}
 	}
 	else if(obj._type.is_vector()){
 		if(encode_as_vector_w_inplace_elements(obj._type)){
@@ -818,16 +872,24 @@ bc_value_t host__replace(interpreter_t& vm, const bc_value_t args[], int arg_cou
 			const auto end2 = std::min(end, static_cast<int64_t>(vec.size()));
 			const auto& new_bits = args[3]._pod._external->_vector_w_inplace_elements;
 
-			auto result = immer::vector<bc_inplace_value_t>(vec.begin(), vec.begin() + start2);
-			for(int i = 0 ; i < new_bits.size() ; i++){
-				result = result.push_back(new_bits[i]);
-			}
-			for(int i = 0 ; i < (vec.size( ) - end2) ; i++){
-				result = result.push_back(vec[end2 + i]);
-			}
+			const auto result = vec.take(start2) + new_bits + vec.drop(end2);
 			const auto v = make_vector(element_type, result);
 			return v;
 		}
+		else if(encode_as_vector_w_struct_columns(obj._type)){
+			const auto element_type = obj._type.get_vector_element_type();
+			const auto size = static_cast<int64_t>(get_struct_columns_size(obj._pod._external));
+			const auto start2 = std::min(start, size);
+			const auto end2 = std::min(end, size);
+			const auto& new_columns = args[3]._pod._external->_vector_w_struct_columns;
+			return transform_struct_columns(
+				element_type,
+				obj._pod._external,
+				[&](size_t member_index, const immer::flex_vector<bc_inplace_value_t>& column){
+					return column.take(start2) + new_columns[member_index]._pod._external->_vector_w_inplace_elements + column.drop(end2);
+				}
+			);
+		}
 		else{
 			const auto& vec = obj._pod._external->_vector_w_external_elements;
 			const auto element_type = obj._type.get_vector_element_type();
@@ -835,13 +897,7 @@ bc_value_t host__replace(interpreter_t& vm, const bc_value_t args[], int arg_cou
 			const auto end2 = std::min(end, static_cast<int64_t>(vec.size()));
 			const auto& new_bits = args[3]._pod._external->_vector_w_external_elements;
 
-			auto result = immer::vector<bc_external_handle_t>(vec.begin(), vec.begin() + start2);
-			for(int i = 0 ; i < new_bits.size() ; i++){
-				result = result.push_back(new_bits[i]);
-			}
-			for(int i = 0 ; i < (vec.size( ) - end2) ; i++){
-				result = result.push_back(vec[end2 + i]);
-			}
+			const auto result = vec.take(start2) + new_bits + vec.drop(end2);
 			const auto v = make_vector(element_type, result);
 			return v;
 		}
@@ -932,6 +988,185 @@ bc_value_t host__get_json_type(interpreter_t& vm, const bc_value_t args[], int a
 }
 
 
+/////////////////////////////////////////		PURE -- STRINGS
+
+/*
+	split(), join(), find_substring(), starts_with(), trim() and replace_all(). Each result string is built with one
+	allocation: the size is calculated first, then the std::string is moved into the bc_value_t.
+*/
+
+
+/*
+	Returns the position of wanted in s, at or after start, or std::string::npos. memchr() finds the candidates for
+	wanted's first character -- it's vectorized in the C library -- then memcmp() checks the rest.
+*/
+size_t find_bytes(std::string_view s, std::string_view wanted, size_t start){
+	QUARK_ASSERT(wanted.empty() == false);
+
+	if(start > s.size() || wanted.size() > s.size() - start){
+		return std::string::npos;
+	}
+
+	const char* p = s.data() + start;
+	const char* last = s.data() + s.size() - wanted.size();
+	while(p <= last){
+		const auto hit = static_cast<const char*>(std::memchr(p, wanted[0], last - p + 1));
+		if(hit == nullptr){
+			return std::string::npos;
+		}
+		if(std::memcmp(hit + 1, wanted.data() + 1, wanted.size() - 1) == 0){
+			return hit - s.data();
+		}
+		p = hit + 1;
+	}
+	return std::string::npos;
+}
+
+QUARK_UNIT_TEST("find_bytes()", "", "", ""){
+	QUARK_UT_VERIFY(find_bytes("hello world", "o", 0) == 4);
+	QUARK_UT_VERIFY(find_bytes("hello world", "o", 5) == 7);
+	QUARK_UT_VERIFY(find_bytes("hello world", "world", 0) == 6);
+	QUARK_UT_VERIFY(find_bytes("hello world", "worlds", 0) == std::string::npos);
+	QUARK_UT_VERIFY(find_bytes("aaab", "ab", 0) == 2);
+	QUARK_UT_VERIFY(find_bytes("abc", "c", 3) == std::string::npos);
+	QUARK_UT_VERIFY(find_bytes("abc", "c", 4) == std::string::npos);
+}
+
+
+//	[string] split(string s, string separator)
+//	split("a,b,,c", ",") == [ "a", "b", "", "c" ]. Always returns at least one string.
+bc_value_t host__split(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 2);
+
+	const auto str = get_string_view(args[0]._pod._external);
+	const auto separator = get_string_view(args[1]._pod._external);
+	if(separator.empty()){
+		quark::throw_runtime_error("split() separator must not be empty.");
+	}
+
+	auto result = immer::vector<bc_value_t>().transient();
+	size_t pos = 0;
+	while(true){
+		const auto hit = find_bytes(str, separator, pos);
+		const auto end = hit == std::string::npos ? str.size() : hit;
+		result.push_back(bc_value_t::make_string(std::string(str.substr(pos, end - pos))));
+		if(hit == std::string::npos){
+			break;
+		}
+		pos = hit + separator.size();
+	}
+	return make_vector(typeid_t::make_string(), result.persistent());
+}
+
+//	string join([string] parts, string separator)
+bc_value_t host__join(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 2);
+
+	const auto& parts = *get_vector_external_elements(args[0]);
+	const auto separator = get_string_view(args[1]._pod._external);
+
+	size_t size = parts.empty() ? 0 : separator.size() * (parts.size() - 1);
+	for(const auto& e: parts){
+		size += get_string_view(e._external).size();
+	}
+
+	std::string result;
+	result.reserve(size);
+	for(size_t i = 0 ; i < parts.size() ; i++){
+		if(i > 0){
+			result.append(separator);
+		}
+		result.append(get_string_view(parts[i]._external));
+	}
+	return bc_value_t::make_string(std::move(result));
+}
+
+//	int find_substring(string s, string wanted, int start)
+//	Returns the position of the first wanted at or after start, or -1.
+bc_value_t host__find_substring(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 3);
+
+	const auto str = get_string_view(args[0]._pod._external);
+	const auto wanted = get_string_view(args[1]._pod._external);
+	const auto start = args[2].get_int_value();
+	if(start < 0 || start > static_cast<int64_t>(str.size())){
+		quark::throw_runtime_error("find_substring() start out of range.");
+	}
+
+	if(wanted.empty()){
+		return bc_value_t::make_int(start);
+	}
+	const auto pos = find_bytes(str, wanted, static_cast<size_t>(start));
+	return bc_value_t::make_int(pos == std::string::npos ? -1 : static_cast<int64_t>(pos));
+}
+
+//	bool starts_with(string s, string prefix)
+bc_value_t host__starts_with(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 2);
+
+	const auto str = get_string_view(args[0]._pod._external);
+	const auto prefix = get_string_view(args[1]._pod._external);
+	return bc_value_t::make_bool(str.size() >= prefix.size() && std::memcmp(str.data(), prefix.data(), prefix.size()) == 0);
+}
+
+//	string trim(string s)
+//	Removes spaces, tabs and newlines from both ends.
+bc_value_t host__trim(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 1);
+
+	const auto str = get_string_view(args[0]._pod._external);
+	const char* whitespace = " \t\n\r\f\v";
+	const auto begin = str.find_first_not_of(whitespace);
+	if(begin == std::string::npos){
+		return bc_value_t::make_string(std::string());
+	}
+	const auto end = str.find_last_not_of(whitespace) + 1;
+	if(begin == 0 && end == str.size()){
+		return args[0];
+	}
+	return bc_value_t::make_string(std::string(str.substr(begin, end - begin)));
+}
+
+//	string replace_all(string s, string wanted, string replacement)
+bc_value_t host__replace_all(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 3);
+
+	const auto str = get_string_view(args[0]._pod._external);
+	const auto wanted = get_string_view(args[1]._pod._external);
+	const auto replacement = get_string_view(args[2]._pod._external);
+	if(wanted.empty()){
+		quark::throw_runtime_error("replace_all() wanted must not be empty.");
+	}
+
+	std::vector<size_t> hits;
+	for(auto pos = find_bytes(str, wanted, 0) ; pos != std::string::npos ; pos = find_bytes(str, wanted, pos + wanted.size())){
+		hits.push_back(pos);
+	}
+	if(hits.empty()){
+		return args[0];
+	}
+
+	std::string result;
+	result.reserve(str.size() - hits.size() * wanted.size() + hits.size() * replacement.size());
+	size_t pos = 0;
+	for(const auto hit: hits){
+		result.append(str.substr(pos, hit - pos));
+		result.append(replacement);
+		pos = hit + wanted.size();
+	}
+	result.append(str.substr(pos));
+	return bc_value_t::make_string(std::move(result));
+}
+
+
+
+
 /////////////////////////////////////////		PURE -- SHA1
 
 
@@ -1013,8 +1248,187 @@ bc_value_t host__calc_binary_sha1(interpreter_t& vm, const bc_value_t args[], in
 
 /////////////////////////////////////////		PURE -- FUNCTIONAL
 
+
+/////////////////////////////////////////		PARALLEL EXECUTION
+
+//	Collections smaller than this are processed on the calling thread. Below it, waking workers and
+//	setting up their interpreters costs more than we win.
+const size_t k_parallel_min_elements = 2048;
+
+//	Aim for this many chunks per worker, so workers that finish early can steal from slow ones.
+const size_t k_parallel_chunks_per_worker = 4;
+
+
+//	supermap() runs one task per node instead of chunks, and nodes are often big jobs. Start earlier.
+const size_t k_parallel_min_graph_nodes = 64;
+
+
+//	Only pure functions can be called from several threads at once: they don't touch globals or the world.
+bool use_parallel_path(const bc_value_t& f, size_t element_count, size_t min_element_count = k_parallel_min_elements){
+	QUARK_ASSERT(f._type.is_function());
+
+	return f._type.get_function_pure() == epure::pure
+		&& element_count >= min_element_count
+		&& get_shared_task_pool().get_worker_count() > 1;
+}
+
+
+size_t get_vector_size(const bc_value_t& vec){
+	QUARK_ASSERT(vec._type.is_vector());
+
+	if(encode_as_vector_w_inplace_elements(vec._type)){
+		return vec._pod._external->_vector_w_inplace_elements.size();
+	}
+	else if(encode_as_vector_w_struct_columns(vec._type)){
+		return get_struct_columns_size(vec._pod._external);
+	}
+	else{
+		return vec._pod._external->_vector_w_external_elements.size();
+	}
+}
+
+//	Reads one element straight from the vector's storage, without get_vector() copying them all first.
+bc_value_t get_vector_element(const bc_value_t& vec, const typeid_t& element_type, size_t index){
+	QUARK_ASSERT(vec._type.is_vector());
+
+	if(encode_as_vector_w_inplace_elements(vec._type)){
+		return bc_value_t(element_type, vec._pod._external->_vector_w_inplace_elements[index]);
+	}
+	else if(encode_as_vector_w_struct_columns(vec._type)){
+		return get_struct_columns_element(element_type, vec._pod._external, index);
+	}
+	else{
+		return bc_value_t(element_type, vec._pod._external->_vector_w_external_elements[index]);
+	}
+}
+
+
+//	Chunk i covers elements [i * chunk_size, min((i + 1) * chunk_size, element_count)).
+size_t get_parallel_chunk_size(size_t element_count){
+	const auto worker_count = static_cast<size_t>(get_shared_task_pool().get_worker_count());
+	return std::max(k_parallel_min_elements / 4, element_count / (worker_count * k_parallel_chunks_per_worker) + 1);
+}
+
+size_t get_parallel_chunk_count(size_t element_count){
+	const auto chunk_size = get_parallel_chunk_size(element_count);
+	return (element_count + chunk_size - 1) / chunk_size;
+}
+
+
+/*
+	The worker interpreters for one parallel host-function call: one per pool worker, made on first use.
+	Each shares vm's program image and starts with a copy of vm's globals, but has its own stack.
+*/
+struct worker_vms_t {
+	public: explicit worker_vms_t(interpreter_t& vm) :
+		_vm(vm),
+		_globals(copy_globals(vm)),
+		_worker_vms(get_shared_task_pool().get_worker_count())
+	{
+	}
+
+	//	Releases the workers' references to the globals. Skipped for a worker left mid-call by an exception.
+	public: ~worker_vms_t(){
+		const auto& global_frame = _vm._imm->_program._globals;
+		for(auto& worker_vm: _worker_vms){
+			if(worker_vm && worker_vm->_stack.size() == k_frame_overhead + global_frame._locals.size()){
+				worker_vm->_stack.close_frame(global_frame);
+				worker_vm->_stack.restore_frame();
+			}
+		}
+	}
+
+	//	Calls f() with worker_index's interpreter. Returns the print() output made by f(), so callers can
+	//	merge it back into _vm in a deterministic order.
+	public: std::vector<std::string> run(int worker_index, const std::function<void(interpreter_t& worker_vm)>& f){
+		auto& worker_vm = _worker_vms[worker_index];
+		if(!worker_vm){
+			worker_vm.reset(new interpreter_t(_vm._imm, _vm._handler, _globals));
+		}
+
+		const auto print_pos = worker_vm->_print_output.size();
+		f(*worker_vm);
+		const auto prints = std::vector<std::string>(worker_vm->_print_output.begin() + print_pos, worker_vm->_print_output.end());
+		worker_vm->_print_output.resize(print_pos);
+		return prints;
+	}
+
+
+	////////////////////////		STATE
+	public: interpreter_t& _vm;
+	public: const std::vector<bc_value_t> _globals;
+	public: std::vector<std::unique_ptr<interpreter_t>> _worker_vms;
+};
+
+
+/*
+	Splits [0, element_count) into chunks and calls chunk_f(worker_vm, chunk_index, begin, end) for each chunk on
+	the shared task pool, using a worker_vms_t.
+
+	print() output from the chunks is appended to vm in chunk order, as if the chunks had run one after another on vm.
+*/
+void run_parallel_chunks(
+	interpreter_t& vm,
+	size_t element_count,
+	const std::function<void(interpreter_t& worker_vm, size_t chunk_index, size_t begin, size_t end)>& chunk_f
+){
+	QUARK_ASSERT(vm.check_invariant());
+
+	const auto chunk_size = get_parallel_chunk_size(element_count);
+	const auto chunk_count = get_parallel_chunk_count(element_count);
+
+	worker_vms_t worker_vms(vm);
+	std::vector<std::vector<std::string>> chunk_prints(chunk_count);
+
+	get_shared_task_pool().run_batch(
+		static_cast<int>(chunk_count),
+		[&](int worker_index, int chunk_index){
+			const auto begin = chunk_index * chunk_size;
+			const auto end = std::min(begin + chunk_size, element_count);
+			chunk_prints[chunk_index] = worker_vms.run(
+				worker_index,
+				[&](interpreter_t& worker_vm){ chunk_f(worker_vm, chunk_index, begin, end); }
+			);
+		}
+	);
+
+	for(const auto& prints: chunk_prints){
+		vm._print_output.insert(vm._print_output.end(), prints.begin(), prints.end());
+	}
+}
+
+
 /////////////////////////////////////////		PURE -- MAP()
 
+
+//	A numeric kernel does an element in a few nanoseconds, it takes many more to be worth splitting up.
+const size_t k_parallel_min_kernel_elements = 32768;
+
+//	Runs f's numeric kernel over the whole vector, on the worker pool if it's big.
+bc_value_t map_numeric_kernel(const numeric_kernel_t& kernel, const bc_value_t& vec, const typeid_t& r_type){
+	QUARK_ASSERT(encode_as_vector_w_inplace_elements(vec._type));
+
+	const auto& input_vec = vec._pod._external->_vector_w_inplace_elements;
+	std::vector<bc_inplace_value_t> values(input_vec.begin(), input_vec.end());
+	const auto count = values.size();
+
+	if(count >= k_parallel_min_kernel_elements && get_shared_task_pool().get_worker_count() > 1){
+		const auto chunk_size = get_parallel_chunk_size(count);
+		get_shared_task_pool().run_batch(
+			static_cast<int>(get_parallel_chunk_count(count)),
+			[&](int worker_index, int chunk_index){
+				const auto begin = chunk_index * chunk_size;
+				const auto end = std::min(begin + chunk_size, count);
+				run_numeric_kernel(kernel, values.data() + begin, values.data() + begin, end - begin);
+			}
+		);
+	}
+	else{
+		run_numeric_kernel(kernel, values.data(), values.data(), count);
+	}
+	return make_vector(r_type, immer::flex_vector<bc_inplace_value_t>(values.begin(), values.end()));
+}
+
 //	[R] map([E], R f(E e))
 //??? need to provide context property to map() and pass to f().
 bc_value_t host__map(interpreter_t& vm, const bc_value_t args[], int arg_count){
@@ -1041,20 +1455,39 @@ bc_value_t host__map(interpreter_t& vm, const bc_value_t args[], int arg_count){
 		quark::throw_runtime_error("map() function f must accept collection elements as its argument.");
 	}
 
-	const auto input_vec = get_vector(args[0]);
-	immer::vector<bc_value_t> vec2;
-	for(const auto& e: input_vec){
-		const bc_value_t f_args[1] = { e };
-		const auto result1 = call_function_bc(vm, f, f_args, 1);
-		vec2 = vec2.push_back(result1);
+	const auto& kernel = vm._imm->_numeric_kernels[f.get_function_value()];
+	if(kernel){
+		return map_numeric_kernel(*kernel, args[0], r_type);
 	}
 
-	const auto result = make_vector(r_type, vec2);
+	const auto input_vec = get_vector(args[0]);
 
-#if 1
-	const auto debug = value_and_type_to_ast_json(bc_to_value(result));
-	QUARK_TRACE(json_to_pretty_string(debug._value));
-#endif
+	const auto result = [&](){
+		if(use_parallel_path(f, input_vec.size())){
+			//	Each chunk writes its own range of the preallocated output, no locking needed.
+			std::vector<bc_value_t> output(input_vec.size());
+			run_parallel_chunks(
+				vm,
+				input_vec.size(),
+				[&](interpreter_t& worker_vm, size_t chunk_index, size_t begin, size_t end){
+					for(auto i = begin ; i < end ; i++){
+						const bc_value_t f_args[1] = { input_vec[i] };
+						output[i] = call_function_bc(worker_vm, f, f_args, 1);
+					}
+				}
+			);
+			return make_vector(r_type, immer::vector<bc_value_t>(output.begin(), output.end()));
+		}
+		else{
+			immer::vector<bc_value_t> vec2;
+			for(const auto& e: input_vec){
+				const bc_value_t f_args[1] = { e };
+				const auto result1 = call_function_bc(vm, f, f_args, 1);
+				vec2 = vec2.push_back(result1);
+			}
+			return make_vector(r_type, vec2);
+		}
+	}();
 
 	return result;
 }
@@ -1088,15 +1521,10 @@ bc_value_t host__map_string(interpreter_t& vm, const bc_value_t args[], int arg_
 		const bc_value_t f_args[1] = { bc_value_t::make_string(std::string(1, e)) };
 		const auto result1 = call_function_bc(vm, f, f_args, 1);
 		QUARK_ASSERT(result1._type.is_string());
-		vec2.append(result1.get_string_value());
+		vec2.append(get_string_view(result1._pod._external));
 	}
 
-	const auto result = bc_value_t::make_string(vec2);
-
-#if 1
-	const auto debug = value_and_type_to_ast_json(bc_to_value(result));
-	QUARK_TRACE(json_to_pretty_string(debug._value));
-#endif
+	const auto result = bc_value_t::make_string(std::move(vec2));
 
 	return result;
 }
@@ -1142,175 +1570,606 @@ bc_value_t host__reduce(interpreter_t& vm, const bc_value_t args[], int arg_coun
 
 	const auto result = acc;
 
-#if 1
-	const auto debug = value_and_type_to_ast_json(bc_to_value(result));
-	QUARK_TRACE(json_to_pretty_string(debug._value));
-#endif
-
 	return result;
 }
 
 
 
 
-/////////////////////////////////////////		PURE -- filter()
+/////////////////////////////////////////		PURE -- fold_parallel()
 
 
-//	[E] filter([E], bool f(E e))
+//	ACC is how fold_parallel() keeps accumulators between calls: int64_t / double for int / double
+//	accumulators, else bc_value_t. The typed ones don't need to make and keep a full bc_value_t per partial result.
+template <typename ACC> ACC unpack_fold_acc(const bc_value_t& value){
+	if constexpr (std::is_same<ACC, int64_t>::value){
+		return value.get_int_value();
+	}
+	else if constexpr (std::is_same<ACC, double>::value){
+		return value.get_double_value();
+	}
+	else{
+		return value;
+	}
+}
 
+template <typename ACC> bc_value_t pack_fold_acc(const ACC& acc, const typeid_t& type){
+	if constexpr (std::is_same<ACC, int64_t>::value){
+		return bc_value_t::make_int(acc);
+	}
+	else if constexpr (std::is_same<ACC, double>::value){
+		return bc_value_t::make_double(acc);
+	}
+	else{
+		QUARK_ASSERT(acc._type == type);
+		return acc;
+	}
+}
 
-bc_value_t host__filter(interpreter_t& vm, const bc_value_t args[], int arg_count){
+/*
+	Each chunk is folded from identity on the worker pool. The per-chunk results are then combined
+	pairwise in a tree: ((p0 p1) (p2 p3)) ((p4 p5) ...). Operand order is always kept, so combine_f must
+	be associative but doesn't need to be commutative.
+*/
+template <typename ACC>
+bc_value_t fold_parallel_typed(interpreter_t& vm, const bc_value_t& elements, const bc_value_t& identity, const bc_value_t& map_f, const bc_value_t& combine_f){
 	QUARK_ASSERT(vm.check_invariant());
-	QUARK_ASSERT(arg_count == 2);
 
-	//	Check topology.
-	if(args[0]._type.is_vector() == false || args[1]._type.is_function() == false || args[1]._type.get_function_args().size () != 1){
-		quark::throw_runtime_error("filter() requires 2 arguments.");
-	}
-
-	const auto& elements = args[0];
-	const auto& f = args[1];
 	const auto& e_type = elements._type.get_vector_element_type();
+	const auto& r_type = identity._type;
+	const auto count = get_vector_size(elements);
 
-	if(
-		elements._type.get_vector_element_type() != f._type.get_function_args()[0]
-	)
-	{
-		quark::throw_runtime_error("[E] filter([E], bool f(E e))");
-	}
+	const auto combine = [&](interpreter_t& vm2, const ACC& a, const ACC& b){
+		const bc_value_t combine_args[2] = { pack_fold_acc<ACC>(a, r_type), pack_fold_acc<ACC>(b, r_type) };
+		return unpack_fold_acc<ACC>(call_function_bc(vm2, combine_f, combine_args, 2));
+	};
+	const auto fold_range = [&](interpreter_t& vm2, size_t begin, size_t end){
+		ACC acc = unpack_fold_acc<ACC>(identity);
+		for(auto i = begin ; i < end ; i++){
+			const bc_value_t map_args[1] = { get_vector_element(elements, e_type, i) };
+			const auto mapped = unpack_fold_acc<ACC>(call_function_bc(vm2, map_f, map_args, 1));
+			acc = combine(vm2, acc, mapped);
+		}
+		return acc;
+	};
 
-	const auto input_vec = get_vector(elements);
-	immer::vector<bc_value_t> vec2;
+	if(use_parallel_path(map_f, count) == false || combine_f._type.get_function_pure() != epure::pure){
+		return pack_fold_acc<ACC>(fold_range(vm, 0, count), r_type);
+	}
 
-	for(const auto& e: input_vec){
-		const bc_value_t f_args[1] = { e };
-		const auto result1 = call_function_bc(vm, f, f_args, 1);
-		QUARK_ASSERT(result1._type.is_bool());
+	std::vector<ACC> partials(get_parallel_chunk_count(count));
+	run_parallel_chunks(
+		vm,
+		count,
+		[&](interpreter_t& worker_vm, size_t chunk_index, size_t begin, size_t end){
+			partials[chunk_index] = fold_range(worker_vm, begin, end);
+		}
+	);
 
-		if(result1.get_bool_value()){
-			vec2 = vec2.push_back(e);
+	//	There are only a few partials per worker -- combine them on the calling thread.
+	for(size_t step = 1 ; step < partials.size() ; step *= 2){
+		for(size_t i = 0 ; i + step < partials.size() ; i += step * 2){
+			partials[i] = combine(vm, partials[i], partials[i + step]);
 		}
 	}
-
-	const auto result = make_vector(e_type, vec2);
-
-#if 1
-	const auto debug = value_and_type_to_ast_json(bc_to_value(result));
-	QUARK_TRACE(json_to_pretty_string(debug._value));
-#endif
-
-	return result;
+	return pack_fold_acc<ACC>(partials[0], r_type);
 }
 
 
+//	R fold_parallel([E] elements, R identity, R map_f(E e), R combine_f(R a, R b))
+//	combine_f must be associative and identity must be its identity element: combine_f(identity, x) == x.
 
-
-
-
-/////////////////////////////////////////		PURE -- SUPERMAP()
-
-
-//	[R] supermap([E] values, [int] parents, R (E, [R]) f)
-
-bc_value_t host__supermap(interpreter_t& vm, const bc_value_t args[], int arg_count){
+bc_value_t host__fold_parallel(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
-	QUARK_ASSERT(arg_count == 3);
+	QUARK_ASSERT(arg_count == 4);
 
 	//	Check topology.
-	if(args[0]._type.is_vector() && args[1]._type == typeid_t::make_vector(typeid_t::make_int()) && args[2]._type.is_function() && args[2]._type.get_function_args().size () == 2){
+	if(
+		args[0]._type.is_vector() == false
+		|| args[2]._type.is_function() == false || args[2]._type.get_function_args().size () != 1
+		|| args[3]._type.is_function() == false || args[3]._type.get_function_args().size () != 2
+	){
+		quark::throw_runtime_error("fold_parallel() requires 4 arguments.");
+	}
+
+	const auto& elements = args[0];
+	const auto& identity = args[1];
+	const auto& map_f = args[2];
+	const auto& combine_f = args[3];
+	const auto& r_type = identity._type;
+
+	if(
+		map_f._type.get_function_args()[0] != elements._type.get_vector_element_type()
+		|| map_f._type.get_function_return() != r_type
+		|| combine_f._type.get_function_args()[0] != r_type
+		|| combine_f._type.get_function_args()[1] != r_type
+		|| combine_f._type.get_function_return() != r_type
+	)
+	{
+		quark::throw_runtime_error("R fold_parallel([E] elements, R identity, R map_f(E e), R combine_f(R a, R b))");
+	}
+
+	const auto result = [&](){
+		if(r_type.is_int()){
+			return fold_parallel_typed<int64_t>(vm, elements, identity, map_f, combine_f);
+		}
+		else if(r_type.is_double()){
+			return fold_parallel_typed<double>(vm, elements, identity, map_f, combine_f);
+		}
+		else{
+			return fold_parallel_typed<bc_value_t>(vm, elements, identity, map_f, combine_f);
+		}
+	}();
+
+	return result;
+}
+
+
+
+
+/////////////////////////////////////////		PURE -- filter()
+
+
+//	[E] filter([E], bool f(E e))
+
+
+/*
+	Pass 1: run f() on each chunk on the worker pool, recording a keep-flag per element and a kept-count per chunk.
+	Pass 2: a prefix sum over the chunk counts gives each chunk's position in the output. The chunks then copy their
+	kept elements into one preallocated output, in parallel. Output keeps the input's order.
+*/
+bc_value_t filter_parallel(interpreter_t& vm, const bc_value_t& elements, const bc_value_t& f){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(elements._type.is_vector());
+
+	const auto& e_type = elements._type.get_vector_element_type();
+	const bool inplace = encode_as_vector_w_inplace_elements(elements._type);
+	const auto& inplace_elements = elements._pod._external->_vector_w_inplace_elements;
+	const auto& external_elements = elements._pod._external->_vector_w_external_elements;
+
+	const auto count = get_vector_size(elements);
+	const auto chunk_size = get_parallel_chunk_size(count);
+	const auto chunk_count = get_parallel_chunk_count(count);
+
+	std::vector<uint8_t> keep(count);
+	std::vector<size_t> chunk_kept_counts(chunk_count);
+	run_parallel_chunks(
+		vm,
+		count,
+		[&](interpreter_t& worker_vm, size_t chunk_index, size_t begin, size_t end){
+			size_t kept_count = 0;
+			for(auto i = begin ; i < end ; i++){
+				const bc_value_t f_args[1] = { get_vector_element(elements, e_type, i) };
+				const auto result1 = call_function_bc(worker_vm, f, f_args, 1);
+				QUARK_ASSERT(result1._type.is_bool());
+
+				keep[i] = result1.get_bool_value() ? 1 : 0;
+				kept_count += keep[i];
+			}
+			chunk_kept_counts[chunk_index] = kept_count;
+		}
+	);
+
+	std::vector<size_t> chunk_offsets(chunk_count);
+	size_t kept_count = 0;
+	for(size_t chunk_index = 0 ; chunk_index < chunk_count ; chunk_index++){
+		chunk_offsets[chunk_index] = kept_count;
+		kept_count += chunk_kept_counts[chunk_index];
+	}
+
+	const auto compact = [&](const auto& get_source, auto& output){
+		get_shared_task_pool().run_batch(
+			static_cast<int>(chunk_count),
+			[&](int worker_index, int chunk_index){
+				const auto begin = chunk_index * chunk_size;
+				const auto end = std::min(begin + chunk_size, count);
+				auto pos = chunk_offsets[chunk_index];
+				for(auto i = begin ; i < end ; i++){
+					if(keep[i]){
+						output[pos] = get_source(i);
+						pos++;
+					}
+				}
+			}
+		);
+	};
+
+	if(inplace){
+		std::vector<bc_inplace_value_t> output(kept_count);
+		compact(
+			[&](size_t i){ return inplace_elements[i]; },
+			output
+		);
+		return make_vector(e_type, immer::flex_vector<bc_inplace_value_t>(output.begin(), output.end()));
+	}
+	else if(encode_as_vector_w_struct_columns(elements._type)){
+		return transform_struct_columns(
+			e_type,
+			elements._pod._external,
+			[&](size_t member_index, const immer::flex_vector<bc_inplace_value_t>& column){
+				std::vector<bc_inplace_value_t> output(kept_count);
+				compact(
+					[&](size_t i){ return column[i]; },
+					output
+				);
+				return immer::flex_vector<bc_inplace_value_t>(output.begin(), output.end());
+			}
+		);
 	}
 	else{
-		quark::throw_runtime_error("supermap() requires 3 arguments.");
+		//	Plain pointers: the input vector keeps the elements alive until we've made our own handles.
+		std::vector<const bc_external_value_t*> output(kept_count);
+		compact(
+			[&](size_t i){ return external_elements[i]._external; },
+			output
+		);
+		auto temp = immer::flex_vector<bc_external_handle_t>().transient();
+		for(const auto& e: output){
+			temp.push_back(bc_external_handle_t(e));
+		}
+		return make_vector(e_type, temp.persistent());
+	}
+}
+
+bc_value_t host__filter(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 2);
+
+	//	Check topology.
+	if(args[0]._type.is_vector() == false || args[1]._type.is_function() == false || args[1]._type.get_function_args().size () != 1){
+		quark::throw_runtime_error("filter() requires 2 arguments.");
 	}
 
 	const auto& elements = args[0];
+	const auto& f = args[1];
 	const auto& e_type = elements._type.get_vector_element_type();
-	const auto& parents = args[1];
-	const auto& f = args[2];
-	const auto& r_type = args[2]._type.get_function_return();
+
 	if(
-		e_type == f._type.get_function_args()[0]
-		&& r_type == f._type.get_function_args()[1].get_vector_element_type()
-	){
-	}
-	else {
-		quark::throw_runtime_error("R supermap([E] elements, R init_value, R (R acc, E element) f");
+		elements._type.get_vector_element_type() != f._type.get_function_args()[0]
+	)
+	{
+		quark::throw_runtime_error("[E] filter([E], bool f(E e))");
 	}
 
-	const auto elements2 = get_vector(elements);
-	const auto parents2 = get_vector(parents);
+	const auto result = [&](){
+		const auto count = get_vector_size(elements);
+		if(use_parallel_path(f, count)){
+			return filter_parallel(vm, elements, f);
+		}
+		else{
+			const auto input_vec = get_vector(elements);
+			immer::vector<bc_value_t> vec2;
 
-	if(elements2.size() != parents2.size()) {
-		quark::throw_runtime_error("supermap() requires elements and parents be the same count.");
-	}
+			for(const auto& e: input_vec){
+				const bc_value_t f_args[1] = { e };
+				const auto result1 = call_function_bc(vm, f, f_args, 1);
+				QUARK_ASSERT(result1._type.is_bool());
 
-	auto elements_todo = elements2.size();
-	std::vector<int> rcs(elements2.size(), 0);
+				if(result1.get_bool_value()){
+					vec2 = vec2.push_back(e);
+				}
+			}
+			return make_vector(e_type, vec2);
+		}
+	}();
 
-	immer::vector<bc_value_t> complete(elements2.size(), bc_value_t());
+	return result;
+}
 
-	for(const auto& e: parents2){
-		const auto parent_index = e.get_int_value();
 
-		const auto count = static_cast<int64_t>(elements2.size());
-		QUARK_ASSERT(parent_index >= -1);
-		QUARK_ASSERT(parent_index < count);
 
-		if(parent_index != -1){
-			rcs[parent_index]++;
+
+
+
+/////////////////////////////////////////		PURE -- FUSED PIPELINE
+
+
+/*
+	The bytecode generator turns chains like reduce(filter(map(v, f), p), init, g) into one call to host__pipeline().
+	Each element streams through all the stages: there are no intermediate vectors.
+
+	R **pipeline**([E] elements, [int] stages, F0 f0, F1 f1, F2 f2, F3 f3, R init)
+
+	stages[i] is a pipeline_stage that says how to use function fi, innermost stage first. Unused functions are 0.
+	init is only used by a final reduce stage.
+*/
+
+struct pipeline_t {
+	//	Map and filter stages, with their function.
+	std::vector<std::pair<pipeline_stage, bc_value_t>> _stages;
+
+	//	Undefined if the pipeline doesn't end with a reduce.
+	bc_value_t _reduce_f;
+
+	typeid_t _output_element_type;
+};
+
+//	Runs value through the map and filter stages. Returns false if a filter drops it.
+bool run_pipeline_stages(interpreter_t& vm, const pipeline_t& pipeline, bc_value_t& value){
+	for(const auto& stage: pipeline._stages){
+		const bc_value_t f_args[1] = { value };
+		const auto result1 = call_function_bc(vm, stage.second, f_args, 1);
+		if(stage.first == pipeline_stage::k_map){
+			value = result1;
+		}
+		else{
+			QUARK_ASSERT(result1._type.is_bool());
+			if(result1.get_bool_value() == false){
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bc_value_t host__pipeline(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 3 + k_pipeline_max_functions);
+
+	const auto& elements = args[0];
+	const auto& stage_ints = args[1];
+	const auto& init = args[2 + k_pipeline_max_functions];
+	QUARK_ASSERT(elements._type.is_vector());
+	QUARK_ASSERT(get_vector_size(stage_ints) >= 1 && get_vector_size(stage_ints) <= k_pipeline_max_functions);
+
+	const auto& e_type = elements._type.get_vector_element_type();
+
+	std::vector<std::pair<pipeline_stage, bc_value_t>> stages;
+	bc_value_t reduce_f;
+	auto output_element_type = e_type;
+	const auto stage_count = get_vector_size(stage_ints);
+	for(int i = 0 ; i < stage_count ; i++){
+		const auto stage = static_cast<pipeline_stage>(get_vector_element(stage_ints, typeid_t::make_int(), i).get_int_value());
+		const auto& f = args[2 + i];
+		QUARK_ASSERT(f._type.is_function());
+
+		if(stage == pipeline_stage::k_reduce){
+			QUARK_ASSERT(i == stage_count - 1);
+			reduce_f = f;
+		}
+		else{
+			stages.push_back({ stage, f });
+			if(stage == pipeline_stage::k_map){
+				output_element_type = f._type.get_function_return();
+			}
 		}
 	}
+	const auto pipeline = pipeline_t{ stages, reduce_f, output_element_type };
+	const auto reduce = pipeline._reduce_f._type.is_undefined() == false;
+
+	const auto count = get_vector_size(elements);
+	const auto parallel = std::all_of(
+		pipeline._stages.begin(),
+		pipeline._stages.end(),
+		[&](const std::pair<pipeline_stage, bc_value_t>& stage){ return use_parallel_path(stage.second, count); }
+	);
+
+	const auto result = [&](){
+		//	The map and filter stages run in parallel, each chunk keeps its surviving values. The final reduce is a
+		//	left fold so it runs afterwards, in element order.
+		if(parallel){
+			std::vector<std::vector<bc_value_t>> chunk_outputs(get_parallel_chunk_count(count));
+			run_parallel_chunks(
+				vm,
+				count,
+				[&](interpreter_t& worker_vm, size_t chunk_index, size_t begin, size_t end){
+					for(auto i = begin ; i < end ; i++){
+						auto value = get_vector_element(elements, e_type, i);
+						if(run_pipeline_stages(worker_vm, pipeline, value)){
+							chunk_outputs[chunk_index].push_back(value);
+						}
+					}
+				}
+			);
 
-	while(elements_todo > 0){
-		std::vector<int> pass_ids;
-		for(int i = 0 ; i < elements2.size() ; i++){
-			const auto rc = rcs[i];
-			if(rc == 0){
-				pass_ids.push_back(i);
-				rcs[i] = -1;
+			if(reduce){
+				bc_value_t acc = init;
+				for(const auto& chunk: chunk_outputs){
+					for(const auto& value: chunk){
+						const bc_value_t f_args[2] = { acc, value };
+						acc = call_function_bc(vm, pipeline._reduce_f, f_args, 2);
+					}
+				}
+				return acc;
+			}
+			else{
+				auto temp = immer::vector<bc_value_t>().transient();
+				for(const auto& chunk: chunk_outputs){
+					for(const auto& value: chunk){
+						temp.push_back(value);
+					}
+				}
+				return make_vector(pipeline._output_element_type, temp.persistent());
+			}
+		}
+		else{
+			if(reduce){
+				bc_value_t acc = init;
+				for(size_t i = 0 ; i < count ; i++){
+					auto value = get_vector_element(elements, e_type, i);
+					if(run_pipeline_stages(vm, pipeline, value)){
+						const bc_value_t f_args[2] = { acc, value };
+						acc = call_function_bc(vm, pipeline._reduce_f, f_args, 2);
+					}
+				}
+				return acc;
+			}
+			else{
+				auto temp = immer::vector<bc_value_t>().transient();
+				for(size_t i = 0 ; i < count ; i++){
+					auto value = get_vector_element(elements, e_type, i);
+					if(run_pipeline_stages(vm, pipeline, value)){
+						temp.push_back(value);
+					}
+				}
+				return make_vector(pipeline._output_element_type, temp.persistent());
 			}
 		}
+	}();
+
+	return result;
+}
+
+
+
+
+
+/////////////////////////////////////////		PURE -- SUPERMAP()
+
+
+//	Dependency graph for supermap(). Node i is element i.
+struct supermap_graph_t {
+	//	The nodes whose results are passed to f() for node i, in order. Node i can run when all of them are done.
+	std::vector<std::vector<int>> _inputs;
+
+	//	Reverse adjacency list: the nodes that have node i as an input.
+	std::vector<std::vector<int>> _dependents;
+};
+
+
+/*
+	Runs f(element, [results of inputs]) for every node, each node after all its inputs.
+	Each node is handled once and each edge once: O(nodes + edges).
+
+	Parallel: indegrees are atomic counters. The worker that completes a node's last input spawns the node as
+	a new task on the pool right away, so independent branches of the graph run at the same time.
+*/
+bc_value_t run_supermap_graph(interpreter_t& vm, const bc_value_t& elements, const bc_value_t& f, const supermap_graph_t& graph){
+	QUARK_ASSERT(vm.check_invariant());
+
+	const auto& e_type = elements._type.get_vector_element_type();
+	const auto& r_type = f._type.get_function_return();
+	const auto node_count = graph._inputs.size();
+
+	std::vector<bc_value_t> results(node_count);
+	const auto run_node = [&](interpreter_t& vm2, int node_index){
+		immer::vector<bc_value_t> solved_deps;
+		for(const auto input_index: graph._inputs[node_index]){
+			QUARK_ASSERT(results[input_index]._type.is_undefined() == false);
+			solved_deps = solved_deps.push_back(results[input_index]);
+		}
+		const bc_value_t f_args[2] = { get_vector_element(elements, e_type, node_index), make_vector(r_type, solved_deps) };
+		results[node_index] = call_function_bc(vm2, f, f_args, 2);
+	};
 
-		if(pass_ids.empty()){
-			quark::throw_runtime_error("supermap() dependency cycle error.");
+	std::vector<int> ready;
+	for(int node_index = 0 ; node_index < node_count ; node_index++){
+		if(graph._inputs[node_index].empty()){
+			ready.push_back(node_index);
 		}
+	}
 
-		for(const auto element_index: pass_ids){
-			const auto& e = elements2[element_index];
+	size_t done_count = 0;
+	if(use_parallel_path(f, node_count, k_parallel_min_graph_nodes)){
+		std::vector<std::atomic<int>> indegrees(node_count);
+		for(int node_index = 0 ; node_index < node_count ; node_index++){
+			indegrees[node_index] = static_cast<int>(graph._inputs[node_index].size());
+		}
 
-			//	Make list of the element's inputs -- the must all be complete now.
-			immer::vector<bc_value_t> solved_deps;
-			for(int element_index2 = 0 ; element_index2 < parents2.size() ; element_index2++){
-				const auto& p = parents2[element_index2];
-				const auto parent_index = p.get_int_value();
-				if(parent_index == element_index){
-					QUARK_ASSERT(element_index2 != -1);
-					QUARK_ASSERT(element_index2 >= -1 && element_index2 < elements2.size());
-					QUARK_ASSERT(rcs[element_index2] == -1);
-					QUARK_ASSERT(complete[element_index2]._type.is_undefined() == false);
-					const auto& solved = complete[element_index2];
-					solved_deps = solved_deps.push_back(solved);
+		worker_vms_t worker_vms(vm);
+		std::vector<std::vector<std::string>> node_prints(node_count);
+		std::atomic<size_t> done_count2(0);
+
+		get_shared_task_pool().run_dynamic_batch(
+			ready,
+			[&](int worker_index, int node_index, const task_pool_t::spawn_f& spawn){
+				node_prints[node_index] = worker_vms.run(
+					worker_index,
+					[&](interpreter_t& worker_vm){ run_node(worker_vm, node_index); }
+				);
+				done_count2++;
+
+				for(const auto dependent_index: graph._dependents[node_index]){
+					if(--indegrees[dependent_index] == 0){
+						spawn(dependent_index);
+					}
 				}
 			}
+		);
+		done_count = done_count2;
+
+		for(const auto& prints: node_prints){
+			vm._print_output.insert(vm._print_output.end(), prints.begin(), prints.end());
+		}
+	}
+	else{
+		std::vector<int> indegrees(node_count);
+		for(int node_index = 0 ; node_index < node_count ; node_index++){
+			indegrees[node_index] = static_cast<int>(graph._inputs[node_index].size());
+		}
 
-			const bc_value_t f_args[2] = { e, make_vector(r_type, solved_deps) };
-			const auto result1 = call_function_bc(vm, f, f_args, 2);
+		//	FIFO: nodes run roughly in waves, in index order within each wave.
+		for(size_t ready_pos = 0 ; ready_pos < ready.size() ; ready_pos++){
+			const auto node_index = ready[ready_pos];
+			run_node(vm, node_index);
+			done_count++;
 
-			const auto parent_index = parents2[element_index].get_int_value();
-			if(parent_index != -1){
-				rcs[parent_index]--;
+			for(const auto dependent_index: graph._dependents[node_index]){
+				if(--indegrees[dependent_index] == 0){
+					ready.push_back(dependent_index);
+				}
 			}
-			complete = complete.set(element_index, result1);
-			elements_todo--;
 		}
 	}
 
-	const auto result = make_vector(r_type, complete);
+	//	Nodes in a cycle never got all their inputs.
+	if(done_count != node_count){
+		quark::throw_runtime_error("supermap() dependency cycle error.");
+	}
+
+	return make_vector(r_type, immer::vector<bc_value_t>(results.begin(), results.end()));
+}
 
-#if 1
-	const auto debug = value_and_type_to_ast_json(bc_to_value(result));
-	QUARK_TRACE(json_to_pretty_string(debug._value));
-#endif
+
+//	[R] supermap([E] values, [int] parents, R (E, [R]) f)
+
+bc_value_t host__supermap(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 3);
+
+	//	Check topology.
+	if(args[0]._type.is_vector() && args[1]._type == typeid_t::make_vector(typeid_t::make_int()) && args[2]._type.is_function() && args[2]._type.get_function_args().size () == 2){
+	}
+	else{
+		quark::throw_runtime_error("supermap() requires 3 arguments.");
+	}
+
+	const auto& elements = args[0];
+	const auto& e_type = elements._type.get_vector_element_type();
+	const auto& parents = args[1];
+	const auto& f = args[2];
+	const auto& r_type = args[2]._type.get_function_return();
+	if(
+		e_type == f._type.get_function_args()[0]
+		&& r_type == f._type.get_function_args()[1].get_vector_element_type()
+	){
+	}
+	else {
+		quark::throw_runtime_error("R supermap([E] elements, R init_value, R (R acc, E element) f");
+	}
+
+	const auto element_count = get_vector_size(elements);
+	const auto& parents2 = parents._pod._external->_vector_w_inplace_elements;
+
+	if(element_count != parents2.size()) {
+		quark::throw_runtime_error("supermap() requires elements and parents be the same count.");
+	}
+
+	//	Element i is an input to its parent. A parent gets its inputs in element order.
+	supermap_graph_t graph{ std::vector<std::vector<int>>(element_count), std::vector<std::vector<int>>(element_count) };
+	for(int element_index = 0 ; element_index < element_count ; element_index++){
+		const auto parent_index = parents2[element_index]._int64;
+		if(parent_index < -1 || parent_index >= static_cast<int64_t>(element_count)){
+			quark::throw_runtime_error("supermap() parent index out of range.");
+		}
+
+		if(parent_index != -1){
+			graph._inputs[parent_index].push_back(element_index);
+			graph._dependents[element_index].push_back(static_cast<int>(parent_index));
+		}
+	}
+
+	const auto result = run_supermap_graph(vm, elements, f, graph);
 
 	return result;
 }
@@ -1321,16 +2180,10 @@ bc_value_t host__supermap(interpreter_t& vm, const bc_value_t args[], int arg_co
 
 /////////////////////////////////////////		PURE -- SUPERMAP2()
 
-//	Input dependencies are specified for as 1... many integers per E, in order. [-1] or [a, -1] or [a, b, -1 ] etc.
+//	Input dependencies are specified for as 1... many integers per E, in order. [-1] or [a, -1] or [a, b, -1 ] etc.
 //
 //	[R] supermap([E] values, [int] parents, R (E, [R]) f)
 
-struct dep_t {
-	int64_t incomplete_count;
-	std::vector<int64_t> depends_in_element_index;
-};
-
-
 bc_value_t host__supermap2(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 3);
@@ -1356,90 +2209,439 @@ bc_value_t host__supermap2(interpreter_t& vm, const bc_value_t args[], int arg_c
 		quark::throw_runtime_error("R supermap([E] elements, R init_value, R (R acc, E element) f");
 	}
 
-	const auto elements2 = get_vector(elements);
-	const auto dependencies2 = get_vector(dependencies);
-
-
-	immer::vector<bc_value_t> complete(elements2.size(), bc_value_t());
+	const auto element_count = static_cast<int64_t>(get_vector_size(elements));
+	const auto& dependencies2 = dependencies._pod._external->_vector_w_inplace_elements;
 
-	std::vector<dep_t> element_dependencies(elements2.size(), dep_t{ 0, {} });
+	supermap_graph_t graph{ std::vector<std::vector<int>>(element_count), std::vector<std::vector<int>>(element_count) };
 	{
-		const auto element_count = static_cast<int64_t>(elements2.size());
 		const auto dep_index_count = static_cast<int64_t>(dependencies2.size());
-		int element_index = 0;
-		int dep_index = 0;
-		while(element_index < element_count){
-			std::vector<int64_t> deps;
-			const auto& e = dependencies2[dep_index];
-			auto e_int = e.get_int_value();
+		int64_t dep_index = 0;
+		for(int element_index = 0 ; element_index < element_count ; element_index++){
+			if(dep_index >= dep_index_count){
+				quark::throw_runtime_error("supermap() dependency list must end with -1 for each element.");
+			}
+			auto e_int = dependencies2[dep_index]._int64;
 			while(e_int != -1){
-				deps.push_back(e_int);
+				if(e_int < 0 || e_int >= element_count){
+					quark::throw_runtime_error("supermap() dependency index out of range.");
+				}
+				graph._inputs[element_index].push_back(static_cast<int>(e_int));
+				graph._dependents[e_int].push_back(element_index);
 
 				dep_index++;
-				QUARK_ASSERT(dep_index < dep_index_count);
-
-				e_int = dependencies2[dep_index].get_int_value();
+				if(dep_index >= dep_index_count){
+					quark::throw_runtime_error("supermap() dependency list must end with -1 for each element.");
+				}
+				e_int = dependencies2[dep_index]._int64;
 			}
-			QUARK_ASSERT(element_index < element_count);
-			element_dependencies[element_index] = dep_t{ static_cast<int64_t>(deps.size()), deps };
-			element_index++;
+			dep_index++;
 		}
-		QUARK_ASSERT(element_index == element_count);
 		QUARK_ASSERT(dep_index == dep_index_count);
 	}
 
-	auto elements_todo = elements2.size();
-	while(elements_todo > 0){
+	const auto result = run_supermap_graph(vm, elements, f, graph);
+
+	return result;
+}
+
+
+
+
+
+/////////////////////////////////////////		PURE -- NUMERIC VECTORS
+
+/*
+	sum(), min_element(), max_element(), dot(), scale() and axpy() work on [int] and [double]. They run native loops
+	directly on the vector's leaf chunks, see numeric_kernel.h.
+*/
+
+
+//	Returns true for [double], false for [int]. Throws for other types.
+bool check_numeric_vector(const std::string& function_name, const bc_value_t& value){
+	const auto is_int = value._type.is_vector() && value._type.get_vector_element_type().is_int();
+	const auto is_double = value._type.is_vector() && value._type.get_vector_element_type().is_double();
+	if(is_int == false && is_double == false){
+		quark::throw_runtime_error(function_name + " requires [int] or [double].");
+	}
+	return is_double;
+}
+
+const immer::flex_vector<bc_inplace_value_t>& get_numeric_elements(const bc_value_t& value){
+	return value._pod._external->_vector_w_inplace_elements;
+}
+
+//	Calls f(a_first, b_first, count) for runs where elements of both vectors are contiguous.
+template <typename F>
+void for_each_chunk_pair(const immer::flex_vector<bc_inplace_value_t>& a, const immer::flex_vector<bc_inplace_value_t>& b, const F& f){
+	QUARK_ASSERT(a.size() == b.size());
 
-		//	Make list of elements that should be processed this pass.
-		std::vector<int> pass_ids;
-		for(int i = 0 ; i < elements2.size() ; i++){
-			const auto rc = element_dependencies[i].incomplete_count;
-			if(rc == 0){
-				pass_ids.push_back(i);
-				element_dependencies[i].incomplete_count = -1;
+	size_t index = 0;
+	immer::for_each_chunk(a, [&](const bc_inplace_value_t* a_first, const bc_inplace_value_t* a_last){
+		const auto count = static_cast<size_t>(a_last - a_first);
+		immer::for_each_chunk(
+			b.begin() + index,
+			b.begin() + index + count,
+			[&](const bc_inplace_value_t* b_first, const bc_inplace_value_t* b_last){
+				f(a_first, b_first, static_cast<size_t>(b_last - b_first));
+				a_first += b_last - b_first;
 			}
+		);
+		index += count;
+	});
+}
+
+
+//	int sum([int] values)
+//	double sum([double] values)
+bc_value_t host__sum(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 1);
+
+	const auto is_double = check_numeric_vector("sum()", args[0]);
+	const auto& values = get_numeric_elements(args[0]);
+
+	if(is_double){
+		double acc = 0.0;
+		immer::for_each_chunk(values, [&](const bc_inplace_value_t* first, const bc_inplace_value_t* last){
+			acc += sum_doubles(first, last - first);
+		});
+		return bc_value_t::make_double(acc);
+	}
+	else{
+		int64_t acc = 0;
+		immer::for_each_chunk(values, [&](const bc_inplace_value_t* first, const bc_inplace_value_t* last){
+			acc += sum_ints(first, last - first);
+		});
+		return bc_value_t::make_int(acc);
+	}
+}
+
+bc_value_t min_max_element(const std::string& function_name, const bc_value_t& vec, bool is_max){
+	const auto is_double = check_numeric_vector(function_name, vec);
+	const auto& values = get_numeric_elements(vec);
+	if(values.empty()){
+		quark::throw_runtime_error(function_name + " of empty vector.");
+	}
+
+	if(is_double){
+		double acc = values[0]._double;
+		immer::for_each_chunk(values, [&](const bc_inplace_value_t* first, const bc_inplace_value_t* last){
+			const auto e = is_max ? max_doubles(first, last - first) : min_doubles(first, last - first);
+			acc = is_max ? std::max(acc, e) : std::min(acc, e);
+		});
+		return bc_value_t::make_double(acc);
+	}
+	else{
+		int64_t acc = values[0]._int64;
+		immer::for_each_chunk(values, [&](const bc_inplace_value_t* first, const bc_inplace_value_t* last){
+			const auto e = is_max ? max_ints(first, last - first) : min_ints(first, last - first);
+			acc = is_max ? std::max(acc, e) : std::min(acc, e);
+		});
+		return bc_value_t::make_int(acc);
+	}
+}
+
+//	int min_element([int] values)
+//	double min_element([double] values)
+bc_value_t host__min_element(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 1);
+
+	return min_max_element("min_element()", args[0], false);
+}
+
+//	int max_element([int] values)
+//	double max_element([double] values)
+bc_value_t host__max_element(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 1);
+
+	return min_max_element("max_element()", args[0], true);
+}
+
+//	int dot([int] a, [int] b)
+//	double dot([double] a, [double] b)
+bc_value_t host__dot(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 2);
+
+	const auto is_double = check_numeric_vector("dot()", args[0]);
+	if(args[1]._type != args[0]._type){
+		quark::throw_runtime_error("dot() requires two vectors of the same type.");
+	}
+	const auto& a = get_numeric_elements(args[0]);
+	const auto& b = get_numeric_elements(args[1]);
+	if(a.size() != b.size()){
+		quark::throw_runtime_error("dot() requires two vectors of the same size.");
+	}
+
+	if(is_double){
+		double acc = 0.0;
+		for_each_chunk_pair(a, b, [&](const bc_inplace_value_t* a_first, const bc_inplace_value_t* b_first, size_t count){
+			acc += dot_doubles(a_first, b_first, count);
+		});
+		return bc_value_t::make_double(acc);
+	}
+	else{
+		int64_t acc = 0;
+		for_each_chunk_pair(a, b, [&](const bc_inplace_value_t* a_first, const bc_inplace_value_t* b_first, size_t count){
+			acc += dot_ints(a_first, b_first, count);
+		});
+		return bc_value_t::make_int(acc);
+	}
+}
+
+//	[int] scale([int] x, int k)
+//	[double] scale([double] x, double k)
+bc_value_t host__scale(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 2);
+
+	const auto is_double = check_numeric_vector("scale()", args[0]);
+	const auto& e_type = args[0]._type.get_vector_element_type();
+	if(args[1]._type != e_type){
+		quark::throw_runtime_error("scale() factor must have the same type as the vector's elements.");
+	}
+
+	const auto& x = get_numeric_elements(args[0]);
+	std::vector<bc_inplace_value_t> result(x.size());
+	size_t index = 0;
+	immer::for_each_chunk(x, [&](const bc_inplace_value_t* first, const bc_inplace_value_t* last){
+		if(is_double){
+			scale_doubles(result.data() + index, args[1].get_double_value(), first, last - first);
 		}
+		else{
+			scale_ints(result.data() + index, args[1].get_int_value(), first, last - first);
+		}
+		index += last - first;
+	});
+	return make_vector(e_type, immer::flex_vector<bc_inplace_value_t>(result.begin(), result.end()));
+}
+
+//	[int] axpy(int a, [int] x, [int] y)
+//	[double] axpy(double a, [double] x, [double] y)
+//	Returns a * x + y.
+bc_value_t host__axpy(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 3);
+
+	const auto is_double = check_numeric_vector("axpy()", args[1]);
+	const auto& e_type = args[1]._type.get_vector_element_type();
+	if(args[0]._type != e_type || args[2]._type != args[1]._type){
+		quark::throw_runtime_error("axpy() requires a, x and y of the same number type.");
+	}
+	const auto& x = get_numeric_elements(args[1]);
+	const auto& y = get_numeric_elements(args[2]);
+	if(x.size() != y.size()){
+		quark::throw_runtime_error("axpy() requires x and y of the same size.");
+	}
 
-		if(pass_ids.empty()){
-			quark::throw_runtime_error("supermap() dependency cycle error.");
+	std::vector<bc_inplace_value_t> result(x.size());
+	size_t index = 0;
+	for_each_chunk_pair(x, y, [&](const bc_inplace_value_t* x_first, const bc_inplace_value_t* y_first, size_t count){
+		if(is_double){
+			axpy_doubles(result.data() + index, args[0].get_double_value(), x_first, y_first, count);
+		}
+		else{
+			axpy_ints(result.data() + index, args[0].get_int_value(), x_first, y_first, count);
 		}
+		index += count;
+	});
+	return make_vector(e_type, immer::flex_vector<bc_inplace_value_t>(result.begin(), result.end()));
+}
+
+
+
+
+
+/////////////////////////////////////////		PURE -- SORT
+
+/*
+	sort() orders elements like bc_compare_value_true_deep(). [int] and [double] are sorted as raw numbers, strings
+	as raw std::string:s. All sorts are stable: equal elements keep their order.
+*/
+
+
+//	Sorting this many elements takes long enough to be worth splitting between the workers.
+const size_t k_parallel_min_sort_elements = 16384;
 
-		for(const auto element_index: pass_ids){
-			const auto& e = elements2[element_index];
+/*
+	Stable merge sort. Big vectors are sorted chunk by chunk on the worker pool, then the sorted runs are merged
+	pairwise, one round at a time, each round's merges running in parallel. less() must be thread safe.
+*/
+template <typename T, typename LESS>
+void parallel_stable_sort(task_pool_t& pool, std::vector<T>& values, const LESS& less){
+	const auto count = values.size();
+	const auto worker_count = static_cast<size_t>(pool.get_worker_count());
+	if(count < k_parallel_min_sort_elements || worker_count < 2){
+		std::stable_sort(values.begin(), values.end(), less);
+		return;
+	}
+
+	const auto chunk_size = count / (worker_count * k_parallel_chunks_per_worker) + 1;
+	pool.run_batch(
+		static_cast<int>((count + chunk_size - 1) / chunk_size),
+		[&](int worker_index, int chunk_index){
+			const auto begin = chunk_index * chunk_size;
+			const auto end = std::min(begin + chunk_size, count);
+			std::stable_sort(values.begin() + begin, values.begin() + end, less);
+		}
+	);
 
-			immer::vector<bc_value_t> ready_elements;
-			for(const auto& dep_e: element_dependencies[element_index].depends_in_element_index){
-				const auto& ready = complete[dep_e];
-				ready_elements = ready_elements.push_back(ready);
+	//	std::merge() takes from the left run when elements are equal, which keeps the sort stable.
+	std::vector<T> buffer(count);
+	for(auto run_size = chunk_size ; run_size < count ; run_size *= 2){
+		const auto merge_count = (count + run_size * 2 - 1) / (run_size * 2);
+		pool.run_batch(
+			static_cast<int>(merge_count),
+			[&](int worker_index, int merge_index){
+				const auto begin = merge_index * run_size * 2;
+				const auto mid = std::min(begin + run_size, count);
+				const auto end = std::min(begin + run_size * 2, count);
+				std::merge(
+					values.begin() + begin, values.begin() + mid,
+					values.begin() + mid, values.begin() + end,
+					buffer.begin() + begin,
+					less
+				);
 			}
-			const auto ready_elements2 = make_vector(r_type, ready_elements);
-			const bc_value_t f_args[2] = { e, ready_elements2 };
+		);
+		values.swap(buffer);
+	}
+}
+
+//	Same order as compare_double_values(): all NaNs last.
+bool double_less(double a, double b){
+	return compare_double_values(a, b) < 0;
+}
+
+//	Returns the indexes of keys, in the order that sorts the keys.
+std::vector<size_t> get_sort_order(const std::vector<bc_value_t>& keys, const typeid_t& key_type){
+	std::vector<size_t> order(keys.size());
+	for(size_t i = 0 ; i < keys.size() ; i++){
+		order[i] = i;
+	}
+
+	if(key_type.is_int()){
+		std::vector<int64_t> k(keys.size());
+		for(size_t i = 0 ; i < keys.size() ; i++){
+			k[i] = keys[i]._pod._inplace._int64;
+		}
+		parallel_stable_sort(get_shared_task_pool(), order, [&](size_t a, size_t b){ return k[a] < k[b]; });
+	}
+	else if(key_type.is_double()){
+		std::vector<double> k(keys.size());
+		for(size_t i = 0 ; i < keys.size() ; i++){
+			k[i] = keys[i]._pod._inplace._double;
+		}
+		parallel_stable_sort(get_shared_task_pool(), order, [&](size_t a, size_t b){ return double_less(k[a], k[b]); });
+	}
+	else if(key_type.is_string()){
+		std::vector<std::string_view> k(keys.size());
+		for(size_t i = 0 ; i < keys.size() ; i++){
+			k[i] = get_string_view(keys[i]._pod._external);
+		}
+		parallel_stable_sort(get_shared_task_pool(), order, [&](size_t a, size_t b){ return k[a] < k[b]; });
+	}
+	else{
+		parallel_stable_sort(get_shared_task_pool(), order, [&](size_t a, size_t b){ return bc_compare_value_true_deep(keys[a], keys[b], key_type) < 0; });
+	}
+	return order;
+}
+
+
+//	[E] sort([E] elements)
+bc_value_t host__sort(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 1);
+
+	if(args[0]._type.is_vector() == false){
+		quark::throw_runtime_error("sort() requires a vector.");
+	}
+	const auto e_type = args[0]._type.get_vector_element_type();
+
+	if(e_type.is_int() || e_type.is_double()){
+		const auto& input_vec = args[0]._pod._external->_vector_w_inplace_elements;
+		std::vector<bc_inplace_value_t> values(input_vec.begin(), input_vec.end());
+		if(e_type.is_int()){
+			parallel_stable_sort(get_shared_task_pool(), values, [](const bc_inplace_value_t& a, const bc_inplace_value_t& b){ return a._int64 < b._int64; });
+		}
+		else{
+			parallel_stable_sort(get_shared_task_pool(), values, [](const bc_inplace_value_t& a, const bc_inplace_value_t& b){ return double_less(a._double, b._double); });
+		}
+		return make_vector(e_type, immer::flex_vector<bc_inplace_value_t>(values.begin(), values.end()));
+	}
+	else{
+		const auto input_vec = get_vector(args[0]);
+		const std::vector<bc_value_t> elements(input_vec.begin(), input_vec.end());
+		const auto order = get_sort_order(elements, e_type);
+
+		auto result = immer::vector<bc_value_t>().transient();
+		for(const auto index: order){
+			result.push_back(elements[index]);
+		}
+		return make_vector(e_type, result.persistent());
+	}
+}
+
+//	[E] sort_by([E] elements, K key_f(E e))
+//	key_f() is called once per element, not once per comparison.
+bc_value_t host__sort_by(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 2);
+
+	if(args[0]._type.is_vector() == false){
+		quark::throw_runtime_error("sort_by() requires a vector.");
+	}
+	const auto e_type = args[0]._type.get_vector_element_type();
 
-			const auto result1 = call_function_bc(vm, f, f_args, 2);
+	const auto f = args[1];
+	if(f._type.is_function() == false || f._type.get_function_args().size() != 1 || f._type.get_function_args()[0] != e_type){
+		quark::throw_runtime_error("sort_by() key function must accept collection elements as its argument.");
+	}
+	const auto key_type = f._type.get_function_return();
 
-			//	Decrement incomplete_count for every element that specifies *element_index* as a input dependency.
-			for(auto& x: element_dependencies){
-				const auto it = std::find(x.depends_in_element_index.begin(), x.depends_in_element_index.end(), element_index);
-				if(it != x.depends_in_element_index.end()){
-					x.incomplete_count--;
+	const auto input_vec = get_vector(args[0]);
+	std::vector<bc_value_t> keys(input_vec.size());
+	if(use_parallel_path(f, input_vec.size())){
+		run_parallel_chunks(
+			vm,
+			input_vec.size(),
+			[&](interpreter_t& worker_vm, size_t chunk_index, size_t begin, size_t end){
+				for(auto i = begin ; i < end ; i++){
+					const bc_value_t f_args[1] = { input_vec[i] };
+					keys[i] = call_function_bc(worker_vm, f, f_args, 1);
 				}
 			}
-
-			//	Copy value to output.
-			complete = complete.set(element_index, result1);
-			elements_todo--;
+		);
+	}
+	else{
+		for(size_t i = 0 ; i < input_vec.size() ; i++){
+			const bc_value_t f_args[1] = { input_vec[i] };
+			keys[i] = call_function_bc(vm, f, f_args, 1);
 		}
 	}
 
-	const auto result = make_vector(r_type, complete);
+	const auto order = get_sort_order(keys, key_type);
 
-#if 1
-	const auto debug = value_and_type_to_ast_json(bc_to_value(result));
-	QUARK_TRACE(json_to_pretty_string(debug._value));
-#endif
+	auto result = immer::vector<bc_value_t>().transient();
+	for(const auto index: order){
+		result.push_back(input_vec[index]);
+	}
+	return make_vector(e_type, result.persistent());
+}
 
-	return result;
+
+QUARK_UNIT_TEST("parallel_stable_sort()", "", "", ""){
+	std::vector<std::pair<int, int>> values;
+	for(int i = 0 ; i < 100000 ; i++){
+		values.push_back({ (i * 7919) % 1000, i });
+	}
+	task_pool_t pool(4);
+	parallel_stable_sort(pool, values, [](const std::pair<int, int>& a, const std::pair<int, int>& b){ return a.first < b.first; });
+	for(size_t i = 1 ; i < values.size() ; i++){
+		QUARK_UT_VERIFY(values[i - 1].first < values[i].first || (values[i - 1].first == values[i].first && values[i - 1].second < values[i].second));
+	}
 }
 
 
@@ -1464,21 +2666,41 @@ bc_value_t host__print(interpreter_t& vm, const bc_value_t args[], int arg_count
 
 	return bc_value_t::make_undefined();
 }
+//	The destination is a process name or a channel_t. The bytecode generator turns send("literal", ...) into a channel_t.
 bc_value_t host__send(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 2);
-	QUARK_ASSERT(args[0]._type.is_string());
-	QUARK_ASSERT(args[1]._type.is_json_value());
 
-	const auto& process_id = args[0].get_string_value();
-	const auto& message_json = args[1].get_json_value();
+	const auto& message = args[1];
 
-	QUARK_TRACE_SS("send(\"" << process_id << "\"," << json_to_pretty_string(message_json) <<")");
+	//	No copy or serialization: the receiver gets the same value, the refcount is bumped.
+	if(args[0]._type.is_string()){
+		const auto& process_id = args[0].get_string_value();
+		QUARK_TRACE_SS("send(\"" << process_id << "\", " << typeid_to_compact_string(message._type) << ")");
+		vm._handler->on_send(process_id, message);
+	}
+	else{
+		QUARK_ASSERT(args[0]._type == make__channel_t__type());
+		const auto channel_id = static_cast<int>(args[0].get_struct_value()[0].get_int_value());
+		QUARK_TRACE_SS("send(channel " << channel_id << ", " << typeid_to_compact_string(message._type) << ")");
+		vm._handler->on_send(channel_id, message);
+	}
+
+	return bc_value_t::make_undefined();
+}
 
+bc_value_t host__get_channel(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 1);
+	QUARK_ASSERT(args[0]._type.is_string());
 
-	vm._handler->on_send(process_id, message_json);
+	const auto process_id = args[0].get_string_value();
+	const auto it = vm._imm->_channel_ids.find(process_id);
+	if(it == vm._imm->_channel_ids.end()){
+		quark::throw_runtime_error("Unknown process \"" + process_id + "\".");
+	}
 
-	return bc_value_t::make_undefined();
+	return bc_value_t::make_struct_value(make__channel_t__type(), { bc_value_t::make_int(it->second) });
 }
 
 
@@ -1871,6 +3093,13 @@ typeid_t return_type__map(const std::vector<typeid_t>& args){
 	return ret;
 }
 
+//	Only [int] and [double] are allowed, host__sum() etc checks that at runtime.
+typeid_t return_type__vector_element(const std::vector<typeid_t>& args){
+	QUARK_ASSERT(args.size() >= 1);
+
+	return args[0].is_vector() ? args[0].get_vector_element_type() : args[0];
+}
+
 typeid_t return_type__supermap(const std::vector<typeid_t>& args){
 	const auto f = args[2].get_function_return();
 	const auto ret = typeid_t::make_vector(f);
@@ -1911,6 +3140,13 @@ std::vector<host_function_record_t> get_host_function_records(){
 		make_rec("jsonvalue_to_value", host__jsonvalue_to_value, 1020, typeid_t::make_function(DYN, { typeid_t::make_json_value(), typeid_t::make_typeid() }, epure::pure)),
 		make_rec("get_json_type", host__get_json_type, 1021, typeid_t::make_function(typeid_t::make_int(), {typeid_t::make_json_value()}, epure::pure)),
 
+		make_rec("split", host__split, 1048, typeid_t::make_function(typeid_t::make_vector(typeid_t::make_string()), { typeid_t::make_string(), typeid_t::make_string() }, epure::pure)),
+		make_rec("join", host__join, 1049, typeid_t::make_function(typeid_t::make_string(), { typeid_t::make_vector(typeid_t::make_string()), typeid_t::make_string() }, epure::pure)),
+		make_rec("find_substring", host__find_substring, 1050, typeid_t::make_function(typeid_t::make_int(), { typeid_t::make_string(), typeid_t::make_string(), typeid_t::make_int() }, epure::pure)),
+		make_rec("starts_with", host__starts_with, 1051, typeid_t::make_function(typeid_t::make_bool(), { typeid_t::make_string(), typeid_t::make_string() }, epure::pure)),
+		make_rec("trim", host__trim, 1052, typeid_t::make_function(typeid_t::make_string(), { typeid_t::make_string() }, epure::pure)),
+		make_rec("replace_all", host__replace_all, 1053, typeid_t::make_function(typeid_t::make_string(), { typeid_t::make_string(), typeid_t::make_string(), typeid_t::make_string() }, epure::pure)),
+
 		make_rec("calc_string_sha1", host__calc_string_sha1, 1031, typeid_t::make_function(make__sha1_t__type(), { typeid_t::make_string() }, epure::pure)),
 		make_rec("calc_binary_sha1", host__calc_binary_sha1, 1032, typeid_t::make_function(make__sha1_t__type(), { make__binary_t__type() }, epure::pure)),
 
@@ -1931,10 +3167,25 @@ std::vector<host_function_record_t> get_host_function_records(){
 		make_rec("filter", host__filter, 1036, typeid_t::make_function(DYN, { DYN, DYN }, epure::pure), return_type_sames_as_arg0),
 		make_rec("reduce", host__reduce, 1035, typeid_t::make_function(DYN, { DYN, DYN, DYN }, epure::pure), return_type_sames_as_arg1),
 		make_rec("supermap", host__supermap, 1037, typeid_t::make_function(DYN, { DYN, DYN, DYN }, epure::pure), return_type__supermap),
+		make_rec("fold_parallel", host__fold_parallel, 1038, typeid_t::make_function(DYN, { DYN, DYN, DYN, DYN }, epure::pure), return_type_sames_as_arg1),
+
+		//	Only called by code from the bytecode generator, see host__pipeline().
+		make_rec(k_pipeline_function_name, host__pipeline, 1039, typeid_t::make_function(DYN, { DYN, DYN, DYN, DYN, DYN, DYN, DYN }, epure::pure), return_type_sames_as_arg0),
+
+		make_rec("sum", host__sum, 1040, typeid_t::make_function(DYN, { DYN }, epure::pure), return_type__vector_element),
+		make_rec("min_element", host__min_element, 1041, typeid_t::make_function(DYN, { DYN }, epure::pure), return_type__vector_element),
+		make_rec("max_element", host__max_element, 1042, typeid_t::make_function(DYN, { DYN }, epure::pure), return_type__vector_element),
+		make_rec("dot", host__dot, 1043, typeid_t::make_function(DYN, { DYN, DYN }, epure::pure), return_type__vector_element),
+		make_rec("scale", host__scale, 1044, typeid_t::make_function(DYN, { DYN, DYN }, epure::pure), return_type_sames_as_arg0),
+		make_rec("axpy", host__axpy, 1045, typeid_t::make_function(DYN, { DYN, DYN, DYN }, epure::pure), return_type_sames_as_arg1),
+
+		make_rec("sort", host__sort, 1046, typeid_t::make_function(DYN, { DYN }, epure::pure), return_type_sames_as_arg0),
+		make_rec("sort_by", host__sort_by, 1047, typeid_t::make_function(DYN, { DYN, DYN }, epure::pure), return_type_sames_as_arg0),
 
 		//	print = impure!
 		make_rec("print", host__print, 1000, typeid_t::make_function(VOID, { DYN }, epure::pure)),
-		make_rec("send", host__send, 1022, typeid_t::make_function(VOID, { typeid_t::make_string(), typeid_t::make_json_value() }, epure::impure)),
+		make_rec("send", host__send, 1022, typeid_t::make_function(VOID, { DYN, DYN }, epure::impure)),
+		make_rec("get_channel", host__get_channel, 1054, typeid_t::make_function(make__channel_t__type(), { typeid_t::make_string() }, epure::pure)),
 		make_rec("get_time_of_day", host__get_time_of_day, 1005, typeid_t::make_function(typeid_t::make_int(), {}, epure::impure)),
 
 
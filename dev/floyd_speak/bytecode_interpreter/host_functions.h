@@ -23,10 +23,34 @@
 namespace floyd {
 
 enum class host_function_id {
-	jsonvalue_to_value = 1020
+	jsonvalue_to_value = 1020,
+	map = 1033,
+	reduce = 1035,
+	filter = 1036,
+	pipeline = 1039,
+	send = 1022,
+	get_channel = 1054
 };
 
 
+//	The bytecode generator fuses chains of map() / filter() / reduce() into one call to this host function.
+const std::string k_pipeline_function_name = "**pipeline**";
+
+//	What a fused pipeline does with each of its functions.
+enum class pipeline_stage {
+	k_map = 0,
+	k_filter = 1,
+
+	//	Only as last stage.
+	k_reduce = 2
+};
+
+const int k_pipeline_max_functions = 4;
+
+//	send() takes a process name or one of these.
+typeid_t make__channel_t__type();
+
+
 extern const std::string k_builtin_types_and_constants;
 
 typedef typeid_t (*HOST_FUNCTION__CALC_RETURN_TYPE)(const std::vector<typeid_t>& args);
@@ -0,0 +1,750 @@
+//
+//  numeric_kernel.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-02-24.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "numeric_kernel.h"
+
+#include <algorithm>
+
+//	SSE2 is always there on x86-64. AVX2 code is compiled per function and only used if the CPU has it.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+	#define NUMERIC_KERNEL_X86 1
+	#include <immintrin.h>
+#else
+	#define NUMERIC_KERNEL_X86 0
+#endif
+
+namespace floyd {
+
+
+//	Registers hold this many elements each. All registers of a block should stay in L1.
+const size_t k_kernel_block_size = 256;
+
+
+//////////////////////////////////////		make_numeric_kernel()
+
+
+static std::pair<bool, numeric_kernel_t::opcode> get_kernel_opcode(bc_opcode opcode, base_type type){
+	typedef numeric_kernel_t::opcode op;
+
+	if(opcode == bc_opcode::k_copy_reg_inplace_value){
+		return { true, op::k_copy };
+	}
+	else if(type == base_type::k_int){
+		switch(opcode){
+			case bc_opcode::k_add_int: return { true, op::k_add };
+			case bc_opcode::k_subtract_int: return { true, op::k_subtract };
+			case bc_opcode::k_multiply_int: return { true, op::k_multiply };
+			case bc_opcode::k_divide_int: return { true, op::k_divide };
+			case bc_opcode::k_remainder_int: return { true, op::k_remainder };
+			default: return { false, op::k_copy };
+		}
+	}
+	else{
+		switch(opcode){
+			case bc_opcode::k_add_double: return { true, op::k_add };
+			case bc_opcode::k_subtract_double: return { true, op::k_subtract };
+			case bc_opcode::k_multiply_double: return { true, op::k_multiply };
+			case bc_opcode::k_divide_double: return { true, op::k_divide };
+			default: return { false, op::k_copy };
+		}
+	}
+}
+
+std::shared_ptr<const numeric_kernel_t> make_numeric_kernel(const bc_function_definition_t& function_def){
+	if(function_def._host_function_id != 0 || function_def._frame_ptr == nullptr){
+		return nullptr;
+	}
+
+	const auto& function_type = function_def._function_type;
+	const auto& args = function_type.get_function_args();
+	const auto return_type = function_type.get_function_return();
+	if(args.size() != 1 || args[0] != return_type || (return_type.is_int() == false && return_type.is_double() == false)){
+		return nullptr;
+	}
+
+	const auto& frame = *function_def._frame_ptr;
+	const auto type = return_type.get_base_type();
+	const auto register_count = static_cast<int>(frame._symbols.size());
+
+	//	A register can be read once it has a value: the argument, constants and registers written earlier.
+	std::vector<bool> has_value(register_count, false);
+	std::vector<bool> is_constant(register_count, false);
+	std::vector<std::pair<int, bc_inplace_value_t>> constants;
+	for(int i = 0 ; i < register_count ; i++){
+		const auto& symbol = frame._symbols[i].second;
+		if(symbol._value_type.get_base_type() != type){
+			return nullptr;
+		}
+		if(i > 0 && symbol._const_value._type.is_undefined() == false){
+			constants.push_back({ i, symbol._const_value._pod._inplace });
+			is_constant[i] = true;
+			has_value[i] = true;
+		}
+	}
+	has_value[0] = true;
+
+	const auto is_reg = [&](int reg){ return reg >= 0 && reg < register_count; };
+
+	std::vector<numeric_kernel_t::instruction_t> instructions;
+	for(int pc = 0 ; pc < frame._instructions.size() ; pc++){
+		const auto& instruction = frame._instructions[pc];
+
+		if(instruction._opcode == bc_opcode::k_return){
+			if(pc != frame._instructions.size() - 1 || is_reg(instruction._a) == false || has_value[instruction._a] == false){
+				return nullptr;
+			}
+			return std::make_shared<numeric_kernel_t>(
+				numeric_kernel_t{ type, register_count, constants, instructions, instruction._a }
+			);
+		}
+
+		const auto opcode = get_kernel_opcode(instruction._opcode, type);
+		if(opcode.first == false){
+			return nullptr;
+		}
+
+		//	k_copy only reads B. Use B for C too, so all instructions read two valid registers.
+		const auto c = opcode.second == numeric_kernel_t::opcode::k_copy ? instruction._b : instruction._c;
+		if(
+			is_reg(instruction._a) == false || is_constant[instruction._a]
+			|| is_reg(instruction._b) == false || has_value[instruction._b] == false
+			|| is_reg(c) == false || has_value[c] == false
+		){
+			return nullptr;
+		}
+		instructions.push_back({ opcode.second, instruction._a, instruction._b, c });
+		has_value[instruction._a] = true;
+	}
+
+	//	No return.
+	return nullptr;
+}
+
+
+//////////////////////////////////////		SCALAR
+
+
+static void run_int_op_scalar(numeric_kernel_t::opcode opcode, int64_t a[], const int64_t b[], const int64_t c[], size_t count){
+	typedef numeric_kernel_t::opcode op;
+
+	switch(opcode){
+		case op::k_copy: std::copy(b, b + count, a); break;
+		case op::k_add: for(size_t i = 0 ; i < count ; i++){ a[i] = b[i] + c[i]; } break;
+		case op::k_subtract: for(size_t i = 0 ; i < count ; i++){ a[i] = b[i] - c[i]; } break;
+		case op::k_multiply: for(size_t i = 0 ; i < count ; i++){ a[i] = b[i] * c[i]; } break;
+		case op::k_divide: for(size_t i = 0 ; i < count ; i++){ a[i] = b[i] / c[i]; } break;
+		case op::k_remainder: for(size_t i = 0 ; i < count ; i++){ a[i] = b[i] % c[i]; } break;
+	}
+}
+
+static void run_double_op_scalar(numeric_kernel_t::opcode opcode, double a[], const double b[], const double c[], size_t count){
+	typedef numeric_kernel_t::opcode op;
+
+	switch(opcode){
+		case op::k_copy: std::copy(b, b + count, a); break;
+		case op::k_add: for(size_t i = 0 ; i < count ; i++){ a[i] = b[i] + c[i]; } break;
+		case op::k_subtract: for(size_t i = 0 ; i < count ; i++){ a[i] = b[i] - c[i]; } break;
+		case op::k_multiply: for(size_t i = 0 ; i < count ; i++){ a[i] = b[i] * c[i]; } break;
+		case op::k_divide: for(size_t i = 0 ; i < count ; i++){ a[i] = b[i] / c[i]; } break;
+		case op::k_remainder: QUARK_ASSERT(false); break;
+	}
+}
+
+
+//////////////////////////////////////		SSE2 / AVX2
+
+/*
+	These do as many elements as fit in whole vectors, the rest is left to the scalar code. There is no 64-bit
+	integer multiply or divide in SSE2 / AVX2, those stay scalar.
+*/
+
+#if NUMERIC_KERNEL_X86
+
+static size_t run_int_op_sse2(numeric_kernel_t::opcode opcode, int64_t a[], const int64_t b[], const int64_t c[], size_t count){
+	typedef numeric_kernel_t::opcode op;
+
+	size_t i = 0;
+	if(opcode == op::k_add){
+		for( ; i + 2 <= count ; i += 2){
+			const auto r = _mm_add_epi64(_mm_loadu_si128((const __m128i*)(b + i)), _mm_loadu_si128((const __m128i*)(c + i)));
+			_mm_storeu_si128((__m128i*)(a + i), r);
+		}
+	}
+	else if(opcode == op::k_subtract){
+		for( ; i + 2 <= count ; i += 2){
+			const auto r = _mm_sub_epi64(_mm_loadu_si128((const __m128i*)(b + i)), _mm_loadu_si128((const __m128i*)(c + i)));
+			_mm_storeu_si128((__m128i*)(a + i), r);
+		}
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t run_int_op_avx2(numeric_kernel_t::opcode opcode, int64_t a[], const int64_t b[], const int64_t c[], size_t count){
+	typedef numeric_kernel_t::opcode op;
+
+	size_t i = 0;
+	if(opcode == op::k_add){
+		for( ; i + 4 <= count ; i += 4){
+			const auto r = _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(b + i)), _mm256_loadu_si256((const __m256i*)(c + i)));
+			_mm256_storeu_si256((__m256i*)(a + i), r);
+		}
+	}
+	else if(opcode == op::k_subtract){
+		for( ; i + 4 <= count ; i += 4){
+			const auto r = _mm256_sub_epi64(_mm256_loadu_si256((const __m256i*)(b + i)), _mm256_loadu_si256((const __m256i*)(c + i)));
+			_mm256_storeu_si256((__m256i*)(a + i), r);
+		}
+	}
+	return i;
+}
+
+static size_t run_double_op_sse2(numeric_kernel_t::opcode opcode, double a[], const double b[], const double c[], size_t count){
+	typedef numeric_kernel_t::opcode op;
+
+	size_t i = 0;
+	switch(opcode){
+		case op::k_add:
+			for( ; i + 2 <= count ; i += 2){ _mm_storeu_pd(a + i, _mm_add_pd(_mm_loadu_pd(b + i), _mm_loadu_pd(c + i))); }
+			break;
+		case op::k_subtract:
+			for( ; i + 2 <= count ; i += 2){ _mm_storeu_pd(a + i, _mm_sub_pd(_mm_loadu_pd(b + i), _mm_loadu_pd(c + i))); }
+			break;
+		case op::k_multiply:
+			for( ; i + 2 <= count ; i += 2){ _mm_storeu_pd(a + i, _mm_mul_pd(_mm_loadu_pd(b + i), _mm_loadu_pd(c + i))); }
+			break;
+		case op::k_divide:
+			for( ; i + 2 <= count ; i += 2){ _mm_storeu_pd(a + i, _mm_div_pd(_mm_loadu_pd(b + i), _mm_loadu_pd(c + i))); }
+			break;
+		default:
+			break;
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t run_double_op_avx2(numeric_kernel_t::opcode opcode, double a[], const double b[], const double c[], size_t count){
+	typedef numeric_kernel_t::opcode op;
+
+	size_t i = 0;
+	switch(opcode){
+		case op::k_add:
+			for( ; i + 4 <= count ; i += 4){ _mm256_storeu_pd(a + i, _mm256_add_pd(_mm256_loadu_pd(b + i), _mm256_loadu_pd(c + i))); }
+			break;
+		case op::k_subtract:
+			for( ; i + 4 <= count ; i += 4){ _mm256_storeu_pd(a + i, _mm256_sub_pd(_mm256_loadu_pd(b + i), _mm256_loadu_pd(c + i))); }
+			break;
+		case op::k_multiply:
+			for( ; i + 4 <= count ; i += 4){ _mm256_storeu_pd(a + i, _mm256_mul_pd(_mm256_loadu_pd(b + i), _mm256_loadu_pd(c + i))); }
+			break;
+		case op::k_divide:
+			for( ; i + 4 <= count ; i += 4){ _mm256_storeu_pd(a + i, _mm256_div_pd(_mm256_loadu_pd(b + i), _mm256_loadu_pd(c + i))); }
+			break;
+		default:
+			break;
+	}
+	return i;
+}
+
+static bool has_avx2(){
+	static const bool result = __builtin_cpu_supports("avx2");
+	return result;
+}
+
+#endif
+
+
+//////////////////////////////////////		run_numeric_kernel()
+
+
+static void run_op(numeric_kernel_t::opcode opcode, int64_t a[], const int64_t b[], const int64_t c[], size_t count){
+	if(opcode == numeric_kernel_t::opcode::k_divide || opcode == numeric_kernel_t::opcode::k_remainder){
+		if(std::find(c, c + count, 0) != c + count){
+			quark::throw_runtime_error("EEE_DIVIDE_BY_ZERO");
+		}
+	}
+
+#if NUMERIC_KERNEL_X86
+	const auto done = has_avx2() ? run_int_op_avx2(opcode, a, b, c, count) : run_int_op_sse2(opcode, a, b, c, count);
+#else
+	const size_t done = 0;
+#endif
+	run_int_op_scalar(opcode, a + done, b + done, c + done, count - done);
+}
+
+static void run_op(numeric_kernel_t::opcode opcode, double a[], const double b[], const double c[], size_t count){
+	if(opcode == numeric_kernel_t::opcode::k_divide){
+		if(std::find(c, c + count, 0.0) != c + count){
+			quark::throw_runtime_error("EEE_DIVIDE_BY_ZERO");
+		}
+	}
+
+#if NUMERIC_KERNEL_X86
+	const auto done = has_avx2() ? run_double_op_avx2(opcode, a, b, c, count) : run_double_op_sse2(opcode, a, b, c, count);
+#else
+	const size_t done = 0;
+#endif
+	run_double_op_scalar(opcode, a + done, b + done, c + done, count - done);
+}
+
+static void read_inplace(const bc_inplace_value_t& value, int64_t& out){ out = value._int64; }
+static void read_inplace(const bc_inplace_value_t& value, double& out){ out = value._double; }
+static void write_inplace(bc_inplace_value_t& value, int64_t v){ value._int64 = v; }
+static void write_inplace(bc_inplace_value_t& value, double v){ value._double = v; }
+
+template <typename T>
+void run_numeric_kernel_blocks(const numeric_kernel_t& kernel, const bc_inplace_value_t input[], bc_inplace_value_t output[], size_t count){
+	std::vector<T> registers(kernel._register_count * k_kernel_block_size);
+	const auto get_register = [&](int reg){ return &registers[reg * k_kernel_block_size]; };
+
+	for(const auto& e: kernel._constants){
+		T value;
+		read_inplace(e.second, value);
+		std::fill(get_register(e.first), get_register(e.first) + k_kernel_block_size, value);
+	}
+
+	for(size_t begin = 0 ; begin < count ; begin += k_kernel_block_size){
+		const auto block_count = std::min(k_kernel_block_size, count - begin);
+
+		auto arg = get_register(0);
+		for(size_t i = 0 ; i < block_count ; i++){
+			read_inplace(input[begin + i], arg[i]);
+		}
+
+		for(const auto& instruction: kernel._instructions){
+			run_op(instruction._opcode, get_register(instruction._a), get_register(instruction._b), get_register(instruction._c), block_count);
+		}
+
+		const auto result = get_register(kernel._return_register);
+		for(size_t i = 0 ; i < block_count ; i++){
+			write_inplace(output[begin + i], result[i]);
+		}
+	}
+}
+
+void run_numeric_kernel(const numeric_kernel_t& kernel, const bc_inplace_value_t input[], bc_inplace_value_t output[], size_t count){
+	QUARK_ASSERT(kernel._type == base_type::k_int || kernel._type == base_type::k_double);
+
+	if(kernel._type == base_type::k_int){
+		run_numeric_kernel_blocks<int64_t>(kernel, input, output, count);
+	}
+	else{
+		run_numeric_kernel_blocks<double>(kernel, input, output, count);
+	}
+}
+
+
+
+//////////////////////////////////////		VECTOR PRIMITIVES
+
+/*
+	Same pattern as the kernel ops: the SSE2 / AVX2 functions do whole vectors and return how many elements they
+	did, the scalar loop does the rest.
+*/
+
+static_assert(sizeof(bc_inplace_value_t) == sizeof(double), "[double] elements must be packed doubles.");
+
+#if NUMERIC_KERNEL_X86
+
+static const double* as_doubles(const bc_inplace_value_t values[]){
+	return reinterpret_cast<const double*>(values);
+}
+static double* as_doubles(bc_inplace_value_t values[]){
+	return reinterpret_cast<double*>(values);
+}
+
+static size_t sum_ints_sse2(const bc_inplace_value_t values[], size_t count, int64_t& acc){
+	auto sum = _mm_setzero_si128();
+	size_t i = 0;
+	for( ; i + 2 <= count ; i += 2){
+		sum = _mm_add_epi64(sum, _mm_loadu_si128((const __m128i*)(values + i)));
+	}
+	int64_t lanes[2];
+	_mm_storeu_si128((__m128i*)lanes, sum);
+	acc += lanes[0] + lanes[1];
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t sum_ints_avx2(const bc_inplace_value_t values[], size_t count, int64_t& acc){
+	auto sum = _mm256_setzero_si256();
+	size_t i = 0;
+	for( ; i + 4 <= count ; i += 4){
+		sum = _mm256_add_epi64(sum, _mm256_loadu_si256((const __m256i*)(values + i)));
+	}
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, sum);
+	acc += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	return i;
+}
+
+//	AVX2 has a 64-bit compare, SSE2 doesn't. min / max of ints are AVX2 or scalar.
+__attribute__((target("avx2")))
+static size_t min_max_ints_avx2(const bc_inplace_value_t values[], size_t count, bool is_max, int64_t& acc){
+	auto r = _mm256_set1_epi64x(acc);
+	size_t i = 0;
+	for( ; i + 4 <= count ; i += 4){
+		const auto v = _mm256_loadu_si256((const __m256i*)(values + i));
+		const auto v_is_greater = _mm256_cmpgt_epi64(v, r);
+		r = is_max ? _mm256_blendv_epi8(r, v, v_is_greater) : _mm256_blendv_epi8(v, r, v_is_greater);
+	}
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, r);
+	for(const auto e: lanes){
+		acc = is_max ? std::max(acc, e) : std::min(acc, e);
+	}
+	return i;
+}
+
+static size_t sum_doubles_sse2(const bc_inplace_value_t values[], size_t count, double& acc){
+	auto sum = _mm_setzero_pd();
+	size_t i = 0;
+	for( ; i + 2 <= count ; i += 2){
+		sum = _mm_add_pd(sum, _mm_loadu_pd(as_doubles(values + i)));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, sum);
+	acc += lanes[0] + lanes[1];
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t sum_doubles_avx2(const bc_inplace_value_t values[], size_t count, double& acc){
+	auto sum = _mm256_setzero_pd();
+	size_t i = 0;
+	for( ; i + 4 <= count ; i += 4){
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(as_doubles(values + i)));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, sum);
+	acc += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	return i;
+}
+
+static size_t min_max_doubles_sse2(const bc_inplace_value_t values[], size_t count, bool is_max, double& acc){
+	auto r = _mm_set1_pd(acc);
+	size_t i = 0;
+	for( ; i + 2 <= count ; i += 2){
+		const auto v = _mm_loadu_pd(as_doubles(values + i));
+		r = is_max ? _mm_max_pd(r, v) : _mm_min_pd(r, v);
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, r);
+	for(const auto e: lanes){
+		acc = is_max ? std::max(acc, e) : std::min(acc, e);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t min_max_doubles_avx2(const bc_inplace_value_t values[], size_t count, bool is_max, double& acc){
+	auto r = _mm256_set1_pd(acc);
+	size_t i = 0;
+	for( ; i + 4 <= count ; i += 4){
+		const auto v = _mm256_loadu_pd(as_doubles(values + i));
+		r = is_max ? _mm256_max_pd(r, v) : _mm256_min_pd(r, v);
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, r);
+	for(const auto e: lanes){
+		acc = is_max ? std::max(acc, e) : std::min(acc, e);
+	}
+	return i;
+}
+
+static size_t dot_doubles_sse2(const bc_inplace_value_t a[], const bc_inplace_value_t b[], size_t count, double& acc){
+	auto sum = _mm_setzero_pd();
+	size_t i = 0;
+	for( ; i + 2 <= count ; i += 2){
+		sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(as_doubles(a + i)), _mm_loadu_pd(as_doubles(b + i))));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, sum);
+	acc += lanes[0] + lanes[1];
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t dot_doubles_avx2(const bc_inplace_value_t a[], const bc_inplace_value_t b[], size_t count, double& acc){
+	auto sum = _mm256_setzero_pd();
+	size_t i = 0;
+	for( ; i + 4 <= count ; i += 4){
+		sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(as_doubles(a + i)), _mm256_loadu_pd(as_doubles(b + i))));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, sum);
+	acc += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	return i;
+}
+
+//	y is nullptr for scale: result = a * x.
+static size_t axpy_doubles_sse2(bc_inplace_value_t result[], double a, const bc_inplace_value_t x[], const bc_inplace_value_t y[], size_t count){
+	const auto a2 = _mm_set1_pd(a);
+	size_t i = 0;
+	for( ; i + 2 <= count ; i += 2){
+		const auto ax = _mm_mul_pd(a2, _mm_loadu_pd(as_doubles(x + i)));
+		_mm_storeu_pd(as_doubles(result + i), y ? _mm_add_pd(ax, _mm_loadu_pd(as_doubles(y + i))) : ax);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t axpy_doubles_avx2(bc_inplace_value_t result[], double a, const bc_inplace_value_t x[], const bc_inplace_value_t y[], size_t count){
+	const auto a2 = _mm256_set1_pd(a);
+	size_t i = 0;
+	for( ; i + 4 <= count ; i += 4){
+		const auto ax = _mm256_mul_pd(a2, _mm256_loadu_pd(as_doubles(x + i)));
+		_mm256_storeu_pd(as_doubles(result + i), y ? _mm256_add_pd(ax, _mm256_loadu_pd(as_doubles(y + i))) : ax);
+	}
+	return i;
+}
+
+#endif
+
+
+int64_t sum_ints(const bc_inplace_value_t values[], size_t count){
+	int64_t acc = 0;
+#if NUMERIC_KERNEL_X86
+	const auto done = has_avx2() ? sum_ints_avx2(values, count, acc) : sum_ints_sse2(values, count, acc);
+#else
+	const size_t done = 0;
+#endif
+	for(size_t i = done ; i < count ; i++){
+		acc += values[i]._int64;
+	}
+	return acc;
+}
+
+double sum_doubles(const bc_inplace_value_t values[], size_t count){
+	double acc = 0.0;
+#if NUMERIC_KERNEL_X86
+	const auto done = has_avx2() ? sum_doubles_avx2(values, count, acc) : sum_doubles_sse2(values, count, acc);
+#else
+	const size_t done = 0;
+#endif
+	for(size_t i = done ; i < count ; i++){
+		acc += values[i]._double;
+	}
+	return acc;
+}
+
+static int64_t min_max_ints(const bc_inplace_value_t values[], size_t count, bool is_max){
+	QUARK_ASSERT(count >= 1);
+
+	int64_t acc = values[0]._int64;
+#if NUMERIC_KERNEL_X86
+	const auto done = has_avx2() ? min_max_ints_avx2(values, count, is_max, acc) : 0;
+#else
+	const size_t done = 0;
+#endif
+	for(size_t i = done ; i < count ; i++){
+		acc = is_max ? std::max(acc, values[i]._int64) : std::min(acc, values[i]._int64);
+	}
+	return acc;
+}
+
+int64_t min_ints(const bc_inplace_value_t values[], size_t count){
+	return min_max_ints(values, count, false);
+}
+int64_t max_ints(const bc_inplace_value_t values[], size_t count){
+	return min_max_ints(values, count, true);
+}
+
+static double min_max_doubles(const bc_inplace_value_t values[], size_t count, bool is_max){
+	QUARK_ASSERT(count >= 1);
+
+	double acc = values[0]._double;
+#if NUMERIC_KERNEL_X86
+	const auto done = has_avx2() ? min_max_doubles_avx2(values, count, is_max, acc) : min_max_doubles_sse2(values, count, is_max, acc);
+#else
+	const size_t done = 0;
+#endif
+	for(size_t i = done ; i < count ; i++){
+		acc = is_max ? std::max(acc, values[i]._double) : std::min(acc, values[i]._double);
+	}
+	return acc;
+}
+
+double min_doubles(const bc_inplace_value_t values[], size_t count){
+	return min_max_doubles(values, count, false);
+}
+double max_doubles(const bc_inplace_value_t values[], size_t count){
+	return min_max_doubles(values, count, true);
+}
+
+int64_t dot_ints(const bc_inplace_value_t a[], const bc_inplace_value_t b[], size_t count){
+	int64_t acc = 0;
+	for(size_t i = 0 ; i < count ; i++){
+		acc += a[i]._int64 * b[i]._int64;
+	}
+	return acc;
+}
+
+double dot_doubles(const bc_inplace_value_t a[], const bc_inplace_value_t b[], size_t count){
+	double acc = 0.0;
+#if NUMERIC_KERNEL_X86
+	const auto done = has_avx2() ? dot_doubles_avx2(a, b, count, acc) : dot_doubles_sse2(a, b, count, acc);
+#else
+	const size_t done = 0;
+#endif
+	for(size_t i = done ; i < count ; i++){
+		acc += a[i]._double * b[i]._double;
+	}
+	return acc;
+}
+
+void scale_ints(bc_inplace_value_t result[], int64_t k, const bc_inplace_value_t x[], size_t count){
+	for(size_t i = 0 ; i < count ; i++){
+		result[i]._int64 = k * x[i]._int64;
+	}
+}
+
+void scale_doubles(bc_inplace_value_t result[], double k, const bc_inplace_value_t x[], size_t count){
+#if NUMERIC_KERNEL_X86
+	const auto done = has_avx2() ? axpy_doubles_avx2(result, k, x, nullptr, count) : axpy_doubles_sse2(result, k, x, nullptr, count);
+#else
+	const size_t done = 0;
+#endif
+	for(size_t i = done ; i < count ; i++){
+		result[i]._double = k * x[i]._double;
+	}
+}
+
+void axpy_ints(bc_inplace_value_t result[], int64_t a, const bc_inplace_value_t x[], const bc_inplace_value_t y[], size_t count){
+	for(size_t i = 0 ; i < count ; i++){
+		result[i]._int64 = a * x[i]._int64 + y[i]._int64;
+	}
+}
+
+void axpy_doubles(bc_inplace_value_t result[], double a, const bc_inplace_value_t x[], const bc_inplace_value_t y[], size_t count){
+#if NUMERIC_KERNEL_X86
+	const auto done = has_avx2() ? axpy_doubles_avx2(result, a, x, y, count) : axpy_doubles_sse2(result, a, x, y, count);
+#else
+	const size_t done = 0;
+#endif
+	for(size_t i = done ; i < count ; i++){
+		result[i]._double = a * x[i]._double + y[i]._double;
+	}
+}
+
+
+//	f(x) = (x + 3) * x - 1, over more than one block and an odd tail.
+QUARK_UNIT_TEST("run_numeric_kernel()", "double", "", ""){
+	typedef numeric_kernel_t::opcode op;
+	const auto three = bc_inplace_value_t{ ._double = 3.0 };
+	const auto one = bc_inplace_value_t{ ._double = 1.0 };
+	const auto kernel = numeric_kernel_t{
+		base_type::k_double,
+		6,
+		{ { 1, three }, { 3, one } },
+		{ { op::k_add, 2, 0, 1 }, { op::k_multiply, 4, 2, 0 }, { op::k_subtract, 5, 4, 3 } },
+		5
+	};
+
+	const size_t count = k_kernel_block_size * 2 + 7;
+	std::vector<bc_inplace_value_t> values(count);
+	for(size_t i = 0 ; i < count ; i++){
+		values[i]._double = static_cast<double>(i) * 0.5;
+	}
+	run_numeric_kernel(kernel, &values[0], &values[0], count);
+	for(size_t i = 0 ; i < count ; i++){
+		const auto x = static_cast<double>(i) * 0.5;
+		QUARK_UT_VERIFY(values[i]._double == (x + 3.0) * x - 1.0);
+	}
+}
+
+//	f(x) = (x - 5) % 7 + x / 2
+QUARK_UNIT_TEST("run_numeric_kernel()", "int", "", ""){
+	typedef numeric_kernel_t::opcode op;
+	const auto kernel = numeric_kernel_t{
+		base_type::k_int,
+		8,
+		{ { 1, bc_inplace_value_t{ ._int64 = 5 } }, { 3, bc_inplace_value_t{ ._int64 = 7 } }, { 5, bc_inplace_value_t{ ._int64 = 2 } } },
+		{ { op::k_subtract, 2, 0, 1 }, { op::k_remainder, 4, 2, 3 }, { op::k_divide, 6, 0, 5 }, { op::k_add, 7, 4, 6 } },
+		7
+	};
+
+	const size_t count = k_kernel_block_size + 3;
+	std::vector<bc_inplace_value_t> input(count);
+	std::vector<bc_inplace_value_t> output(count);
+	for(size_t i = 0 ; i < count ; i++){
+		input[i]._int64 = static_cast<int64_t>(i) - 100;
+	}
+	run_numeric_kernel(kernel, &input[0], &output[0], count);
+	for(size_t i = 0 ; i < count ; i++){
+		const auto x = static_cast<int64_t>(i) - 100;
+		QUARK_UT_VERIFY(output[i]._int64 == (x - 5) % 7 + x / 2);
+	}
+}
+
+QUARK_UNIT_TEST("run_numeric_kernel()", "int", "divide by zero", "throws"){
+	typedef numeric_kernel_t::opcode op;
+	const auto kernel = numeric_kernel_t{
+		base_type::k_int,
+		3,
+		{ { 1, bc_inplace_value_t{ ._int64 = 10 } } },
+		{ { op::k_divide, 2, 1, 0 } },
+		2
+	};
+
+	std::vector<bc_inplace_value_t> values(3);
+	values[0]._int64 = 1;
+	values[1]._int64 = 0;
+	values[2]._int64 = 2;
+	try{
+		run_numeric_kernel(kernel, &values[0], &values[0], values.size());
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()) == "EEE_DIVIDE_BY_ZERO");
+	}
+}
+
+
+//	Odd counts so both the vector loops and the scalar tails are used.
+QUARK_UNIT_TEST("sum_ints()", "min_ints()", "max_ints()", "dot_ints()"){
+	std::vector<bc_inplace_value_t> a(37);
+	std::vector<bc_inplace_value_t> b(37);
+	for(int i = 0 ; i < 37 ; i++){
+		a[i]._int64 = (i * 7) % 19 - 9;
+		b[i]._int64 = i;
+	}
+	QUARK_UT_VERIFY(sum_ints(&a[0], 37) == -3);
+	QUARK_UT_VERIFY(min_ints(&a[0], 37) == -9);
+	QUARK_UT_VERIFY(max_ints(&a[0], 37) == 9);
+	QUARK_UT_VERIFY(min_ints(&a[1], 1) == -2);
+	QUARK_UT_VERIFY(dot_ints(&a[0], &b[0], 37) == 117);
+}
+
+QUARK_UNIT_TEST("sum_doubles()", "min_doubles()", "max_doubles()", "dot_doubles()"){
+	std::vector<bc_inplace_value_t> a(11);
+	for(int i = 0 ; i < 11 ; i++){
+		a[i]._double = i == 6 ? -3.5 : i * 0.5;
+	}
+	QUARK_UT_VERIFY(sum_doubles(&a[0], 11) == 21.0);
+	QUARK_UT_VERIFY(min_doubles(&a[0], 11) == -3.5);
+	QUARK_UT_VERIFY(max_doubles(&a[0], 11) == 5.0);
+	QUARK_UT_VERIFY(dot_doubles(&a[0], &a[0], 11) == 99.5);
+}
+
+QUARK_UNIT_TEST("scale_doubles()", "axpy_doubles()", "", ""){
+	std::vector<bc_inplace_value_t> x(7);
+	std::vector<bc_inplace_value_t> y(7);
+	for(int i = 0 ; i < 7 ; i++){
+		x[i]._double = i;
+		y[i]._double = 100.0;
+	}
+	std::vector<bc_inplace_value_t> result(7);
+	scale_doubles(&result[0], 1.5, &x[0], 7);
+	QUARK_UT_VERIFY(result[0]._double == 0.0 && result[5]._double == 7.5 && result[6]._double == 9.0);
+	axpy_doubles(&result[0], 2.0, &x[0], &y[0], 7);
+	QUARK_UT_VERIFY(result[0]._double == 100.0 && result[5]._double == 110.0 && result[6]._double == 112.0);
+}
+
+
+}	//	floyd
@@ -0,0 +1,102 @@
+//
+//  numeric_kernel.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-02-24.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef numeric_kernel_h
+#define numeric_kernel_h
+
+/*
+	A numeric kernel is a Floyd function like
+
+		func double f(double x){
+			let a = x * 0.5
+			return a * a - x / 4.0
+		}
+
+	-- one int or double argument, same return type and a body of straight-line arithmetic -- translated to run
+	over a whole array of numbers at once. Each instruction is executed for a block of elements before going to the
+	next instruction, using SSE2 / AVX2 when the CPU has them, instead of running the interpreter once per element.
+*/
+
+#include "bytecode_interpreter.h"
+
+#include <memory>
+
+namespace floyd {
+
+
+struct numeric_kernel_t {
+	enum class opcode {
+		k_copy,
+		k_add,
+		k_subtract,
+		k_multiply,
+		k_divide,
+		k_remainder
+	};
+
+	//	a = b op c. Same registers as the function's bytecode.
+	struct instruction_t {
+		opcode _opcode;
+		int16_t _a;
+		int16_t _b;
+		int16_t _c;
+	};
+
+
+	//////////////////////////////////////		STATE
+
+	//	base_type::k_int or base_type::k_double. Argument, return value and all registers have this type.
+	base_type _type;
+
+	int _register_count;
+	std::vector<std::pair<int, bc_inplace_value_t>> _constants;
+	std::vector<instruction_t> _instructions;
+	int _return_register;
+};
+
+
+//	Returns nullptr if the function isn't straight-line int or double arithmetic.
+std::shared_ptr<const numeric_kernel_t> make_numeric_kernel(const bc_function_definition_t& function_def);
+
+//	output[i] = f(input[i]), for count elements. input and output may be the same array.
+//	Throws EEE_DIVIDE_BY_ZERO just like the interpreter.
+void run_numeric_kernel(const numeric_kernel_t& kernel, const bc_inplace_value_t input[], bc_inplace_value_t output[], size_t count);
+
+
+//////////////////////////////////////		VECTOR PRIMITIVES
+
+/*
+	Loops over a contiguous run of [int] or [double] elements, like one leaf chunk of an
+	immer::flex_vector<bc_inplace_value_t>. The double versions use SSE2 / AVX2. They add in a different order than a
+	left-to-right loop, so sums of doubles can differ in the last bits.
+*/
+
+int64_t sum_ints(const bc_inplace_value_t values[], size_t count);
+double sum_doubles(const bc_inplace_value_t values[], size_t count);
+
+//	count must be at least 1.
+int64_t min_ints(const bc_inplace_value_t values[], size_t count);
+int64_t max_ints(const bc_inplace_value_t values[], size_t count);
+double min_doubles(const bc_inplace_value_t values[], size_t count);
+double max_doubles(const bc_inplace_value_t values[], size_t count);
+
+int64_t dot_ints(const bc_inplace_value_t a[], const bc_inplace_value_t b[], size_t count);
+double dot_doubles(const bc_inplace_value_t a[], const bc_inplace_value_t b[], size_t count);
+
+//	result[i] = k * x[i]
+void scale_ints(bc_inplace_value_t result[], int64_t k, const bc_inplace_value_t x[], size_t count);
+void scale_doubles(bc_inplace_value_t result[], double k, const bc_inplace_value_t x[], size_t count);
+
+//	result[i] = a * x[i] + y[i]
+void axpy_ints(bc_inplace_value_t result[], int64_t a, const bc_inplace_value_t x[], const bc_inplace_value_t y[], size_t count);
+void axpy_doubles(bc_inplace_value_t result[], double a, const bc_inplace_value_t x[], const bc_inplace_value_t y[], size_t count);
+
+
+}	//	floyd
+
+#endif /* numeric_kernel_h */
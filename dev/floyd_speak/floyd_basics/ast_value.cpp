@@ -289,7 +289,7 @@ int compare_vector_true_deep(const std::vector<value_t>& left, const std::vector
 //	QUARK_ASSERT(right.check_invariant());
 //	QUARK_ASSERT(left._element_type == right._element_type);
 
-	const auto& shared_count = std::min(left.size(), right.size());
+	const auto shared_count = std::min(left.size(), right.size());
 	for(int i = 0 ; i < shared_count ; i++){
 		const auto element_result = value_t::compare_value_true_deep(left[i], right[i]);
 		if(element_result != 0){
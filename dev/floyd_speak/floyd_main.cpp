@@ -209,12 +209,13 @@ floyd help					- Show built in help for command line tool
 floyd runtests				- Runs Floyds internal unit tests
 floyd benchmark 			- Runs Floyd built in suite of benchmark tests and prints the results.
 floyd run -t mygame.floyd	- the -t turns on tracing, which shows Floyd compilation steps and internal states
+floyd run -m fib,lookup:500 mygame.floyd	- memoize the pure functions fib() and lookup(), max 500 cached results for lookup()
 )";
 }
 
 //	Runs one of the commands, args depends on which command.
 int run_command(const std::vector<std::string>& args){
-	const auto command_line_args = parse_command_line_args_subcommands(args, "t");
+	const auto command_line_args = parse_command_line_args_subcommands(args, "tm:");
 	const auto path_parts = SplitPath(command_line_args.command);
 	QUARK_ASSERT(path_parts.fName == "floyd" || path_parts.fName == "floydut");
 	trace_on = command_line_args.flags.find("t") != command_line_args.flags.end() ? true : false;
@@ -258,6 +259,15 @@ int run_command(const std::vector<std::string>& args){
 
 			auto program = floyd::compile_to_bytecode(source, source_path);
 
+			//	Memoize tweakers from the command line add to those in the container-def.
+			const auto memoize_flag = command_line_args.flags.find("m");
+			if(memoize_flag != command_line_args.flags.end()){
+				const auto tweaks = parse_memoize_tweaks_arg(memoize_flag->second);
+				for(const auto& e: tweaks){
+					program._container_def._memoize_tweaks[e.first] = e.second;
+				}
+			}
+
 			std::vector<floyd::value_t> args3;
 			for(const auto& e: args2){
 				args3.push_back(floyd::value_t::make_string(e));
@@ -17,6 +17,7 @@
 #include "text_parser.h"
 #include "host_functions.h"
 #include "file_handling.h"
+#include "task_pool.h"
 
 #include <string>
 #include <vector>
@@ -462,6 +463,159 @@ QUARK_UNIT_TEST("call_function()", "minimal program 2", "", ""){
 	ut_verify_values(QUARK_POS, result, value_t::make_string("123456"));
 }
 
+QUARK_UNIT_TEST("call_function()", "interpreters sharing one program image", "", "Globals are per interpreter"){
+	auto ast = compile_to_bytecode(R"(
+
+		mutable int count = 0
+		func int main(string args) impure {
+			count = count + 1
+			return count
+		}
+
+	)",
+	"");
+	const auto imm = make_interpreter_imm(ast);
+	interpreter_t a(imm, nullptr);
+	interpreter_t b(imm, nullptr);
+	QUARK_UT_VERIFY(a._imm.get() == b._imm.get());
+
+	const auto f = find_global_symbol(a, "main");
+	call_function(a, f, std::vector<value_t>{ value_t::make_string("") });
+	const auto result_a = call_function(a, f, std::vector<value_t>{ value_t::make_string("") });
+	const auto result_b = call_function(b, f, std::vector<value_t>{ value_t::make_string("") });
+	ut_verify_values(QUARK_POS, result_a, value_t::make_int(2));
+	ut_verify_values(QUARK_POS, result_b, value_t::make_int(1));
+}
+
+
+//////////////////////////////////////////		MEMOIZE TWEAKER
+
+
+QUARK_UNIT_TEST("call_function()", "memoize tweaker", "", "Repeated calls hit the cache"){
+	auto ast = compile_to_bytecode(R"(
+
+		func int f(string s, int n){
+			return size(s) + n
+		}
+		func int g(int n){
+			return n * 2
+		}
+		func int main(string args){
+			mutable sum = 0
+			for(i in 0 ..< 100){
+				sum = sum + f("abc", i % 5)
+			}
+			let v = map([ 1, 2, 1, 2 ], g)
+			return sum + v[0] + v[1] + v[2] + v[3]
+		}
+
+	)",
+	"");
+	ast._container_def._memoize_tweaks = { { "f", 10 }, { "g", 10 } };
+	const auto imm = make_interpreter_imm(ast);
+	interpreter_t vm(imm, nullptr);
+	const auto f = find_global_symbol(vm, "main");
+	const auto result = call_function(vm, f, std::vector<value_t>{ value_t::make_string("") });
+	ut_verify_values(QUARK_POS, result, value_t::make_int(512));
+
+	const auto& f_cache = *imm->_memo_caches[find_global_symbol2(vm, "f")->_value.get_function_value()];
+	QUARK_UT_VERIFY(f_cache._miss_count == 5);
+	QUARK_UT_VERIFY(f_cache._hit_count == 95);
+	QUARK_UT_VERIFY(f_cache.get_entry_count() == 5);
+
+	const auto& g_cache = *imm->_memo_caches[find_global_symbol2(vm, "g")->_value.get_function_value()];
+	QUARK_UT_VERIFY(g_cache._miss_count == 2);
+	QUARK_UT_VERIFY(g_cache._hit_count == 2);
+}
+
+QUARK_UNIT_TEST("call_function()", "memoize tweaker", "", "Least recently used result is evicted"){
+	auto ast = compile_to_bytecode(R"(
+
+		func int f(int n){
+			return n + 1
+		}
+		func int main(string args){
+			mutable sum = 0
+			for(i in 0 ..< 100){
+				sum = sum + f(i % 5)
+			}
+			return sum
+		}
+
+	)",
+	"");
+	ast._container_def._memoize_tweaks = { { "f", 3 } };
+	const auto imm = make_interpreter_imm(ast);
+	interpreter_t vm(imm, nullptr);
+	const auto f = find_global_symbol(vm, "main");
+	const auto result = call_function(vm, f, std::vector<value_t>{ value_t::make_string("") });
+	ut_verify_values(QUARK_POS, result, value_t::make_int(300));
+
+	const auto& cache = *imm->_memo_caches[find_global_symbol2(vm, "f")->_value.get_function_value()];
+	QUARK_UT_VERIFY(cache._miss_count == 100);
+	QUARK_UT_VERIFY(cache.get_entry_count() == 3);
+}
+
+QUARK_UNIT_TEST("call_function()", "memoize tweaker", "function that prints", "Calls that printed are not cached"){
+	auto ast = compile_to_bytecode(R"(
+
+		func int g(int n){
+			if(n == 1){
+				print("g " + to_string(n))
+			}
+			return n * 2
+		}
+		func int f(int n){
+			return g(n) + 1
+		}
+		func int main(string args){
+			return f(1) + f(1) + f(2) + f(2)
+		}
+
+	)",
+	"");
+	ast._container_def._memoize_tweaks = { { "f", 10 } };
+	const auto imm = make_interpreter_imm(ast);
+	interpreter_t vm(imm, nullptr);
+	const auto f = find_global_symbol(vm, "main");
+	const auto result = call_function(vm, f, std::vector<value_t>{ value_t::make_string("") });
+	ut_verify_values(QUARK_POS, result, value_t::make_int(16));
+	QUARK_UT_VERIFY((vm._print_output == std::vector<std::string>{ "g 1", "g 1" }));
+
+	const auto& cache = *imm->_memo_caches[find_global_symbol2(vm, "f")->_value.get_function_value()];
+	QUARK_UT_VERIFY(cache._miss_count == 3);
+	QUARK_UT_VERIFY(cache._hit_count == 1);
+	QUARK_UT_VERIFY(cache.get_entry_count() == 1);
+}
+
+QUARK_UNIT_TEST("call_function()", "memoize tweaker", "impure function", "Exception"){
+	auto ast = compile_to_bytecode(R"(
+
+		func int f(int n) impure {
+			return n + 1
+		}
+
+	)",
+	"");
+	ast._container_def._memoize_tweaks = { { "f", 3 } };
+	try {
+		make_interpreter_imm(ast);
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		ut_verify(QUARK_POS, e.what(), "Memoize tweaker: \"f\" is not pure.");
+	}
+}
+
+QUARK_UNIT_TEST("", "bc_hash_value()", "equal values", "same hash"){
+	const auto struct_type = typeid_t::make_struct2({ member_t(typeid_t::make_string(), "a"), member_t(typeid_t::make_double(), "b") });
+	const auto a = bc_value_t::make_struct_value(struct_type, { bc_value_t::make_string("hello"), bc_value_t::make_double(0.0) });
+	const auto b = bc_value_t::make_struct_value(struct_type, { bc_value_t::make_string("hello"), bc_value_t::make_double(-0.0) });
+	const auto c = bc_value_t::make_struct_value(struct_type, { bc_value_t::make_string("hellO"), bc_value_t::make_double(0.0) });
+	QUARK_UT_VERIFY(bc_hash_value(a, struct_type) == bc_hash_value(b, struct_type));
+	QUARK_UT_VERIFY(bc_hash_value(a, struct_type) != bc_hash_value(c, struct_type));
+}
+
 
 //////////////////////////////////////////		TEST CONSTRUCTOR FOR ALL TYPES
 
@@ -1427,6 +1581,188 @@ QUARK_UNIT_TEST("vector", "replace()", "combo", ""){
 	)");
 }
 
+//	Strings up to 7 bytes are stored inside the value, longer ones in an external value. Mix them.
+QUARK_UNIT_TEST("string", "small strings", "7 and 8 characters", ""){
+	run_closed(R"(
+
+		let a = "abcdefg"
+		let b = a + "h"
+		assert(size(a) == 7)
+		assert(size(b) == 8)
+		assert(push_back(a, 104) == b)
+		assert(subset(b, 0, 7) == a)
+		assert(a < b)
+		assert(b[7] == 104)
+
+		let d = { "abcdefg": 1, "abcdefgh": 2 }
+		assert(d["abc" + "defg"] == 1)
+		assert(d[push_back(a, 104)] == 2)
+
+		assert([ a, b ] == [ "abcdefg", "abcdefgh" ])
+		assert(to_string(a) == "abcdefg")
+
+	)");
+}
+
+//	Long strings built piece by piece are stored as ropes.
+QUARK_UNIT_TEST("string", "rope strings", "concat, push_back(), subset(), replace()", ""){
+	run_closed(R"(
+
+		mutable s = ""
+		for(i in 0 ..< 2000){
+			s = s + to_string(i % 10)
+		}
+		assert(size(s) == 2000)
+		assert(s[0] == 48)
+		assert(s[1999] == 57)
+		assert(subset(s, 10, 15) == "01234")
+		assert(size(subset(s, 100, 1900)) == 1800)
+		assert(subset(subset(s, 100, 1900), 0, 3) == "012")
+
+		mutable t = s
+		for(i in 0 ..< 100){
+			t = push_back(t, 65)
+		}
+		assert(size(t) == 2100)
+		assert(subset(t, 1998, 2002) == "89AA")
+		assert(subset(t, 0, 2000) == s)
+
+		let r = replace(s, 1, 1999, "-")
+		assert(r == "0-9")
+		let r2 = replace(s, 5, 6, "xyz")
+		assert(size(r2) == 2002)
+		assert(subset(r2, 3, 10) == "34xyz67")
+		assert(find_substring(r2, "xyz", 0) == 5)
+
+		assert(s + "" == s)
+		assert(s < t)
+		assert(starts_with(t, s))
+
+	)");
+}
+
+//	subset(), replace() and + on vectors share nodes with their inputs. Big enough to need several tree levels.
+QUARK_UNIT_TEST("vector", "slicing", "subset(), replace(), + on big vectors", ""){
+	run_closed(R"(
+
+		mutable a = [ 0 ]
+		mutable b = [ "0" ]
+		for(i in 1 ..< 5000){
+			a = push_back(a, i)
+			b = push_back(b, to_string(i))
+		}
+
+		let a2 = subset(a, 1000, 4000)
+		assert(size(a2) == 3000)
+		assert(a2[0] == 1000)
+		assert(a2[2999] == 3999)
+		assert(size(subset(a, 4000, 1000)) == 0)
+		assert(subset(subset(a, 100, 4900), 10, 13) == [ 110, 111, 112 ])
+
+		let b2 = subset(b, 4998, 5000)
+		assert(b2 == [ "4998", "4999" ])
+
+		let a3 = replace(a, 2, 4998, [ -1 ])
+		assert(a3 == [ 0, 1, -1, 4998, 4999 ])
+		let b3 = replace(b, 1, 4999, b2)
+		assert(b3 == [ "0", "4998", "4999", "4999" ])
+
+		let a4 = a2 + a2 + a
+		assert(size(a4) == 11000)
+		assert(a4[2999] == 3999)
+		assert(a4[3000] == 1000)
+		assert(a4[6000] == 0)
+		assert(a4[10999] == 4999)
+
+		mutable total = 0
+		for(i in 0 ..< size(a4)){
+			total = total + a4[i]
+		}
+		assert(total == 2 * 7498500 + 12497500)
+
+	)");
+}
+
+//	[pixel_t] only has inplace members so it's stored as struct columns. Run all vector operations on it.
+QUARK_UNIT_TEST("vector", "struct columns", "[pixel_t]", ""){
+	run_closed(R"(
+
+		struct pixel_t { int red; double green; bool on }
+
+		mutable v = [ pixel_t(0, 0.5, true) ]
+		for(i in 1 ..< 1000){
+			v = push_back(v, pixel_t(i, 0.5, i % 2 == 0))
+		}
+		assert(size(v) == 1000)
+		assert(v[0] == pixel_t(0, 0.5, true))
+		assert(v[999].red == 999)
+		assert(v[999].green == 0.5)
+		assert(v[999].on == false)
+
+		mutable total = 0
+		for(i in 0 ..< size(v)){
+			total = total + v[i].red
+		}
+		assert(total == 499500)
+
+		let a = subset(v, 1, 3)
+		assert(a == [ pixel_t(1, 0.5, false), pixel_t(2, 0.5, true) ])
+		assert(size(subset(v, 3, 1)) == 0)
+		assert(replace(a, 1, 2, [ pixel_t(9, 9.0, true) ]) == [ pixel_t(1, 0.5, false), pixel_t(9, 9.0, true) ])
+		assert(update(a, 0, pixel_t(7, 7.0, true)) == [ pixel_t(7, 7.0, true), pixel_t(2, 0.5, true) ])
+		assert(size(v + a) == 1002)
+		assert((a + v)[2] == v[0])
+		assert(find(v, pixel_t(5, 0.5, false)) == 5)
+		assert(find(v, pixel_t(5, 0.5, true)) == -1)
+		assert(a < subset(v, 2, 4))
+		assert(sort([ pixel_t(3, 0.0, true), pixel_t(1, 0.0, true) ]) == [ pixel_t(1, 0.0, true), pixel_t(3, 0.0, true) ])
+
+		func bool f(pixel_t p){ return p.red < 3 }
+		assert(filter(v, f) == subset(v, 0, 3))
+
+		let d = { "a": a }
+		assert(d["a"][1].red == 2)
+
+		struct image_t { [pixel_t] pixels }
+		let image = image_t(a)
+		assert(jsonvalue_to_value(value_to_jsonvalue(image), image_t) == image)
+		assert(to_string(subset(v, 0, 1)) == "[{red=0, green=0.5, on=true}]")
+
+	)");
+}
+
+//	The prelude's vector2_t only has inplace members and is stored as a flat block. line_t holds two of them but is
+//	stored as usual.
+QUARK_UNIT_TEST("struct", "inplace members", "vector2_t", ""){
+	run_closed(R"(
+
+		struct flag_t { bool on; int count }
+		struct line_t { vector2_t a; vector2_t b; string name }
+
+		let a = vector2_t(1.0, 2.0)
+		assert(a.x == 1.0)
+		assert(a.y == 2.0)
+		assert(a == vector2_t(1.0, 2.0))
+		assert(a < vector2_t(1.0, 3.0))
+		assert(update(a, "y", 5.0) == vector2_t(1.0, 5.0))
+		assert(a.y == 2.0)
+
+		let f = flag_t(true, 3)
+		assert(f.on && f.count == 3)
+		assert(update(f, "on", false) == flag_t(false, 3))
+
+		let line = line_t(a, vector2_t(3.0, 4.0), "l")
+		assert(line.b.y == 4.0)
+		assert(update(line, "b.x", 9.0).b == vector2_t(9.0, 4.0))
+		assert(line.b.x == 3.0)
+
+		assert(to_string(a) == "{x=1.0, y=2.0}")
+		assert(jsonvalue_to_value(value_to_jsonvalue(line), line_t) == line)
+		assert({ "p": a }["p"].y == 2.0)
+
+	)");
+}
+
 
 
 
@@ -3377,6 +3713,126 @@ QUARK_UNIT_TEST("", "map()", "[int] map(int f(string))", ""){
 	)");
 }
 
+//	Big enough to run f() on the worker threads. The pool gets four workers, also on single-core machines.
+QUARK_UNIT_TEST("", "map()", "[int] map(int f(int)) big vector", ""){
+	const shared_task_pool_override_t pool(4);
+	run_closed(R"(
+
+		let offset = 1000
+
+		func int g(int v){
+			return v * 2
+		}
+		func int f(int v){
+			return offset + g(v)
+		}
+
+		mutable a = [ 0 ]
+		for(i in 1 ..< 10000){
+			a = push_back(a, i)
+		}
+
+		let result = map(a, f)
+		assert(size(result) == 10000)
+		assert(result[0] == 1000)
+		assert(result[1] == 1002)
+		assert(result[9999] == 20998)
+		assert(result == map(a, f))
+
+	)");
+}
+
+QUARK_UNIT_TEST("", "map()", "[string] map(string f(int)) big vector", "print() order is kept"){
+	const shared_task_pool_override_t pool(4);
+	ut_verify_printout(
+		QUARK_POS,
+		R"(
+
+			func string f(int v){
+				if(v % 2500 == 0){
+					print(v)
+				}
+				return to_string(v)
+			}
+
+			mutable a = [ 0 ]
+			for(i in 1 ..< 10000){
+				a = push_back(a, i)
+			}
+
+			let result = map(a, f)
+			assert(result[9999] == "9999")
+
+		)",
+		{ "0", "2500", "5000", "7500" }
+	);
+}
+
+
+//	f() is only arithmetic so map() runs it as a numeric kernel. Compare with calling f() normally.
+QUARK_UNIT_TEST("", "map()", "[int] map(int f(int)) arithmetic only, big vector", ""){
+	const shared_task_pool_override_t pool(4);
+	run_closed(R"(
+
+		func int f(int v){
+			return (v * 3 - 7) % 5 + v / 2
+		}
+
+		mutable a = [ -2 ]
+		for(i in 1 ..< 40000){
+			a = push_back(a, i - 2)
+		}
+
+		let result = map(a, f)
+		assert(size(result) == 40000)
+		for(i in 0 ..< 40000){
+			assert(result[i] == f(a[i]))
+		}
+		assert(map([ 4 ], f) == [ 2 ])
+
+	)");
+}
+
+QUARK_UNIT_TEST("", "map()", "[double] map(double f(double)) arithmetic only", ""){
+	run_closed(R"(
+
+		func double f(double x){
+			let a = x * 0.5
+			let b = a + 1.0
+			return a * b - x / 4.0
+		}
+
+		mutable a = [ 0.0 ]
+		mutable x = 0.0
+		for(i in 1 ..< 1003){
+			x = x + 0.25
+			a = push_back(a, x)
+		}
+
+		let result = map(a, f)
+		for(i in 0 ..< 1003){
+			assert(result[i] == f(a[i]))
+		}
+		assert(map([ 2.0 ], f) == [ 1.5 ])
+
+	)");
+}
+
+QUARK_UNIT_TEST("", "map()", "[int] map(int f(int)) arithmetic only", "divide by zero"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			func int f(int v){
+				return 10 / v
+			}
+
+			let result = map([ 1, 0, 2 ], f)
+
+		)",
+		"EEE_DIVIDE_BY_ZERO"
+	);
+}
 
 //////////////////////////////////////////		HOST FUNCTION - map_string()
 
@@ -3444,825 +3900,1495 @@ QUARK_UNIT_TEST("", "reduce()", "string reduce([int], string, func int(string, i
 
 
 
-//////////////////////////////////////////		HOST FUNCTION - filter()
+//////////////////////////////////////////		FUSED map() / filter() / reduce() PIPELINES
 
 
 
-QUARK_UNIT_TEST("", "filter()", "int filter([int], int, func int(int, int))", ""){
+QUARK_UNIT_TEST("", "reduce(filter(map()))", "", "fused into one pass"){
 	run_closed(R"(
 
-		func bool f(int element){
-			return element % 3 == 0 ? true : false
+		func int square(int v){
+			return v * v
+		}
+		func bool is_odd(int v){
+			return v % 2 == 1
+		}
+		func int add(int acc, int v){
+			return acc + v
 		}
 
-		let result = filter([ 3, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13 ], f)
-
+		let result = reduce(filter(map([ 1, 2, 3, 4, 5 ], square), is_odd), 1000, add)
 		print(to_string(result))
-		assert(result == [ 3, 3, 6, 9, 12 ])
+		assert(result == 1035)
 
 	)");
 }
 
-QUARK_UNIT_TEST("", "filter()", "string filter([int], string, func int(string, int))", ""){
-	run_closed(	R"___(
+QUARK_UNIT_TEST("", "filter(map())", "", "result vector"){
+	run_closed(R"(
 
-		func bool f(string element){
-			return size(element) == 3 || size(element) == 5
+		func int triple(int v){
+			return v * 3
+		}
+		func bool is_even(int v){
+			return v % 2 == 0
 		}
 
-		let result = filter([ "one", "two", "three", "four", "five", "six", "seven" ], f)
+		let result = filter(map([ 1, 2, 3, 4 ], triple), is_even)
+		assert(result == [ 6, 12 ])
 
-		print(to_string(result))
-		assert(result == [ "one", "two", "three", "six", "seven" ])
+	)");
+}
 
-	)___");
+QUARK_UNIT_TEST("", "map(map())", "element type changes", ""){
+	run_closed(R"(
+
+		func int twice(int v){
+			return v * 2
+		}
+		func string f(int v){
+			return "<" + to_string(v) + ">"
+		}
+
+		let result = map(map([ 1, 2, 3 ], twice), f)
+		assert(result == [ "<2>", "<4>", "<6>" ])
+
+	)");
 }
 
+//	Big enough to run the map and filter stages on the worker threads.
+QUARK_UNIT_TEST("", "reduce(filter(map()))", "big vector", "order is kept"){
+	const shared_task_pool_override_t pool(4);
+	run_closed(R"(
 
+		mutable a = [ 0 ]
+		for(i in 1 ..< 10000){
+			a = push_back(a, i)
+		}
 
+		func int add_one(int v){
+			return v + 1
+		}
+		func bool is_even(int v){
+			return v % 2 == 0
+		}
+		func int add(int acc, int v){
+			return acc + v
+		}
+		func string first_digits(string acc, int v){
+			return size(acc) < 5 ? acc + to_string(v) : acc
+		}
 
+		assert(reduce(filter(map(a, add_one), is_even), 0, add) == 25005000)
+		assert(reduce(filter(map(a, add_one), is_even), "", first_digits) == "246810")
+		assert(size(filter(map(a, add_one), is_even)) == 5000)
 
-//////////////////////////////////////////		HOST FUNCTION - supermap()
+	)");
+}
 
 
 
-QUARK_UNIT_TEST("", "supermap()", "No dependencies", ""){
+
+//////////////////////////////////////////		HOST FUNCTION - fold_parallel()
+
+
+
+QUARK_UNIT_TEST("", "fold_parallel()", "int fold_parallel([int], int, func int(int), func int(int, int))", ""){
 	run_closed(R"(
 
-		func string f(string v, [string] inputs){
-			return "[" + v + "]"
+		func int square(int v){
+			return v * v
+		}
+		func int add(int a, int b){
+			return a + b
 		}
 
-		let result = supermap([ "one", "ring", "to" ], [ -1, -1, -1 ], f)
+		let result = fold_parallel([ 1, 2, 3, 4 ], 0, square, add)
 		print(to_string(result))
-		assert(result == [ "[one]", "[ring]", "[to]" ])
+		assert(result == 30)
 
 	)");
 }
 
-QUARK_UNIT_TEST("", "supermap()", "No dependencies", ""){
+QUARK_UNIT_TEST("", "fold_parallel()", "string fold_parallel([int], string, func string(int), func string(string, string))", "order is kept"){
 	run_closed(R"(
 
-		func string f(string v, [string] inputs){
-			return "[" + v + "]"
+		func string f(int v){
+			return to_string(v)
+		}
+		func string concat(string a, string b){
+			return a + b
 		}
 
-		let result = supermap([ "one", "ring", "to" ], [ 1, 2, -1 ], f)
+		let result = fold_parallel([ 1, 2, 3, 4 ], "", f, concat)
 		print(to_string(result))
-		assert(result == [ "[one]", "[ring]", "[to]" ])
+		assert(result == "1234")
 
 	)");
 }
 
-
-
-
-
-QUARK_UNIT_TEST("", "supermap()", "complex", ""){
+QUARK_UNIT_TEST("", "fold_parallel()", "[] input", "identity"){
 	run_closed(R"(
 
-		func string f2(string acc, string element){
-			if(size(acc) == 0){
-				return element
-			}
-			else{
-				return acc + ", " + element
-			}
+		func double f(int v){
+			return 1.5
 		}
-
-		func string f(string v, [string] inputs){
-			let s = reduce(inputs, "", f2)
-			return v + "[" + s + "]"
+		func double add(double a, double b){
+			return a + b
 		}
 
-		let result = supermap([ "D", "B", "A", "C", "E", "F" ], [ 4, 2, -1, 4, 2, 4 ], f)
-		print(to_string(result))
-		assert(result == [ "D[]", "B[]", "A[B[], E[D[], C[], F[]]]", "C[]", "E[D[], C[], F[]]", "F[]" ])
+		assert(fold_parallel([ 1 ], 0.0, f, add) == 1.5)
+		assert(fold_parallel(subset([ 1 ], 1, 1), 0.0, f, add) == 0.0)
 
 	)");
 }
 
+QUARK_UNIT_TEST("", "fold_parallel()", "program defines its own fold_parallel()", "shadows host function"){
+	run_closed(R"(
 
+		func int fold_parallel([int] a, int init){
+			return init + size(a)
+		}
+		assert(fold_parallel([ 1, 2, 3 ], 10) == 13)
 
+	)");
+}
 
-
-//////////////////////////////////////////		HOST FUNCTION - read_text_file()
-
-/*
-QUARK_UNIT_TEST("", "read_text_file()", "", ""){
+//	Big enough to run on the worker threads. The pool gets four workers, also on single-core machines.
+QUARK_UNIT_TEST("", "fold_parallel()", "int, double and string accumulators, big vector", ""){
+	const shared_task_pool_override_t pool(4);
 	run_closed(R"(
 
-		path = get_env_path();
-		a = read_text_file(path + "/Desktop/test1.json");
-		print(a);
+		mutable a = [ 0 ]
+		for(i in 1 ..< 10000){
+			a = push_back(a, i)
+		}
+
+		func int triple(int v){
+			return v * 3
+		}
+		func int add(int a, int b){
+			return a + b
+		}
+		assert(fold_parallel(a, 0, triple, add) == 149985000)
+
+		func double half(int v){
+			return v % 2 == 0 ? 0.25 : 0.75
+		}
+		func double add_double(double a, double b){
+			return a + b
+		}
+		assert(fold_parallel(a, 0.0, half, add_double) == 5000.0)
+
+		func string last_digit(int v){
+			return to_string(v % 10)
+		}
+		func string concat(string a, string b){
+			return a + b
+		}
+		let s = fold_parallel(a, "", last_digit, concat)
+		assert(size(s) == 10000)
+		assert(subset(s, 0, 12) == "012345678901")
+		assert(subset(s, 9990, 10000) == "0123456789")
 
 	)");
-	ut_verify(QUARK_POS, vm->_print_output, { string() + R"({ "magic": 1234 })" + "\n" });
 }
-*/
 
 
-//////////////////////////////////////////		HOST FUNCTION - write_text_file()
 
 
-QUARK_UNIT_TEST("", "write_text_file()", "", ""){
+//////////////////////////////////////////		HOST FUNCTION - filter()
+
+
+
+QUARK_UNIT_TEST("", "filter()", "int filter([int], int, func int(int, int))", ""){
 	run_closed(R"(
 
-		let path = get_fs_environment().desktop_dir
-		write_text_file(path + "/test_out.txt", "Floyd wrote this!")
+		func bool f(int element){
+			return element % 3 == 0 ? true : false
+		}
+
+		let result = filter([ 3, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13 ], f)
+
+		print(to_string(result))
+		assert(result == [ 3, 3, 6, 9, 12 ])
 
 	)");
 }
 
-//////////////////////////////////////////		HOST FUNCTION - instantiate_from_typeid()
+QUARK_UNIT_TEST("", "filter()", "string filter([int], string, func int(string, int))", ""){
+	run_closed(	R"___(
 
-//	instantiate_from_typeid() only works for const-symbols right now.
-/*
-??? Support when we can make "t = typeof(1234)" a const-symbol
-QUARK_UNIT_TEST("", "", "", ""){
-	const auto result = test__run_return_result(
-		R"(
-			t = typeof(1234);
-			result = instantiate_from_typeid(t, 3);
-		)", {}
-	);
-	ut_verify_values(QUARK_POS, result, value_t::make_int(3));
+		func bool f(string element){
+			return size(element) == 3 || size(element) == 5
+		}
+
+		let result = filter([ "one", "two", "three", "four", "five", "six", "seven" ], f)
+
+		print(to_string(result))
+		assert(result == [ "one", "two", "three", "six", "seven" ])
+
+	)___");
 }
 
-QUARK_UNIT_TEST("", "", "", ""){
+//	Big enough to run f() on the worker threads. The pool gets four workers, also on single-core machines.
+QUARK_UNIT_TEST("", "filter()", "[int] filter([int], func bool(int)) big vector", "same order as input"){
+	const shared_task_pool_override_t pool(4);
 	run_closed(R"(
 
-		a = instantiate_from_typeid(typeof(123), 3);
-		assert(to_string(typeof(a)) == "int");
-		assert(a == 3);
+		func bool f(int element){
+			return element % 7 == 0 || element % 11 == 3
+		}
+
+		mutable a = [ 0 ]
+		mutable expected = [ 0 ]
+		for(i in 1 ..< 10000){
+			let e = (i * 7919) % 10007
+			a = push_back(a, e)
+			if(f(e)){
+				expected = push_back(expected, e)
+			}
+		}
+
+		let result = filter(a, f)
+		assert(result == expected)
 
 	)");
 }
-*/
 
+QUARK_UNIT_TEST("", "filter()", "[string] filter([string], func bool(string)) big vector", "same order as input"){
+	const shared_task_pool_override_t pool(4);
+	run_closed(R"(
 
-//////////////////////////////////////////		HOST FUNCTION - get_directory_entries()
+		func bool f(string element){
+			return size(element) == 3
+		}
 
+		mutable a = [ "" ]
+		mutable expected = [ "" ]
+		for(i in 1 ..< 10000){
+			let e = to_string((i * 7919) % 10007)
+			a = push_back(a, e)
+			if(f(e)){
+				expected = push_back(expected, e)
+			}
+		}
 
-QUARK_UNIT_TEST("", "get_directory_entries()", "", ""){
-	ut_verify_global_result(
-		QUARK_POS,
-		R"(
+		let result = filter(a, f)
+		assert(result == subset(expected, 1, size(expected)))
 
-			let result0 = get_fsentries_shallow("/Users/marcus/Desktop/")
-			assert(size(result0) > 3)
-			print(to_pretty_string(result0))
+	)");
+}
 
-			let result = typeof(result0)
 
-		)",
-		value_t::make_typeid_value(
-			typeid_t::make_vector(make__fsentry_t__type())
-		)
-	);
-}
 
 
-//////////////////////////////////////////		HOST FUNCTION - get_fsentries_deep()
 
+//////////////////////////////////////////		HOST FUNCTION - supermap()
 
-QUARK_UNIT_TEST("", "get_fsentries_deep()", "", ""){
-	run_closed(
-		R"(
 
-			let result = get_fsentries_deep("/Users/marcus/Desktop/")
-			assert(size(result) > 3)
-			print(to_pretty_string(result))
 
-		)"
-	);
-}
+QUARK_UNIT_TEST("", "supermap()", "No dependencies", ""){
+	run_closed(R"(
 
+		func string f(string v, [string] inputs){
+			return "[" + v + "]"
+		}
 
-//////////////////////////////////////////		HOST FUNCTION - get_fsentry_info()
+		let result = supermap([ "one", "ring", "to" ], [ -1, -1, -1 ], f)
+		print(to_string(result))
+		assert(result == [ "[one]", "[ring]", "[to]" ])
 
+	)");
+}
 
-QUARK_UNIT_TEST("", "get_fsentry_info()", "", ""){
-	ut_verify_global_result(
-		QUARK_POS,
-		R"(
+QUARK_UNIT_TEST("", "supermap()", "No dependencies", ""){
+	run_closed(R"(
 
-			let x = get_fsentry_info("/Users/marcus/Desktop/")
-			print(to_pretty_string(x))
-			let result = typeof(x)
+		func string f(string v, [string] inputs){
+			return "[" + v + "]"
+		}
 
-		)",
-		value_t::make_typeid_value(
-			make__fsentry_info_t__type()
-		)
-	);
-}
+		let result = supermap([ "one", "ring", "to" ], [ 1, 2, -1 ], f)
+		print(to_string(result))
+		assert(result == [ "[one]", "[ring]", "[to]" ])
 
+	)");
+}
 
-//////////////////////////////////////////		HOST FUNCTION - get_fs_environment()
 
 
-QUARK_UNIT_TEST("", "get_fs_environment()", "", ""){
-	ut_verify_global_result(
-		QUARK_POS,
-		R"(
 
-			let x = get_fs_environment()
-			print(to_pretty_string(x))
-			let result = typeof(x)
 
-		)",
-		value_t::make_typeid_value(
-			make__fs_environment_t__type()
-		)
-	);
-}
+QUARK_UNIT_TEST("", "supermap()", "complex", ""){
+	run_closed(R"(
 
+		func string f2(string acc, string element){
+			if(size(acc) == 0){
+				return element
+			}
+			else{
+				return acc + ", " + element
+			}
+		}
 
+		func string f(string v, [string] inputs){
+			let s = reduce(inputs, "", f2)
+			return v + "[" + s + "]"
+		}
 
+		let result = supermap([ "D", "B", "A", "C", "E", "F" ], [ 4, 2, -1, 4, 2, 4 ], f)
+		print(to_string(result))
+		assert(result == [ "D[]", "B[]", "A[B[], E[D[], C[], F[]]]", "C[]", "E[D[], C[], F[]]", "F[]" ])
 
-//////////////////////////////////////////		HOST FUNCTION - does_fsentry_exist()
+	)");
+}
 
+QUARK_UNIT_TEST("", "supermap()", "big binary tree", "Each node gets its subtree size"){
+	const shared_task_pool_override_t pool(4);
+	run_closed(R"(
 
-QUARK_UNIT_TEST("", "does_fsentry_exist()", "", ""){
-	ut_verify_global_result(
-		QUARK_POS,
-		R"(
+		func int add(int acc, int e){
+			return acc + e
+		}
 
-			let path = get_fs_environment().desktop_dir
-			let x = does_fsentry_exist(path)
-			print(to_pretty_string(x))
+		func int f(int v, [int] inputs){
+			return 1 + reduce(inputs, 0, add)
+		}
 
-			assert(x == true)
-			let result = typeof(x)
+		mutable elements = [0]
+		mutable parents = [-1]
+		for(i in 1 ..< 5000){
+			elements = push_back(elements, i)
+			parents = push_back(parents, (i - 1) / 2)
+		}
+		let result = supermap(elements, parents, f)
+		assert(size(result) == 5000)
+		assert(result[0] == 5000)
+		assert(result[1] == 2952)
+		assert(result[2] == 2047)
+		assert(result[4999] == 1)
 
-		)",
-		value_t::make_typeid_value(typeid_t::make_bool())
-	);
+	)");
 }
 
-QUARK_UNIT_TEST("", "does_fsentry_exist()", "", ""){
-	ut_verify_global_result(
+QUARK_UNIT_TEST("", "supermap()", "dependency cycle", "Exception"){
+	ut_verify_exception(
 		QUARK_POS,
 		R"(
 
-			let path = get_fs_environment().desktop_dir + "xyz"
-			let result = does_fsentry_exist(path)
-			print(to_pretty_string(result))
+			func string f(string v, [string] inputs){
+				return v
+			}
 
-			assert(result == false)
+			let result = supermap([ "A", "B", "C" ], [ -1, 2, 1 ], f)
 
 		)",
-		value_t::make_bool(false)
+		"supermap() dependency cycle error."
 	);
 }
 
-void remove_test_dir(const std::string& dir_name1, const std::string& dir_name2){
-	const auto path1 = GetDirectories().desktop_dir + "/" + dir_name1;
-	const auto path2 = path1 + "/" + dir_name2;
 
-	if(DoesEntryExist(path1) == true){
-		DeleteDeep(path1);
-		QUARK_ASSERT(DoesEntryExist(path1) == false);
-		QUARK_ASSERT(DoesEntryExist(path2) == false);
-	}
-}
 
 
 
-//////////////////////////////////////////		HOST FUNCTION - create_directory_branch()
+//////////////////////////////////////////		HOST FUNCTION - sum(), min_element(), max_element(), dot(), scale(), axpy()
 
 
-QUARK_UNIT_TEST("", "create_directory_branch()", "", ""){
-	remove_test_dir("unittest___create_directory_branch", "subdir");
 
-	run_closed(
-		R"(
+QUARK_UNIT_TEST("", "sum()", "", ""){
+	run_closed(R"(
 
-			let path1 = get_fs_environment().desktop_dir + "/unittest___create_directory_branch"
-			let path2 = path1 + "/subdir"
+		assert(sum([ 3, -1, 10 ]) == 12)
+		assert(sum([ 1.5, 2.25 ]) == 3.75)
+		assert(sum(subset([ 1 ], 1, 1)) == 0)
 
-			assert(does_fsentry_exist(path1) == false)
-			assert(does_fsentry_exist(path2) == false)
+	)");
+}
 
-			//	Make test.
-			create_directory_branch(path2)
-			assert(does_fsentry_exist(path1) == true)
-			assert(does_fsentry_exist(path2) == true)
+//	Programs written before sum() existed keep working: their own sum() shadows the host function.
+QUARK_UNIT_TEST("", "sum()", "program defines its own sum()", "shadows host function"){
+	run_closed(R"(
 
-			delete_fsentry_deep(path1)
-			assert(does_fsentry_exist(path1) == false)
-			assert(does_fsentry_exist(path2) == false)
+		let host_sum = sum([ 3, -1, 10 ])
 
-			let result = true
+		func int sum(int a, int b){
+			return a + b
+		}
+		assert(sum(3, 4) == 7)
+		assert(host_sum == 12)
 
-		)"
-	);
-}
+		let dot = 2.5
+		mutable scale = 3
+		scale = scale + 1
+		assert(dot * 2.0 == 5.0)
+		assert(scale == 4)
 
+	)");
+}
 
-//////////////////////////////////////////		HOST FUNCTION - delete_fsentry_deep()
+QUARK_UNIT_TEST("", "min_element()", "max_element()", ""){
+	run_closed(R"(
 
+		assert(min_element([ 3, -1, 10 ]) == -1)
+		assert(max_element([ 3, -1, 10 ]) == 10)
+		assert(min_element([ 1.5, -2.25, 0.0 ]) == -2.25)
+		assert(max_element([ 7.0 ]) == 7.0)
 
-QUARK_UNIT_TEST("", "delete_fsentry_deep()", "", ""){
-	remove_test_dir("unittest___delete_fsentry_deep", "subdir");
+	)");
+}
 
-	run_closed(
+QUARK_UNIT_TEST("", "min_element()", "empty vector", "throws"){
+	ut_verify_exception(
+		QUARK_POS,
 		R"(
 
-			let path1 = get_fs_environment().desktop_dir + "/unittest___delete_fsentry_deep"
-			let path2 = path1 + "/subdir"
+			let a = min_element(subset([ 1 ], 1, 1))
 
-			assert(does_fsentry_exist(path1) == false)
-			assert(does_fsentry_exist(path2) == false)
+		)",
+		"min_element() of empty vector."
+	);
+}
 
-			create_directory_branch(path2)
-			assert(does_fsentry_exist(path1) == true)
-			assert(does_fsentry_exist(path2) == true)
+QUARK_UNIT_TEST("", "dot()", "", ""){
+	run_closed(R"(
 
-			//	Make test.
-			delete_fsentry_deep(path1)
-			assert(does_fsentry_exist(path1) == false)
-			assert(does_fsentry_exist(path2) == false)
+		assert(dot([ 1, 2, 3 ], [ 4, 5, 6 ]) == 32)
+		assert(dot([ 0.5, 2.0 ], [ 4.0, -1.0 ]) == 0.0)
 
-			let result = true
-
-		)"
-	);
+	)");
 }
 
+QUARK_UNIT_TEST("", "dot()", "different sizes", "throws"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
 
+			let a = dot([ 1, 2, 3 ], [ 4, 5 ])
 
-//////////////////////////////////////////		HOST FUNCTION - rename_fsentry()
+		)",
+		"dot() requires two vectors of the same size."
+	);
+}
 
+QUARK_UNIT_TEST("", "scale()", "axpy()", ""){
+	run_closed(R"(
 
-QUARK_UNIT_TEST("", "rename_fsentry()", "", ""){
-	run_closed(
-		R"(
+		assert(scale([ 1, 2, 3 ], 3) == [ 3, 6, 9 ])
+		assert(scale([ 1.0, -0.5 ], 2.0) == [ 2.0, -1.0 ])
+		assert(axpy(2, [ 1, 2 ], [ 10, 20 ]) == [ 12, 24 ])
+		assert(axpy(0.5, [ 1.0, 2.0, 3.0 ], [ 1.0, 1.0, 1.0 ]) == [ 1.5, 2.0, 2.5 ])
 
-			let dir = get_fs_environment().desktop_dir + "/unittest___rename_fsentry"
+	)");
+}
 
-			delete_fsentry_deep(dir)
+//	Many leaf chunks. Compare with the same thing done element by element.
+QUARK_UNIT_TEST("", "sum()", "dot(), axpy(), big vectors", ""){
+	run_closed(R"(
 
-			let file_path1 = dir + "/original.txt"
-			let file_path2 = dir + "/renamed.txt"
+		mutable a = [ 0 ]
+		mutable b = [ 0 ]
+		for(i in 1 ..< 1000){
+			a = push_back(a, (i * 37) % 101 - 50)
+			b = push_back(b, i)
+		}
 
-			assert(does_fsentry_exist(file_path1) == false)
-			assert(does_fsentry_exist(file_path2) == false)
+		func int add(int acc, int v){
+			return acc + v
+		}
+		func int smaller(int acc, int v){
+			return v < acc ? v : acc
+		}
+		assert(sum(a) == reduce(a, 0, add))
+		assert(min_element(a) == reduce(a, 1000, smaller))
 
-			//	Will also create parent directory.
-			write_text_file(file_path1, "This is the file contents\n")
+		mutable expected_dot = 0
+		for(i in 0 ..< 1000){
+			expected_dot = expected_dot + a[i] * b[i]
+		}
+		assert(dot(a, b) == expected_dot)
+		assert(dot(b, a) == expected_dot)
 
-			assert(does_fsentry_exist(file_path1) == true)
-			assert(does_fsentry_exist(file_path2) == false)
+		let r = axpy(3, a, b)
+		for(i in 0 ..< 1000){
+			assert(r[i] == 3 * a[i] + b[i])
+		}
 
-			rename_fsentry(file_path1, "renamed.txt")
+	)");
+}
 
-			assert(does_fsentry_exist(file_path1) == false)
-			assert(does_fsentry_exist(file_path2) == true)
 
-			delete_fsentry_deep(dir)
 
-			let result = true
 
-		)"
-	);
-}
+//////////////////////////////////////////		HOST FUNCTION - sort(), sort_by()
 
 
 
+QUARK_UNIT_TEST("", "sort()", "[int], [double], [string]", ""){
+	run_closed(R"(
 
+		assert(sort([ 3, -1, 10, 3, 0 ]) == [ -1, 0, 3, 3, 10 ])
+		assert(sort([ 2.5, -1.0, 0.25 ]) == [ -1.0, 0.25, 2.5 ])
+		assert(sort([ "pear", "apple", "fig", "apple" ]) == [ "apple", "apple", "fig", "pear" ])
+		assert(sort(subset([ 1 ], 1, 1)) == subset([ 1 ], 1, 1))
 
-///////////////////////////////////////////////////			PARSER ERRORS
+	)");
+}
 
-QUARK_UNIT_TEST("Parser error", "", "", ""){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+QUARK_UNIT_TEST("", "sort()", "[struct]", "ordered by members"){
+	run_closed(R"(
 
-			£
+		struct pos_t { int x; int y }
+		let a = sort([ pos_t(2, 1), pos_t(1, 5), pos_t(2, 0), pos_t(1, 4) ])
+		assert(a == [ pos_t(1, 4), pos_t(1, 5), pos_t(2, 0), pos_t(2, 1) ])
 
-		)",
-		R"___(Illegal characters. Line: 3 "£")___"
-	);
+	)");
 }
 
+QUARK_UNIT_TEST("", "sort()", "[bool], [[int]]", ""){
+	run_closed(R"(
 
-QUARK_UNIT_TEST("Parser error", "", "", ""){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+		assert(sort([ true, false, true ]) == [ false, true, true ])
 
-			{ let a = 10
+		//	Same order as the < operator.
+		let a = sort([ [ 2 ], [ 1, 9 ], [ 1 ], [ 0, 5, 5 ] ])
+		assert(size(a) == 4)
+		for(i in 1 ..< 4){
+			assert(a[i - 1] <= a[i])
+		}
 
-		)",
-		R"___(Block is missing end bracket '}'. Line: 3 "{ let a = 10")___"
-	);
+	)");
 }
 
-QUARK_UNIT_TEST("Parser error", "", "", ""){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+QUARK_UNIT_TEST("", "sort()", "NaN", "last, same order as the < operator"){
+	run_closed(R"(
 
-			[ 100, 200 }
+		mutable big = 1.0
+		for(i in 0 ..< 400){
+			big = big * 10.0
+		}
+		let nan = big - big
 
-		)",
-		R"___(Unexpected char "}" in bounded list [ ]! Line: 3 "[ 100, 200 }")___"
-	);
-}
+		assert(nan == nan)
+		assert(1.0 < nan)
+		assert((nan < 1.0) == false)
 
-QUARK_UNIT_TEST("Parser error", "", "", ""){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+		assert(sort([ 2.0, nan, -1.0, nan, 0.5 ]) == [ -1.0, 0.5, 2.0, nan, nan ])
+		assert(sort([ [ nan ], [ 1.0 ], [ 0.0, nan ] ]) == [ [ 0.0, nan ], [ 1.0 ], [ nan ] ])
 
-			x = { "a": 100 ]
+		struct p_t { double x }
+		assert(sort([ p_t(nan), p_t(1.0), p_t(0.0) ]) == [ p_t(0.0), p_t(1.0), p_t(nan) ])
 
-		)",
-		R"___(Unexpected char "]" in bounded list { }! Line: 3 "x = { "a": 100 ]")___"
-	);
+	)");
 }
 
+QUARK_UNIT_TEST("", "sort()", "big vector", ""){
+	const shared_task_pool_override_t pool(4);
+	run_closed(R"(
 
-QUARK_UNIT_TEST("Parser error", "", "", ""){
-	ut_verify_exception(
-		QUARK_POS,
-		R"("abc\)",
-		R"___(Incomplete escape sequence in string literal: "abc"! Line: 1 ""abc\")___"
-	);
+		mutable a = [ 0 ]
+		for(i in 1 ..< 40000){
+			a = push_back(a, (i * 7919) % 40009)
+		}
+		let b = sort(a)
+		assert(size(b) == 40000)
+		for(i in 1 ..< 40000){
+			assert(b[i - 1] <= b[i])
+		}
+		assert(sum(b) == sum(a))
+
+	)");
 }
 
+QUARK_UNIT_TEST("", "sort_by()", "", "stable"){
+	run_closed(R"(
 
+		struct person_t { string name; int age }
+		func int get_age(person_t p){
+			return p.age
+		}
+		let a = sort_by([ person_t("a", 30), person_t("b", 20), person_t("c", 30), person_t("d", 10) ], get_age)
+		assert(a == [ person_t("d", 10), person_t("b", 20), person_t("a", 30), person_t("c", 30) ])
 
-///////////////////////////////////////////////////			EDGE CASES
+	)");
+}
 
+QUARK_UNIT_TEST("", "sort_by()", "string key", ""){
+	run_closed(R"(
 
+		struct person_t { string name; int age }
+		func string get_name(person_t p){
+			return p.name
+		}
+		let a = sort_by([ person_t("bo", 1), person_t("al", 2), person_t("cy", 3) ], get_name)
+		assert(a == [ person_t("al", 2), person_t("bo", 1), person_t("cy", 3) ])
 
-//??? test accessing array->struct->array.
-//??? test structs in vectors.
+	)");
+}
 
-//	??? Add special error when local is not initialized.
-QUARK_UNIT_TEST("Edge case", "", "if with non-bool expression", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+QUARK_UNIT_TEST("", "sort()", "program defines its own sort() and sort_by()", "shadows host function"){
+	run_closed(R"(
 
-			mutable string row
+		func [int] sort([int] a){
+			return [ 1 ]
+		}
+		let sort_by = "key"
+		assert(sort([ 3, 2 ]) == [ 1 ])
+		assert(sort_by == "key")
 
-		)",
-		R"___(Expected '=' character. Line: 3 "mutable string row")___"
-	);
+	)");
 }
 
-QUARK_UNIT_TEST("Edge case", "", "if with non-bool expression", "exception"){
+QUARK_UNIT_TEST("", "sort_by()", "wrong key function", "throws"){
 	ut_verify_exception(
 		QUARK_POS,
 		R"(
 
-			if("not a bool"){
-			}
-			else{
-				assert(false)
+			func int f(string s){
+				return 0
 			}
+			let a = sort_by([ 3, 1 ], f)
 
 		)",
-		"Boolean condition required. Line: 3 \"if(\"not a bool\"){\""
+		"sort_by() key function must accept collection elements as its argument."
 	);
 }
 
-QUARK_UNIT_TEST("Edge case", "", "assign to immutable local", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
 
-			let int a = 10
-			let int a = 11
 
-		)",
-		"Local identifier \"a\" already exists. Line: 4 \"let int a = 11\""
-	);
-}
-QUARK_UNIT_TEST("Edge case", "", "Define struct with colliding name", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+//////////////////////////////////////////		HOST FUNCTION - split(), join(), find_substring(), starts_with(), trim(), replace_all()
 
-			let int a = 10
-			struct a { int x }
 
-		)",
-		"Name \"a\" already used in current lexical scope. Line: 4 \"struct a { int x }\""
-	);
-}
 
-QUARK_UNIT_TEST("Edge case", "", "Access unknown struct member", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+QUARK_UNIT_TEST("", "split()", "", ""){
+	run_closed(R"(
 
-			struct a { int x }
-			let b = a(13)
-			print(b.y)
+		assert(split("a,b,,c", ",") == [ "a", "b", "", "c" ])
+		assert(split("one -- two", " -- ") == [ "one", "two" ])
+		assert(split("abc", ",") == [ "abc" ])
+		assert(split("", ",") == [ "" ])
+		assert(split(",", ",") == [ "", "" ])
 
-		)",
-		"Unknown struct member \"y\". Line: 5 \"print(b.y)\""
-	);
+	)");
 }
 
-QUARK_UNIT_TEST("Edge case", "", "Access unknown member in non-struct", "exception"){
+QUARK_UNIT_TEST("", "split()", "empty separator", "throws"){
 	ut_verify_exception(
 		QUARK_POS,
 		R"(
 
-			let a = 10
-			print(a.y)
+			let a = split("abc", "")
 
 		)",
-		"Left hand side is not a struct value, it's of type \"int\". Line: 4 \"print(a.y)\""
+		"split() separator must not be empty."
 	);
 }
 
-QUARK_UNIT_TEST("Edge case", "", "Lookup in string using non-int", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+QUARK_UNIT_TEST("", "join()", "", ""){
+	run_closed(R"(
 
-			let string a = "test string"
-			print(a["not an integer"])
+		assert(join([ "a", "b", "c" ], ", ") == "a, b, c")
+		assert(join([ "a" ], ", ") == "a")
+		assert(join(split("x y z", " "), "") == "xyz")
 
-		)",
-		"Strings can only be indexed by integers, not a \"string\". Line: 4 \"print(a[\"not an integer\"])\""
-	);
+	)");
 }
 
-QUARK_UNIT_TEST("Edge case", "", "Lookup in vector using non-int", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+QUARK_UNIT_TEST("", "find_substring()", "", ""){
+	run_closed(R"(
 
-			let [string] a = ["one", "two", "three"]
-			print(a["not an integer"])
+		assert(find_substring("hello world", "o", 0) == 4)
+		assert(find_substring("hello world", "o", 5) == 7)
+		assert(find_substring("hello world", "world", 0) == 6)
+		assert(find_substring("hello world", "x", 0) == -1)
+		assert(find_substring("hello", "", 2) == 2)
 
-		)",
-		"Vector can only be indexed by integers, not a \"string\". Line: 4 \"print(a[\"not an integer\"])\""
-	);
+	)");
 }
 
-QUARK_UNIT_TEST("Edge case", "", "Lookup in dict using non-string key", "exception"){
+QUARK_UNIT_TEST("", "find_substring()", "bad start", "throws"){
 	ut_verify_exception(
 		QUARK_POS,
 		R"(
 
-			let a = { "one": 1, "two": 2 }
-			print(a[3])
+			let a = find_substring("abc", "c", 4)
 
 		)",
-		"Dictionary can only be looked up using string keys, not a \"int\". Line: 4 \"print(a[3])\""
+		"find_substring() start out of range."
 	);
 }
 
-QUARK_UNIT_TEST("Edge case", "", "Access undefined variable", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+QUARK_UNIT_TEST("", "starts_with()", "", ""){
+	run_closed(R"(
 
-			print(a)
+		assert(starts_with("hello", "he") == true)
+		assert(starts_with("hello", "hello") == true)
+		assert(starts_with("hello", "") == true)
+		assert(starts_with("he", "hello") == false)
+		assert(starts_with("hello", "lo") == false)
 
-		)",
-		"Undefined variable \"a\". Line: 3 \"print(a)\""
-	);
+	)");
 }
 
-QUARK_UNIT_TEST("Edge case", "", "Wrong number of arguments in function call", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+QUARK_UNIT_TEST("", "trim()", "", ""){
+	run_closed(R"(
 
-			func int f(int a){ return a + 1 }
-			let a = f(1, 2)
+		assert(trim("  a b \n") == "a b")
+		assert(trim("ab") == "ab")
+		assert(trim(" \t ") == "")
 
-		)",
-		"Wrong number of arguments in function call, got 2, expected 1. Line: 4 \"let a = f(1, 2)\""
-	);
+	)");
 }
 
+QUARK_UNIT_TEST("", "replace_all()", "", ""){
+	run_closed(R"(
 
-QUARK_UNIT_TEST("Edge case", "", "Wrong number of arguments to struct-constructor", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
-
-			struct pos { double x double y }
-			let a = pos(3)
+		assert(replace_all("a.b.c", ".", "::") == "a::b::c")
+		assert(replace_all("aaaa", "aa", "b") == "bb")
+		assert(replace_all("abc", "x", "y") == "abc")
+		assert(replace_all("abcabc", "abc", "") == "")
 
-		)",
-		"Wrong number of arguments in function call, got 1, expected 2. Line: 4 \"let a = pos(3)\""
-	);
+	)");
 }
 
-//??? Also tell *which* argument is wrong type -- its name and index.
-QUARK_UNIT_TEST("Edge case", "", "Wrong TYPE of arguments to struct-constructor", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+QUARK_UNIT_TEST("", "split()", "program defines its own split(), join(), trim() and replace_all()", "shadows host function"){
+	run_closed(R"(
 
-			struct pos { double x double y }
-			let a = pos(3, "hello")
+		func [string] split(string s){
+			return [ s, s ]
+		}
+		func string join([string] a){
+			return a[0]
+		}
+		let trim = 3
+		mutable replace_all = false
+		replace_all = true
+		assert(join(split("ab")) == "ab")
+		assert(trim == 3)
+		assert(replace_all)
 
-		)",
-		"Expression type mismatch - cannot convert 'int' to 'double. Line: 4 \"let a = pos(3, \"hello\")\""
-	);
+	)");
 }
 
-QUARK_UNIT_TEST("Edge case", "", "Wrong number of arguments to int-constructor", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
 
-			let a = int()
 
-		)",
-		"Wrong number of arguments in function call, got 0, expected 1. Line: 3 \"let a = int()\""
-	);
-}
+//////////////////////////////////////////		HOST FUNCTION - read_text_file()
 
-QUARK_UNIT_TEST("Edge case", "", "Call non-function, non-struct, non-typeid", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
+/*
+QUARK_UNIT_TEST("", "read_text_file()", "", ""){
+	run_closed(R"(
 
-			let a = 3()
+		path = get_env_path();
+		a = read_text_file(path + "/Desktop/test1.json");
+		print(a);
 
-		)",
-		"Cannot call non-function, its type is int. Line: 3 \"let a = 3()\""
-	);
+	)");
+	ut_verify(QUARK_POS, vm->_print_output, { string() + R"({ "magic": 1234 })" + "\n" });
 }
+*/
 
-QUARK_UNIT_TEST("Edge case", "", "Vector can not hold elements of different types.", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
 
-			let a = [3, bool]
+//////////////////////////////////////////		HOST FUNCTION - write_text_file()
 
-		)",
-		"Vector of type [int] cannot hold an element of type typeid. Line: 3 \"let a = [3, bool]\""
-	);
+
+QUARK_UNIT_TEST("", "write_text_file()", "", ""){
+	run_closed(R"(
+
+		let path = get_fs_environment().desktop_dir
+		write_text_file(path + "/test_out.txt", "Floyd wrote this!")
+
+	)");
 }
-QUARK_UNIT_TEST("Edge case", "", "Dict can not hold elements of different types.", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
-		R"(
 
-			let a = {"one": 1, "two": bool}
+//////////////////////////////////////////		HOST FUNCTION - instantiate_from_typeid()
 
-		)",
-		"Dictionary of type [string:int] cannot hold an element of type typeid. Line: 3 \"let a = {\"one\": 1, \"two\": bool}\""
+//	instantiate_from_typeid() only works for const-symbols right now.
+/*
+??? Support when we can make "t = typeof(1234)" a const-symbol
+QUARK_UNIT_TEST("", "", "", ""){
+	const auto result = test__run_return_result(
+		R"(
+			t = typeof(1234);
+			result = instantiate_from_typeid(t, 3);
+		)", {}
 	);
+	ut_verify_values(QUARK_POS, result, value_t::make_int(3));
 }
 
+QUARK_UNIT_TEST("", "", "", ""){
+	run_closed(R"(
 
-QUARK_UNIT_TEST("Edge case", "", ".", "exception"){
-	ut_verify_exception(
+		a = instantiate_from_typeid(typeof(123), 3);
+		assert(to_string(typeof(a)) == "int");
+		assert(a == 3);
+
+	)");
+}
+*/
+
+
+//////////////////////////////////////////		HOST FUNCTION - get_directory_entries()
+
+
+QUARK_UNIT_TEST("", "get_directory_entries()", "", ""){
+	ut_verify_global_result(
 		QUARK_POS,
 		R"(
 
-			let a = 3 < "hello"
+			let result0 = get_fsentries_shallow("/Users/marcus/Desktop/")
+			assert(size(result0) > 3)
+			print(to_pretty_string(result0))
+
+			let result = typeof(result0)
 
 		)",
-		"Expression type mismatch - cannot convert 'string' to 'int. Line: 3 \"let a = 3 < \"hello\"\""
+		value_t::make_typeid_value(
+			typeid_t::make_vector(make__fsentry_t__type())
+		)
 	);
 }
 
-QUARK_UNIT_TEST("Edge case", "", ".", "exception"){
-	ut_verify_exception(
-		QUARK_POS,
+
+//////////////////////////////////////////		HOST FUNCTION - get_fsentries_deep()
+
+
+QUARK_UNIT_TEST("", "get_fsentries_deep()", "", ""){
+	run_closed(
 		R"(
 
-			let a = 3 * 3.2
+			let result = get_fsentries_deep("/Users/marcus/Desktop/")
+			assert(size(result) > 3)
+			print(to_pretty_string(result))
 
-		)",
-		"Expression type mismatch - cannot convert 'double' to 'int. Line: 3 \"let a = 3 * 3.2\""
+		)"
 	);
 }
-QUARK_UNIT_TEST("Edge case", "Adding bools", ".", "success"){
+
+
+//////////////////////////////////////////		HOST FUNCTION - get_fsentry_info()
+
+
+QUARK_UNIT_TEST("", "get_fsentry_info()", "", ""){
 	ut_verify_global_result(
 		QUARK_POS,
 		R"(
 
-			let result = false + true
+			let x = get_fsentry_info("/Users/marcus/Desktop/")
+			print(to_pretty_string(x))
+			let result = typeof(x)
 
 		)",
-		value_t::make_bool(true)
+		value_t::make_typeid_value(
+			make__fsentry_info_t__type()
+		)
 	);
 }
-QUARK_UNIT_TEST("Edge case", "Adding bools", ".", "success"){
+
+
+//////////////////////////////////////////		HOST FUNCTION - get_fs_environment()
+
+
+QUARK_UNIT_TEST("", "get_fs_environment()", "", ""){
 	ut_verify_global_result(
 		QUARK_POS,
 		R"(
 
-			let result = false + false
+			let x = get_fs_environment()
+			print(to_pretty_string(x))
+			let result = typeof(x)
 
 		)",
-		value_t::make_bool(false)
+		value_t::make_typeid_value(
+			make__fs_environment_t__type()
+		)
 	);
 }
-QUARK_UNIT_TEST("Edge case", "Adding bools", ".", "success"){
+
+
+
+
+//////////////////////////////////////////		HOST FUNCTION - does_fsentry_exist()
+
+
+QUARK_UNIT_TEST("", "does_fsentry_exist()", "", ""){
 	ut_verify_global_result(
 		QUARK_POS,
 		R"(
 
-			let result = true + true
+			let path = get_fs_environment().desktop_dir
+			let x = does_fsentry_exist(path)
+			print(to_pretty_string(x))
+
+			assert(x == true)
+			let result = typeof(x)
 
 		)",
-		value_t::make_bool(true)
+		value_t::make_typeid_value(typeid_t::make_bool())
 	);
 }
 
-QUARK_UNIT_TEST("Edge case", "", "Lookup the unlookupable", "exception"){
-	ut_verify_exception(
+QUARK_UNIT_TEST("", "does_fsentry_exist()", "", ""){
+	ut_verify_global_result(
 		QUARK_POS,
 		R"(
 
-			let a = 3[0]
+			let path = get_fs_environment().desktop_dir + "xyz"
+			let result = does_fsentry_exist(path)
+			print(to_pretty_string(result))
+
+			assert(result == false)
 
 		)",
-		"Lookup using [] only works with strings, vectors, dicts and json_value - not a \"int\". Line: 3 \"let a = 3[0]\""
+		value_t::make_bool(false)
 	);
 }
 
+void remove_test_dir(const std::string& dir_name1, const std::string& dir_name2){
+	const auto path1 = GetDirectories().desktop_dir + "/" + dir_name1;
+	const auto path2 = path1 + "/" + dir_name2;
 
-QUARK_UNIT_TEST("vector-int", "size()", "3", ""){
-	ut_verify_global_result(
-		QUARK_POS,
-		R"(
+	if(DoesEntryExist(path1) == true){
+		DeleteDeep(path1);
+		QUARK_ASSERT(DoesEntryExist(path1) == false);
+		QUARK_ASSERT(DoesEntryExist(path2) == false);
+	}
+}
 
-			let [int] a = [1, 2, 3]
-			let result = size(a)
 
-		)",
-		value_t::make_int(3)
-	);
-}
 
-QUARK_UNIT_TEST("vector-int", "size()", "3", ""){
+//////////////////////////////////////////		HOST FUNCTION - create_directory_branch()
+
+
+QUARK_UNIT_TEST("", "create_directory_branch()", "", ""){
+	remove_test_dir("unittest___create_directory_branch", "subdir");
+
 	run_closed(
 		R"(
 
-			let result = push_back([1, 2], 3)
-			assert(result == [1, 2, 3])
+			let path1 = get_fs_environment().desktop_dir + "/unittest___create_directory_branch"
+			let path2 = path1 + "/subdir"
+
+			assert(does_fsentry_exist(path1) == false)
+			assert(does_fsentry_exist(path2) == false)
+
+			//	Make test.
+			create_directory_branch(path2)
+			assert(does_fsentry_exist(path1) == true)
+			assert(does_fsentry_exist(path2) == true)
+
+			delete_fsentry_deep(path1)
+			assert(does_fsentry_exist(path1) == false)
+			assert(does_fsentry_exist(path2) == false)
+
+			let result = true
 
 		)"
 	);
 }
 
 
+//////////////////////////////////////////		HOST FUNCTION - delete_fsentry_deep()
 
 
-#if 0
-OFF_QUARK_UNIT_TEST("Analyse all test programs", "", "", ""){
-	int instruction_count_total = 0;
-	int symbol_count_total = 0;
+QUARK_UNIT_TEST("", "delete_fsentry_deep()", "", ""){
+	remove_test_dir("unittest___delete_fsentry_deep", "subdir");
 
-	for(const auto& s: program_recording){
-		try{
-		const auto bc = compile_to_bytecode(s, "");
-		int instruction_count_sum = static_cast<int>(bc._globals._instructions.size());
-		int symbol_count_sum = static_cast<int>(bc._globals._symbols.size());
+	run_closed(
+		R"(
 
-		for(const auto& f: bc._function_defs){
-			if(f._frame_ptr != nullptr){
-				const auto instruction_count = f._frame_ptr->_instructions.size();
-				const auto symbol_count = f._frame_ptr->_symbols.size();
-				instruction_count_sum += instruction_count;
-				symbol_count_sum += symbol_count;
-			}
-		}
+			let path1 = get_fs_environment().desktop_dir + "/unittest___delete_fsentry_deep"
+			let path2 = path1 + "/subdir"
 
-		instruction_count_total += instruction_count_sum;
-		symbol_count_total += symbol_count_sum;
-		QUARK_TRACE_SS(instruction_count_sum << "\t" <<symbol_count_sum);
-		}
-		catch(...){
-		}
-	}
+			assert(does_fsentry_exist(path1) == false)
+			assert(does_fsentry_exist(path2) == false)
 
-	QUARK_TRACE_SS("TOTAL: " << instruction_count_total << "\t" <<symbol_count_total);
-}
-#endif
+			create_directory_branch(path2)
+			assert(does_fsentry_exist(path1) == true)
+			assert(does_fsentry_exist(path2) == true)
 
+			//	Make test.
+			delete_fsentry_deep(path1)
+			assert(does_fsentry_exist(path1) == false)
+			assert(does_fsentry_exist(path2) == false)
 
+			let result = true
 
+		)"
+	);
+}
 
 
 
+//////////////////////////////////////////		HOST FUNCTION - rename_fsentry()
 
 
+QUARK_UNIT_TEST("", "rename_fsentry()", "", ""){
+	run_closed(
+		R"(
 
-///////////////////////////////////////////////////////////////////////////////////////
-//	FLOYD SYSTEMS TESTS
-///////////////////////////////////////////////////////////////////////////////////////
+			let dir = get_fs_environment().desktop_dir + "/unittest___rename_fsentry"
+
+			delete_fsentry_deep(dir)
+
+			let file_path1 = dir + "/original.txt"
+			let file_path2 = dir + "/renamed.txt"
+
+			assert(does_fsentry_exist(file_path1) == false)
+			assert(does_fsentry_exist(file_path2) == false)
+
+			//	Will also create parent directory.
+			write_text_file(file_path1, "This is the file contents\n")
+
+			assert(does_fsentry_exist(file_path1) == true)
+			assert(does_fsentry_exist(file_path2) == false)
+
+			rename_fsentry(file_path1, "renamed.txt")
+
+			assert(does_fsentry_exist(file_path1) == false)
+			assert(does_fsentry_exist(file_path2) == true)
+
+			delete_fsentry_deep(dir)
+
+			let result = true
+
+		)"
+	);
+}
+
+
+
+
+
+///////////////////////////////////////////////////			PARSER ERRORS
+
+QUARK_UNIT_TEST("Parser error", "", "", ""){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			£
+
+		)",
+		R"___(Illegal characters. Line: 3 "£")___"
+	);
+}
+
+
+QUARK_UNIT_TEST("Parser error", "", "", ""){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			{ let a = 10
+
+		)",
+		R"___(Block is missing end bracket '}'. Line: 3 "{ let a = 10")___"
+	);
+}
+
+QUARK_UNIT_TEST("Parser error", "", "", ""){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			[ 100, 200 }
+
+		)",
+		R"___(Unexpected char "}" in bounded list [ ]! Line: 3 "[ 100, 200 }")___"
+	);
+}
+
+QUARK_UNIT_TEST("Parser error", "", "", ""){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			x = { "a": 100 ]
+
+		)",
+		R"___(Unexpected char "]" in bounded list { }! Line: 3 "x = { "a": 100 ]")___"
+	);
+}
+
+
+QUARK_UNIT_TEST("Parser error", "", "", ""){
+	ut_verify_exception(
+		QUARK_POS,
+		R"("abc\)",
+		R"___(Incomplete escape sequence in string literal: "abc"! Line: 1 ""abc\")___"
+	);
+}
+
+
+
+///////////////////////////////////////////////////			EDGE CASES
+
+
+
+//??? test accessing array->struct->array.
+//??? test structs in vectors.
+
+//	??? Add special error when local is not initialized.
+QUARK_UNIT_TEST("Edge case", "", "if with non-bool expression", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			mutable string row
+
+		)",
+		R"___(Expected '=' character. Line: 3 "mutable string row")___"
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "if with non-bool expression", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			if("not a bool"){
+			}
+			else{
+				assert(false)
+			}
+
+		)",
+		"Boolean condition required. Line: 3 \"if(\"not a bool\"){\""
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "assign to immutable local", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let int a = 10
+			let int a = 11
+
+		)",
+		"Local identifier \"a\" already exists. Line: 4 \"let int a = 11\""
+	);
+}
+QUARK_UNIT_TEST("Edge case", "", "Define struct with colliding name", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let int a = 10
+			struct a { int x }
+
+		)",
+		"Name \"a\" already used in current lexical scope. Line: 4 \"struct a { int x }\""
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "Access unknown struct member", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			struct a { int x }
+			let b = a(13)
+			print(b.y)
+
+		)",
+		"Unknown struct member \"y\". Line: 5 \"print(b.y)\""
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "Access unknown member in non-struct", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let a = 10
+			print(a.y)
+
+		)",
+		"Left hand side is not a struct value, it's of type \"int\". Line: 4 \"print(a.y)\""
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "Lookup in string using non-int", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let string a = "test string"
+			print(a["not an integer"])
+
+		)",
+		"Strings can only be indexed by integers, not a \"string\". Line: 4 \"print(a[\"not an integer\"])\""
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "Lookup in vector using non-int", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let [string] a = ["one", "two", "three"]
+			print(a["not an integer"])
+
+		)",
+		"Vector can only be indexed by integers, not a \"string\". Line: 4 \"print(a[\"not an integer\"])\""
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "Lookup in dict using non-string key", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let a = { "one": 1, "two": 2 }
+			print(a[3])
+
+		)",
+		"Dictionary can only be looked up using string keys, not a \"int\". Line: 4 \"print(a[3])\""
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "Access undefined variable", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			print(a)
+
+		)",
+		"Undefined variable \"a\". Line: 3 \"print(a)\""
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "Wrong number of arguments in function call", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			func int f(int a){ return a + 1 }
+			let a = f(1, 2)
+
+		)",
+		"Wrong number of arguments in function call, got 2, expected 1. Line: 4 \"let a = f(1, 2)\""
+	);
+}
+
+
+QUARK_UNIT_TEST("Edge case", "", "Wrong number of arguments to struct-constructor", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			struct pos { double x double y }
+			let a = pos(3)
+
+		)",
+		"Wrong number of arguments in function call, got 1, expected 2. Line: 4 \"let a = pos(3)\""
+	);
+}
+
+//??? Also tell *which* argument is wrong type -- its name and index.
+QUARK_UNIT_TEST("Edge case", "", "Wrong TYPE of arguments to struct-constructor", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			struct pos { double x double y }
+			let a = pos(3, "hello")
+
+		)",
+		"Expression type mismatch - cannot convert 'int' to 'double. Line: 4 \"let a = pos(3, \"hello\")\""
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "Wrong number of arguments to int-constructor", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let a = int()
+
+		)",
+		"Wrong number of arguments in function call, got 0, expected 1. Line: 3 \"let a = int()\""
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "Call non-function, non-struct, non-typeid", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let a = 3()
+
+		)",
+		"Cannot call non-function, its type is int. Line: 3 \"let a = 3()\""
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "Vector can not hold elements of different types.", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let a = [3, bool]
+
+		)",
+		"Vector of type [int] cannot hold an element of type typeid. Line: 3 \"let a = [3, bool]\""
+	);
+}
+QUARK_UNIT_TEST("Edge case", "", "Dict can not hold elements of different types.", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let a = {"one": 1, "two": bool}
+
+		)",
+		"Dictionary of type [string:int] cannot hold an element of type typeid. Line: 3 \"let a = {\"one\": 1, \"two\": bool}\""
+	);
+}
+
+
+QUARK_UNIT_TEST("Edge case", "", ".", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let a = 3 < "hello"
+
+		)",
+		"Expression type mismatch - cannot convert 'string' to 'int. Line: 3 \"let a = 3 < \"hello\"\""
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", ".", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let a = 3 * 3.2
+
+		)",
+		"Expression type mismatch - cannot convert 'double' to 'int. Line: 3 \"let a = 3 * 3.2\""
+	);
+}
+QUARK_UNIT_TEST("Edge case", "Adding bools", ".", "success"){
+	ut_verify_global_result(
+		QUARK_POS,
+		R"(
+
+			let result = false + true
+
+		)",
+		value_t::make_bool(true)
+	);
+}
+QUARK_UNIT_TEST("Edge case", "Adding bools", ".", "success"){
+	ut_verify_global_result(
+		QUARK_POS,
+		R"(
+
+			let result = false + false
+
+		)",
+		value_t::make_bool(false)
+	);
+}
+QUARK_UNIT_TEST("Edge case", "Adding bools", ".", "success"){
+	ut_verify_global_result(
+		QUARK_POS,
+		R"(
+
+			let result = true + true
+
+		)",
+		value_t::make_bool(true)
+	);
+}
+
+QUARK_UNIT_TEST("Edge case", "", "Lookup the unlookupable", "exception"){
+	ut_verify_exception(
+		QUARK_POS,
+		R"(
+
+			let a = 3[0]
+
+		)",
+		"Lookup using [] only works with strings, vectors, dicts and json_value - not a \"int\". Line: 3 \"let a = 3[0]\""
+	);
+}
+
+
+QUARK_UNIT_TEST("vector-int", "size()", "3", ""){
+	ut_verify_global_result(
+		QUARK_POS,
+		R"(
+
+			let [int] a = [1, 2, 3]
+			let result = size(a)
+
+		)",
+		value_t::make_int(3)
+	);
+}
+
+QUARK_UNIT_TEST("vector-int", "size()", "3", ""){
+	run_closed(
+		R"(
+
+			let result = push_back([1, 2], 3)
+			assert(result == [1, 2, 3])
+
+		)"
+	);
+}
+
+
+
+
+#if 0
+OFF_QUARK_UNIT_TEST("Analyse all test programs", "", "", ""){
+	int instruction_count_total = 0;
+	int symbol_count_total = 0;
+
+	for(const auto& s: program_recording){
+		try{
+		const auto bc = compile_to_bytecode(s, "");
+		int instruction_count_sum = static_cast<int>(bc._globals._instructions.size());
+		int symbol_count_sum = static_cast<int>(bc._globals._symbols.size());
+
+		for(const auto& f: bc._function_defs){
+			if(f._frame_ptr != nullptr){
+				const auto instruction_count = f._frame_ptr->_instructions.size();
+				const auto symbol_count = f._frame_ptr->_symbols.size();
+				instruction_count_sum += instruction_count;
+				symbol_count_sum += symbol_count;
+			}
+		}
+
+		instruction_count_total += instruction_count_sum;
+		symbol_count_total += symbol_count_sum;
+		QUARK_TRACE_SS(instruction_count_sum << "\t" <<symbol_count_sum);
+		}
+		catch(...){
+		}
+	}
+
+	QUARK_TRACE_SS("TOTAL: " << instruction_count_total << "\t" <<symbol_count_total);
+}
+#endif
+
+
+
+
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//	FLOYD SYSTEMS TESTS
+///////////////////////////////////////////////////////////////////////////////////////
 
 
 
@@ -4274,32 +5400,443 @@ QUARK_UNIT_TEST("software-system", "parse software-system", "", ""){
 			"name": "My Arcade Game",
 			"desc": "Space shooter for mobile devices, with connection to a server.",
 
-			"people": {
-				"Gamer": "Plays the game on one of the mobile apps",
-				"Curator": "Updates achievements, competitions, make custom on-off maps",
-				"Admin": "Keeps the system running"
-			},
-			"connections": [
-				{ "source": "Game", "dest": "iphone app", "interaction": "plays", "tech": "" }
-			],
+			"people": {
+				"Gamer": "Plays the game on one of the mobile apps",
+				"Curator": "Updates achievements, competitions, make custom on-off maps",
+				"Admin": "Keeps the system running"
+			},
+			"connections": [
+				{ "source": "Game", "dest": "iphone app", "interaction": "plays", "tech": "" }
+			],
+			"containers": [
+				"gmail mail server",
+				"iphone app",
+				"Android app"
+			]
+		}
+
+	)";
+
+	run_closed(test_ss);
+}
+
+QUARK_UNIT_TEST("software-system", "run one process", "", ""){
+	const auto test_ss2 = R"(
+
+		software-system {
+			"name": "My Arcade Game",
+			"desc": "Space shooter for mobile devices, with connection to a server.",
+			"people": {},
+			"connections": [],
+			"containers": [ "iphone app" ]
+		}
+
+		container-def {
+			"name": "iphone app",
+			"tech": "Swift, iOS, Xcode, Open GL",
+			"desc": "Mobile shooter game for iOS.",
+			"clocks": {
+				"main": {
+					"a": "my_gui"
+				}
+			}
+		}
+
+		struct my_gui_state_t {
+			int _count
+		}
+
+		func my_gui_state_t my_gui__init() impure {
+			send("a", "dec")
+			send("a", "dec")
+			send("a", "dec")
+			send("a", "dec")
+			send("a", "stop")
+			return my_gui_state_t(1000)
+		}
+
+		func my_gui_state_t my_gui(my_gui_state_t state, json_value message){
+			print("received: " + to_string(message) + ", state: " + to_string(state))
+
+			if(message == "inc"){
+				return update(state, "_count", state._count + 1)
+			}
+			else if(message == "dec"){
+				return update(state, "_count", state._count - 1)
+			}
+			else{
+				assert(false)
+			}
+		}
+
+	)";
+
+	const auto result = run_container2(test_ss2, {}, "iphone app", "");
+	QUARK_UT_VERIFY(result.empty());
+}
+
+QUARK_UNIT_TEST("software-system", "run two unconnected processs", "", ""){
+	const auto test_ss3 = R"(
+
+		software-system {
+			"name": "My Arcade Game",
+			"desc": "Space shooter for mobile devices, with connection to a server.",
+			"people": {},
+			"connections": [],
+			"containers": [
+				"iphone app"
+			]
+		}
+
+		container-def {
+			"name": "iphone app",
+			"tech": "Swift, iOS, Xcode, Open GL",
+			"desc": "Mobile shooter game for iOS.",
+			"clocks": {
+				"main": {
+					"a": "my_gui",
+					"b": "my_audio"
+				}
+			}
+		}
+
+		////////////////////////////////	my_gui -- process
+
+		struct my_gui_state_t {
+			int _count
+		}
+
+		func my_gui_state_t my_gui__init() impure {
+			send("a", "dec")
+			send("a", "dec")
+			send("a", "dec")
+			send("a", "stop")
+			return my_gui_state_t(1000)
+		}
+
+		func my_gui_state_t my_gui(my_gui_state_t state, json_value message) impure {
+			print("my_gui --- received: " + to_string(message) + ", state: " + to_string(state))
+
+			if(message == "inc"){
+				return update(state, "_count", state._count + 1)
+			}
+			else if(message == "dec"){
+				return update(state, "_count", state._count - 1)
+			}
+			else{
+				assert(false)
+			}
+		}
+
+
+		////////////////////////////////	my_audio -- process
+
+		struct my_audio_state_t {
+			int _audio
+		}
+
+		func my_audio_state_t my_audio__init() impure {
+			send("b", "process")
+			send("b", "process")
+			send("b", "stop")
+			return my_audio_state_t(0)
+		}
+
+		func my_audio_state_t my_audio(my_audio_state_t state, json_value message) impure {
+			print("my_audio --- received: " + to_string(message) + ", state: " + to_string(state))
+
+			if(message == "process"){
+				return update(state, "_audio", state._audio + 1)
+			}
+			else{
+				assert(false)
+			}
+		}
+
+	)";
+
+	const auto result = run_container2(test_ss3, {}, "iphone app", "");
+	QUARK_UT_VERIFY(result.empty());
+}
+
+QUARK_UNIT_TEST("software-system", "run two CONNECTED processes", "", ""){
+	const auto test_ss3 = R"(
+
+		software-system {
+			"name": "My Arcade Game",
+			"desc": "Space shooter for mobile devices, with connection to a server.",
+			"people": {},
+			"connections": [],
 			"containers": [
-				"gmail mail server",
-				"iphone app",
-				"Android app"
+				"iphone app"
 			]
 		}
 
-	)";
+		container-def {
+			"name": "iphone app",
+			"tech": "Swift, iOS, Xcode, Open GL",
+			"desc": "Mobile shooter game for iOS.",
+			"clocks": {
+				"main": {
+					"a": "my_gui",
+					"b": "my_audio",
+				}
+			}
+		}
+
+
+		////////////////////////////////	my_gui -- process
+
+		struct my_gui_state_t {
+			int _count
+		}
+
+		func my_gui_state_t my_gui__init() impure {
+			return my_gui_state_t(1000)
+		}
+
+		func my_gui_state_t my_gui(my_gui_state_t state, json_value message) impure {
+			print("my_gui --- received: " + to_string(message) + ", state: " + to_string(state))
+
+			if(message == "2"){
+				send("b", "3")
+				return update(state, "_count", state._count + 1)
+			}
+			else if(message == "4"){
+				send("a", "stop")
+				send("b", "stop")
+				return update(state, "_count", state._count + 10)
+			}
+			else{
+				assert(false)
+			}
+		}
+
+
+		////////////////////////////////	my_audio -- process
+
+		struct my_audio_state_t {
+			int _audio
+		}
+
+		func my_audio_state_t my_audio__init() impure {
+			send("b", "1")
+			return my_audio_state_t(0)
+		}
+
+		func my_audio_state_t my_audio(my_audio_state_t state, json_value message) impure {
+			print("my_audio --- received: " + to_string(message) + ", state: " + to_string(state))
+
+			if(message == "1"){
+				send("a", "2")
+				return update(state, "_audio", state._audio + 1)
+			}
+			else if(message == "3"){
+				send("a", "4")
+				return update(state, "_audio", state._audio + 4)
+			}
+			else{
+				assert(false)
+			}
+		}
+
+	)";
+
+	const auto result = run_container2(test_ss3, {}, "iphone app", "");
+	QUARK_UT_VERIFY(result.empty());
+}
+
+const auto k_typed_messages_container = R"(
+
+	software-system {
+		"name": "Telemetry",
+		"desc": "",
+		"people": {},
+		"connections": [],
+		"containers": [ "iphone app" ]
+	}
+
+	container-def {
+		"name": "iphone app",
+		"tech": "",
+		"desc": "",
+		"clocks": {
+			"main": {
+				"a": "producer",
+				"b": "consumer"
+			}
+		}
+	}
+
+	struct sample_t {
+		string name
+		[int] values
+	}
+
+	func int consumer__init() impure {
+		return 0
+	}
+
+	func int consumer(int state, sample_t message) impure {
+		if(state == 0){
+			assert(message.name == "first")
+			assert(message.values == [ 1, 2, 3 ])
+		}
+		else{
+			assert(message.name == "second")
+			assert(message.values == [ 10, 20 ])
+		}
+		return state + 1
+	}
+
+)";
+
+QUARK_UNIT_TEST("software-system", "send()", "struct message", "receiver gets the struct"){
+	const auto program = std::string() + k_typed_messages_container + R"(
+		func int producer__init() impure {
+			send("b", sample_t("first", [ 1, 2, 3 ]))
+			send("b", sample_t("second", [ 10, 20 ]))
+			send("b", "stop")
+			send("a", "stop")
+			return 0
+		}
+
+		func int producer(int state, json_value message) impure {
+			return state
+		}
+	)";
+	run_container2(program, {}, "iphone app", "");
+}
+
+QUARK_UNIT_TEST("software-system", "process state", "big state kept across 1000 messages", ""){
+	run_container2(R"(
+		software-system {
+			"name": "World",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "iphone app" ]
+		}
+
+		container-def {
+			"name": "iphone app",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"main": {
+					"a": "world"
+				}
+			}
+		}
+
+		struct world_t {
+			int ticks
+			[int] cells
+		}
+
+		func world_t world__init() impure {
+			mutable [int] cells = []
+			for(i in 0 ..< 10000){
+				cells = push_back(cells, i)
+			}
+			for(i in 0 ..< 1000){
+				send("a", "tick")
+			}
+			send("a", "check")
+			send("a", "stop")
+			return world_t(0, cells)
+		}
+
+		func world_t world(world_t state, string message) impure {
+			if(message == "tick"){
+				let index = state.ticks * 7
+				return world_t(state.ticks + 1, update(state.cells, index, state.cells[index] + 1))
+			}
+			else{
+				assert(state.ticks == 1000)
+				assert(size(state.cells) == 10000)
+				assert(state.cells[6993] == 6994)
+				assert(state.cells[6994] == 6994)
+				return state
+			}
+		}
+	)", {}, "iphone app", "");
+}
+
+QUARK_UNIT_TEST("software-system", "clocks", "processes on one clock get messages in tick order", ""){
+	run_container2(R"(
+		software-system {
+			"name": "Clocks",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "iphone app" ]
+		}
+
+		container-def {
+			"name": "iphone app",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"main": {
+					"a": "pa",
+					"b": "pb"
+				},
+				"other": {
+					"c": "pc"
+				}
+			}
+		}
+
+		func [string] pa__init() impure {
+			send("b", "x")
+			return []
+		}
+
+		//	Tick 1: "y" from b's init. "from_c" comes from another clock, any tick.
+		func [string] pa([string] state, string message) impure {
+			let state2 = push_back(state, message)
+			if(message == "y"){
+				send("b", "z")
+			}
+			if(size(state2) == 2){
+				send("a", "stop")
+			}
+			return state2
+		}
+
+		func [string] pb__init() impure {
+			send("a", "y")
+			return []
+		}
+
+		//	Tick 1: "x" from a's init. Tick 2: "z", which a sent during tick 1.
+		func [string] pb([string] state, string message) impure {
+			let state2 = push_back(state, message)
+			if(size(state2) == 2){
+				assert(state2 == [ "x", "z" ])
+				send("b", "stop")
+			}
+			return state2
+		}
+
+		func int pc__init() impure {
+			send("a", "from_c")
+			send("c", "stop")
+			return 0
+		}
 
-	run_closed(test_ss);
+		func int pc(int state, string message) impure {
+			return state
+		}
+	)", {}, "iphone app", "");
 }
 
-QUARK_UNIT_TEST("software-system", "run one process", "", ""){
-	const auto test_ss2 = R"(
-
+QUARK_UNIT_TEST("software-system", "clocks", "timer ticks", ""){
+	run_container2(R"(
 		software-system {
-			"name": "My Arcade Game",
-			"desc": "Space shooter for mobile devices, with connection to a server.",
+			"name": "Clocks",
+			"desc": "",
 			"people": {},
 			"connections": [],
 			"containers": [ "iphone app" ]
@@ -4307,217 +5844,458 @@ QUARK_UNIT_TEST("software-system", "run one process", "", ""){
 
 		container-def {
 			"name": "iphone app",
-			"tech": "Swift, iOS, Xcode, Open GL",
-			"desc": "Mobile shooter game for iOS.",
+			"tech": "",
+			"desc": "",
 			"clocks": {
-				"main": {
-					"a": "my_gui"
+				"render": {
+					"timer": { "period_ms": 1 },
+					"r": "renderer"
+				},
+				"audio": {
+					"timer": { "period_ms": 0.5, "realtime": true, "cpu": 0 },
+					"m": "mixer"
 				}
 			}
 		}
 
-		struct my_gui_state_t {
-			int _count
+		func int renderer__init() impure {
+			return 0
 		}
 
-		func my_gui_state_t my_gui__init() impure {
-			send("a", "dec")
-			send("a", "dec")
-			send("a", "dec")
-			send("a", "dec")
-			send("a", "stop")
-			return my_gui_state_t(1000)
+		func int renderer(int frames, json_value message) impure {
+			assert(message == "tick")
+			if(frames == 19){
+				send("r", "stop")
+			}
+			return frames + 1
 		}
 
-		func my_gui_state_t my_gui(my_gui_state_t state, json_value message){
-			print("received: " + to_string(message) + ", state: " + to_string(state))
+		func int mixer__init() impure {
+			return 0
+		}
 
-			if(message == "inc"){
-				return update(state, "_count", state._count + 1)
-			}
-			else if(message == "dec"){
-				return update(state, "_count", state._count - 1)
+		//	Also gets a message from the render clock.
+		func int mixer(int buffers, string message) impure {
+			if(buffers == 9){
+				send("r", "tick")
 			}
-			else{
-				assert(false)
+			if(buffers == 29){
+				send("m", "stop")
 			}
+			return message == "tick" ? buffers + 1 : buffers
 		}
+	)", {}, "iphone app", "");
+}
+
+//	The dedicated clock runs its init right away, that send() must reach a clock on the scheduler.
+QUARK_UNIT_TEST("software-system", "clocks", "send from dedicated clock's init", ""){
+	for(int i = 0 ; i < 10 ; i++){
+		run_container2(R"(
+			software-system {
+				"name": "Clocks",
+				"desc": "",
+				"people": {},
+				"connections": [],
+				"containers": [ "iphone app" ]
+			}
 
-	)";
+			container-def {
+				"name": "iphone app",
+				"tech": "",
+				"desc": "",
+				"clocks": {
+					"audio": {
+						"timer": { "period_ms": 5, "cpu": 0 },
+						"m": "mixer"
+					},
+					"main": {
+						"g": "gui"
+					}
+				}
+			}
 
-	const auto result = run_container2(test_ss2, {}, "iphone app", "");
-	QUARK_UT_VERIFY(result.empty());
-}
+			func int mixer__init() impure {
+				send("g", "hello")
+				return 0
+			}
 
-QUARK_UNIT_TEST("software-system", "run two unconnected processs", "", ""){
-	const auto test_ss3 = R"(
+			func int mixer(int buffers, string message) impure {
+				return buffers + 1
+			}
+
+			func int gui__init() impure {
+				return 0
+			}
+
+			func int gui(int count, string message) impure {
+				assert(message == "hello")
+				send("m", "stop")
+				send("g", "stop")
+				return count + 1
+			}
+		)", {}, "iphone app", "");
+	}
+}
 
+std::string make_inbox_test_program(const std::string& clocks, const std::string& inbox, const std::string& code){
+	return std::string() + R"(
 		software-system {
-			"name": "My Arcade Game",
-			"desc": "Space shooter for mobile devices, with connection to a server.",
+			"name": "Inboxes",
+			"desc": "",
 			"people": {},
 			"connections": [],
-			"containers": [
-				"iphone app"
-			]
+			"containers": [ "iphone app" ]
 		}
 
 		container-def {
 			"name": "iphone app",
-			"tech": "Swift, iOS, Xcode, Open GL",
-			"desc": "Mobile shooter game for iOS.",
-			"clocks": {
-				"main": {
-					"a": "my_gui",
-					"b": "my_audio"
-				}
-			}
+			"tech": "",
+			"desc": "",
+			"clocks": )" + clocks + R"(,
+			"inboxes": { "c": )" + inbox + R"( }
 		}
 
-		////////////////////////////////	my_gui -- process
-
-		struct my_gui_state_t {
-			int _count
+		//	Sends 10 messages to c in one go, then -1 in the next tick.
+		func int producer__init() impure {
+			for(i in 0 ..< 10){
+				send("c", i)
+			}
+			send("p", "next")
+			return 0
 		}
 
-		func my_gui_state_t my_gui__init() impure {
-			send("a", "dec")
-			send("a", "dec")
-			send("a", "dec")
-			send("a", "stop")
-			return my_gui_state_t(1000)
+		func int producer(int state, string message) impure {
+			send("c", 0 - 1)
+			return state
 		}
 
-		func my_gui_state_t my_gui(my_gui_state_t state, json_value message) impure {
-			print("my_gui --- received: " + to_string(message) + ", state: " + to_string(state))
-
-			if(message == "inc"){
-				return update(state, "_count", state._count + 1)
-			}
-			else if(message == "dec"){
-				return update(state, "_count", state._count - 1)
-			}
-			else{
-				assert(false)
-			}
-		}
+	)" + code;
+}
 
+//	Producer and consumer on the same clock: the whole burst lands in c's inbox before c runs.
+const std::string k_inbox_test_one_clock = R"({ "main": { "p": "producer", "c": "consumer" } })";
 
-		////////////////////////////////	my_audio -- process
+const std::string k_inbox_test_consumer = R"(
+	func int consumer__init() impure {
+		return 0
+	}
 
-		struct my_audio_state_t {
-			int _audio
+	func int consumer(int count, int message) impure {
+		if(message == 0 - 1){
+			assert(count == size(expected))
+			send("c", "stop")
+			send("p", "stop")
+			return count
 		}
-
-		func my_audio_state_t my_audio__init() impure {
-			send("b", "process")
-			send("b", "process")
-			send("b", "stop")
-			return my_audio_state_t(0)
+		else{
+			assert(message == expected[count])
+			return count + 1
 		}
+	}
+)";
 
-		func my_audio_state_t my_audio(my_audio_state_t state, json_value message) impure {
-			print("my_audio --- received: " + to_string(message) + ", state: " + to_string(state))
+QUARK_UNIT_TEST("software-system", "inboxes", "drop_newest", ""){
+	run_container2(
+		make_inbox_test_program(k_inbox_test_one_clock, R"({ "capacity": 4, "policy": "drop_newest" })", "let expected = [ 0, 1, 2, 3 ]" + k_inbox_test_consumer),
+		{}, "iphone app", ""
+	);
+}
 
-			if(message == "process"){
-				return update(state, "_audio", state._audio + 1)
-			}
-			else{
-				assert(false)
-			}
+QUARK_UNIT_TEST("software-system", "inboxes", "drop_oldest", ""){
+	run_container2(
+		make_inbox_test_program(k_inbox_test_one_clock, R"({ "capacity": 4, "policy": "drop_oldest" })", "let expected = [ 6, 7, 8, 9 ]" + k_inbox_test_consumer),
+		{}, "iphone app", ""
+	);
+}
+
+QUARK_UNIT_TEST("software-system", "inboxes", "coalesce", "equal messages replace each other"){
+	const auto program = make_inbox_test_program(k_inbox_test_one_clock, R"({ "capacity": 100, "policy": "coalesce" })", R"(
+		func int consumer__init() impure {
+			send("c", 5)
+			send("c", 7)
+			send("c", 5)
+			send("c", 0 - 1)
+			return 0
 		}
 
-	)";
+		//	Tick 1 has 5, 7, -1 from our init and then the producer's burst: 0 ... 9 where 5 and 7 were already waiting.
+		func int consumer(int count, int message) impure {
+			let expected = [ 5, 7, 0 - 1, 0, 1, 2, 3, 4, 6, 8, 9, 0 - 1 ]
+			assert(message == expected[count])
+			if(count == size(expected) - 1){
+				send("c", "stop")
+				send("p", "stop")
+			}
+			return count + 1
+		}
+	)");
+	run_container2(program, {}, "iphone app", "");
+}
 
-	const auto result = run_container2(test_ss3, {}, "iphone app", "");
-	QUARK_UT_VERIFY(result.empty());
+QUARK_UNIT_TEST("software-system", "inboxes", "block", "sender on the same clock can't wait, drops newest"){
+	run_container2(
+		make_inbox_test_program(k_inbox_test_one_clock, R"({ "capacity": 4, "policy": "block" })", "let expected = [ 0, 1, 2, 3 ]" + k_inbox_test_consumer),
+		{}, "iphone app", ""
+	);
 }
 
-QUARK_UNIT_TEST("software-system", "run two CONNECTED processes", "", ""){
-	const auto test_ss3 = R"(
+QUARK_UNIT_TEST("software-system", "inboxes", "block", "sender on another clock waits, nothing is lost"){
+	run_container2(
+		make_inbox_test_program(
+			R"({ "a": { "p": "producer" }, "b": { "c": "consumer" } })",
+			R"({ "capacity": 2, "policy": "block" })",
+			"let expected = [ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 ]" + k_inbox_test_consumer
+		),
+		{}, "iphone app", ""
+	);
+}
 
+std::string make_batch_test_program(const std::string& batches, const std::string& code){
+	return std::string() + R"(
 		software-system {
-			"name": "My Arcade Game",
-			"desc": "Space shooter for mobile devices, with connection to a server.",
+			"name": "Batches",
+			"desc": "",
 			"people": {},
 			"connections": [],
-			"containers": [
-				"iphone app"
-			]
+			"containers": [ "iphone app" ]
 		}
 
 		container-def {
 			"name": "iphone app",
-			"tech": "Swift, iOS, Xcode, Open GL",
-			"desc": "Mobile shooter game for iOS.",
-			"clocks": {
-				"main": {
-					"a": "my_gui",
-					"b": "my_audio",
-				}
-			}
+			"tech": "",
+			"desc": "",
+			"clocks": { "main": { "p": "producer", "c": "consumer" } },
+			"batches": )" + batches + R"(
 		}
 
-
-		////////////////////////////////	my_gui -- process
-
-		struct my_gui_state_t {
-			int _count
+		func int producer__init() impure {
+			for(i in 0 ..< 100){
+				send("c", i)
+			}
+			send("c", 0 - 1)
+			return 0
 		}
 
-		func my_gui_state_t my_gui__init() impure {
-			return my_gui_state_t(1000)
+		func int producer(int state, int message) impure {
+			return state
 		}
+	)" + code;
+}
 
-		func my_gui_state_t my_gui(my_gui_state_t state, json_value message) impure {
-			print("my_gui --- received: " + to_string(message) + ", state: " + to_string(state))
+const std::string k_batch_test_consumer = R"(
+	struct batch_state_t {
+		int sum
+		int calls
+	}
 
-			if(message == "2"){
-				send("b", "3")
-				return update(state, "_count", state._count + 1)
-			}
-			else if(message == "4"){
-				send("a", "stop")
-				send("b", "stop")
-				return update(state, "_count", state._count + 10)
+	func batch_state_t consumer__init() impure {
+		return batch_state_t(0, 0)
+	}
+
+	func batch_state_t consumer__batch(batch_state_t state, [int] messages) impure {
+		assert(size(messages) <= max_batch_size)
+		mutable sum = state.sum
+		for(i in 0 ..< size(messages)){
+			let m = messages[i]
+			if(m == 0 - 1){
+				assert(sum == 4950)
+				assert(state.calls + 1 == expected_calls)
+				send("c", "stop")
+				send("p", "stop")
 			}
 			else{
-				assert(false)
+				sum = sum + m
 			}
 		}
+		return batch_state_t(sum, state.calls + 1)
+	}
+)";
 
+QUARK_UNIT_TEST("software-system", "batches", "batch size from container-def", ""){
+	run_container2(
+		make_batch_test_program(R"({ "c": 16 })", "let max_batch_size = 16\nlet expected_calls = 7" + k_batch_test_consumer),
+		{}, "iphone app", ""
+	);
+}
 
-		////////////////////////////////	my_audio -- process
+QUARK_UNIT_TEST("software-system", "batches", "default batch size", ""){
+	run_container2(
+		make_batch_test_program(R"({})", "let max_batch_size = 64\nlet expected_calls = 2" + k_batch_test_consumer),
+		{}, "iphone app", ""
+	);
+}
 
-		struct my_audio_state_t {
-			int _audio
+QUARK_UNIT_TEST("software-system", "batches", "__batch takes other message type than process function", "exception"){
+	const auto program = make_batch_test_program(R"({})", R"(
+		func int consumer(int state, int message) impure {
+			return state
 		}
 
-		func my_audio_state_t my_audio__init() impure {
-			send("b", "1")
-			return my_audio_state_t(0)
+		func int consumer__batch(int state, [string] messages) impure {
+			return state
 		}
+	)");
+	try {
+		run_container2(program, {}, "iphone app", "");
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()) == "Function \"consumer__batch\" needs to take the state and a vector of int.");
+	}
+}
 
-		func my_audio_state_t my_audio(my_audio_state_t state, json_value message) impure {
-			print("my_audio --- received: " + to_string(message) + ", state: " + to_string(state))
+const std::string k_channel_test_container = R"(
+	software-system {
+		"name": "Channels",
+		"desc": "",
+		"people": {},
+		"connections": [],
+		"containers": [ "iphone app" ]
+	}
 
-			if(message == "1"){
-				send("a", "2")
-				return update(state, "_audio", state._audio + 1)
-			}
-			else if(message == "3"){
-				send("a", "4")
-				return update(state, "_audio", state._audio + 4)
-			}
-			else{
-				assert(false)
-			}
+	container-def {
+		"name": "iphone app",
+		"tech": "",
+		"desc": "",
+		"clocks": { "a": { "p": "producer" }, "b": { "c": "consumer" } }
+	}
+
+	func int consumer__init() impure {
+		return 0
+	}
+
+	func int consumer(int count, string message) impure {
+		assert(message == "hello")
+		if(count == 2){
+			send("c", "stop")
+			send(get_channel("p"), "stop")
+		}
+		return count + 1
+	}
+
+	func int producer(int state, string message) impure {
+		return state
+	}
+)";
+
+QUARK_UNIT_TEST("software-system", "send()", "process name, literal name and channel_t", ""){
+	const auto program = k_channel_test_container + R"(
+		let consumer_channel = get_channel("c")
+
+		func int producer__init() impure {
+			//	Resolved by the bytecode generator.
+			send("c", "hello")
+
+			//	Resolved at runtime.
+			let name = "c"
+			send(name, "hello")
+
+			send(consumer_channel, "hello")
+			return 0
 		}
+	)";
+	run_container2(program, {}, "iphone app", "");
+}
+
+QUARK_UNIT_TEST("", "get_channel()", "program defines its own get_channel()", "shadows host function"){
+	run_closed(R"(
+
+		func string get_channel(string name){
+			return "#" + name
+		}
+		assert(get_channel("news") == "#news")
+
+	)");
+}
 
+QUARK_UNIT_TEST("software-system", "get_channel()", "channel IDs follow get_channel_names()", ""){
+	const auto program = k_channel_test_container + R"(
+		func int producer__init() impure {
+			assert(get_channel("p") == channel_t(0))
+			assert(get_channel("c") == channel_t(1))
+			send("c", "hello")
+			send("c", "hello")
+			send("c", "hello")
+			return 0
+		}
 	)";
+	run_container2(program, {}, "iphone app", "");
+}
 
-	const auto result = run_container2(test_ss3, {}, "iphone app", "");
-	QUARK_UT_VERIFY(result.empty());
+QUARK_UNIT_TEST("software-system", "get_channel()", "unknown process", "exception"){
+	const auto program = k_channel_test_container + R"(
+		func int producer__init() impure {
+			let x = get_channel("nobody")
+			return 0
+		}
+	)";
+	try {
+		run_container2(program, {}, "iphone app", "");
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()) == "Unknown process \"nobody\".");
+	}
+}
+
+QUARK_UNIT_TEST("software-system", "send()", "destination is neither process name nor channel_t", "exception"){
+	const auto program = k_channel_test_container + R"(
+		func int producer__init() impure {
+			send(123, "hello")
+			return 0
+		}
+	)";
+	try {
+		run_container2(program, {}, "iphone app", "");
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()) == "Bad destination for send(). Require a process name or a channel_t.");
+	}
+}
+
+//	channel_t is its own type: a program's struct that looks like it isn't a channel.
+QUARK_UNIT_TEST("software-system", "send()", "destination is a struct with an int id", "exception"){
+	const auto program = k_channel_test_container + R"(
+		struct my_channel_t {
+			int id
+		}
+
+		func int producer__init() impure {
+			send(my_channel_t(1), "hello")
+			return 0
+		}
+	)";
+	try {
+		run_container2(program, {}, "iphone app", "");
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()) == "Bad destination for send(). Require a process name or a channel_t.");
+	}
+}
+
+QUARK_UNIT_TEST("software-system", "send()", "wrong message type", "exception"){
+	const auto program = std::string() + k_typed_messages_container + R"(
+		func int producer__init() impure {
+			send("a", "stop")
+			send("b", 1234)
+			return 0
+		}
+
+		func int producer(int state, json_value message) impure {
+			return state
+		}
+	)";
+	try {
+		run_container2(program, {}, "iphone app", "");
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		const auto what = std::string(e.what());
+		QUARK_UT_VERIFY(what.find("Process \"b\" takes messages of type ") == 0);
+		QUARK_UT_VERIFY(what.find("cannot send int.") != std::string::npos);
+	}
 }
 
 
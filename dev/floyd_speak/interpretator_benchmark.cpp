@@ -11,6 +11,7 @@
 #include "benchmark_basics.h"
 
 #include <string>
+#include <algorithm>
 
 using std::string;
 
@@ -261,6 +262,168 @@ void floyd_benchmark(){
 
 	}
 
+	//	The Floyd vectors are made by the global code, only sum() / dot() is measured.
+	const std::string numeric_vector_floyd_str = R"(
+		mutable [double] a = []
+		mutable [double] b = []
+		mutable x = 0.0
+		for(i in 0 ..< 1000000){
+			a = push_back(a, x)
+			b = push_back(b, 2.0 - x)
+			x = x + 0.001
+		}
+	)";
+
+	if(1){
+		std::vector<double> a;
+		for(int i = 0 ; i < 1000000 ; i++){
+			a.push_back(i * 0.001);
+		}
+		const auto cpp_func = [&] {
+			volatile double result = 0.0;
+			double acc = 0.0;
+			for(const auto e: a){
+				acc = acc + e;
+			}
+			result = acc;
+			(void)result;
+		};
+
+		const std::string floyd_str = numeric_vector_floyd_str + R"(
+			func double f(){
+				return sum(a)
+			}
+		)";
+
+		trace_result(bench_result_t{ "sum() of [double]",
+			measure_execution_time_ns(cpp_func, k_repeats),
+			measure_floyd_function_f(floyd_str, k_repeats)
+		});
+	}
+
+	if(1){
+		std::vector<double> a;
+		std::vector<double> b;
+		for(int i = 0 ; i < 1000000 ; i++){
+			a.push_back(i * 0.001);
+			b.push_back(2.0 - i * 0.001);
+		}
+		const auto cpp_func = [&] {
+			volatile double result = 0.0;
+			double acc = 0.0;
+			for(size_t i = 0 ; i < a.size() ; i++){
+				acc = acc + a[i] * b[i];
+			}
+			result = acc;
+			(void)result;
+		};
+
+		const std::string floyd_str = numeric_vector_floyd_str + R"(
+			func double f(){
+				return dot(a, b)
+			}
+		)";
+
+		trace_result(bench_result_t{ "dot() of [double]",
+			measure_execution_time_ns(cpp_func, k_repeats),
+			measure_floyd_function_f(floyd_str, k_repeats)
+		});
+	}
+
+	if(1){
+		std::vector<int64_t> a;
+		for(int64_t i = 0 ; i < 200000 ; i++){
+			a.push_back((i * 7919) % 200003);
+		}
+		const auto cpp_func = [&] {
+			auto b = a;
+			std::sort(b.begin(), b.end());
+		};
+
+		const std::string floyd_str = R"(
+			mutable [int] a = []
+			for(i in 0 ..< 200000){
+				a = push_back(a, (i * 7919) % 200003)
+			}
+			func [int] f(){
+				return sort(a)
+			}
+		)";
+
+		trace_result(bench_result_t{ "sort() of [int]",
+			measure_execution_time_ns(cpp_func, k_repeats),
+			measure_floyd_function_f(floyd_str, k_repeats)
+		});
+	}
+
+	if(1){
+		const auto cpp_func = [] {
+			std::string s;
+			for(int i = 0 ; i < 100000 ; i++){
+				s = s + "line ";
+			}
+			volatile auto size = s.size();
+			(void)size;
+		};
+
+		const std::string floyd_str = R"(
+			func int f(){
+				mutable s = ""
+				for(i in 0 ..< 100000){
+					s = s + "line "
+				}
+				return size(s)
+			}
+		)";
+
+		trace_result(bench_result_t{ "Build string with +",
+			measure_execution_time_ns(cpp_func, k_repeats),
+			measure_floyd_function_f(floyd_str, k_repeats)
+		});
+	}
+
+	if(1){
+		struct particle_t {
+			double x;
+			double y;
+		};
+		const auto cpp_func = [] {
+			std::vector<particle_t> particles;
+			for(int i = 0 ; i < 10000 ; i++){
+				particles.push_back(particle_t{ static_cast<double>(i), 1.0 });
+			}
+			double total = 0.0;
+			for(const auto& p: particles){
+				total = total + p.x * p.y;
+			}
+			volatile auto result = total;
+			(void)result;
+		};
+
+		const std::string floyd_str = R"(
+			struct particle_t { double x; double y }
+
+			func double f(){
+				mutable particles = [ particle_t(0.0, 1.0) ]
+				mutable x = 0.0
+				for(i in 1 ..< 10000){
+					x = x + 1.0
+					particles = push_back(particles, particle_t(x, 1.0))
+				}
+				mutable total = 0.0
+				for(i in 0 ..< size(particles)){
+					total = total + particles[i].x * particles[i].y
+				}
+				return total
+			}
+		)";
+
+		trace_result(bench_result_t{ "Vector of POD structs",
+			measure_execution_time_ns(cpp_func, k_repeats),
+			measure_floyd_function_f(floyd_str, k_repeats)
+		});
+	}
+
 }
 
 
@@ -0,0 +1,140 @@
+//
+//  eventcount.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-03-06.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "eventcount.h"
+
+#include "quark.h"
+
+#include <thread>
+#include <vector>
+#include <climits>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace floyd {
+
+
+eventcount_t::eventcount_t() :
+	_epoch(0),
+	_waiters(0)
+{
+}
+
+std::uint32_t eventcount_t::prepare_wait(){
+	_waiters.fetch_add(1, std::memory_order_seq_cst);
+	return _epoch.load(std::memory_order_seq_cst);
+}
+
+void eventcount_t::cancel_wait(){
+	_waiters.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+#ifdef __linux__
+
+void eventcount_t::wait(std::uint32_t key){
+	if(_epoch.load(std::memory_order_seq_cst) == key){
+		syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&_epoch), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+	}
+	_waiters.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+void eventcount_t::notify(bool all){
+	//	Pairs with prepare_wait(): the caller's work must be visible before we look for waiters.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(_waiters.load(std::memory_order_seq_cst) == 0){
+		return;
+	}
+
+	_epoch.fetch_add(1, std::memory_order_seq_cst);
+	syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&_epoch), FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, nullptr, nullptr, 0);
+}
+
+#else
+
+void eventcount_t::wait(std::uint32_t key){
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_cv.wait(lock, [&](){ return _epoch.load(std::memory_order_seq_cst) != key; });
+	}
+	_waiters.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+void eventcount_t::notify(bool all){
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(_waiters.load(std::memory_order_seq_cst) == 0){
+		return;
+	}
+
+	//	Bump under the mutex so a waiter can't miss it between checking the epoch and sleeping.
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_epoch.fetch_add(1, std::memory_order_seq_cst);
+	}
+	if(all){
+		_cv.notify_all();
+	}
+	else{
+		_cv.notify_one();
+	}
+}
+
+#endif
+
+void eventcount_t::notify_one(){
+	notify(false);
+}
+
+void eventcount_t::notify_all(){
+	notify(true);
+}
+
+
+
+QUARK_UNIT_TEST("eventcount_t", "notify_one()", "no waiters", ""){
+	eventcount_t ec;
+	ec.notify_one();
+	ec.notify_all();
+	const auto key = ec.prepare_wait();
+	ec.cancel_wait();
+	QUARK_UT_VERIFY(key == 0);
+}
+
+QUARK_UNIT_TEST("eventcount_t", "wait()", "ping pong between two threads", ""){
+	eventcount_t ec;
+	std::atomic<int> turn(0);
+	const int rounds = 2000;
+
+	//	Each thread waits for its turn, then hands the turn to the other.
+	const auto play = [&](int me){
+		for(int i = 0 ; i < rounds ; i++){
+			while(turn.load() % 2 != me){
+				const auto key = ec.prepare_wait();
+				if(turn.load() % 2 == me){
+					ec.cancel_wait();
+				}
+				else{
+					ec.wait(key);
+				}
+			}
+			turn++;
+			ec.notify_all();
+		}
+	};
+
+	std::thread other([&](){ play(1); });
+	play(0);
+	other.join();
+	QUARK_UT_VERIFY(turn == rounds * 2);
+}
+
+
+}
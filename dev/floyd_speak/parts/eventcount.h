@@ -0,0 +1,81 @@
+//
+//  eventcount.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-03-06.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef eventcount_h
+#define eventcount_h
+
+/*
+	Lets threads sleep until "something happened", without a mutex on the notify side.
+
+	Waiter:
+		while(true){
+			if(try_get_work()) ...
+			const auto key = ec.prepare_wait();
+			if(have_work_now()){
+				ec.cancel_wait();
+			}
+			else{
+				ec.wait(key);
+			}
+		}
+
+	Notifier:
+		publish_work();
+		ec.notify_one();
+
+	The re-check between prepare_wait() and wait() is what makes this safe: either the waiter sees the work,
+	or notify sees the waiter and bumps the epoch so wait() returns. notify_one() / notify_all() is a single
+	atomic load when nobody sleeps.
+
+	On Linux wait() sleeps on a futex on the epoch. Elsewhere it falls back to a mutex + condition variable,
+	which is only touched when there are sleepers.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+
+namespace floyd {
+
+
+struct eventcount_t {
+	public: eventcount_t();
+	public: eventcount_t(const eventcount_t& other) = delete;
+	public: eventcount_t& operator=(const eventcount_t& other) = delete;
+
+	public: std::uint32_t prepare_wait();
+	public: void cancel_wait();
+
+	//	Returns once the epoch has moved on from key. Can return spuriously: always re-check.
+	public: void wait(std::uint32_t key);
+
+	public: void notify_one();
+	public: void notify_all();
+
+
+	////////////////////////		INTERNALS
+
+	private: void notify(bool all);
+
+
+	////////////////////////		STATE
+
+	private: std::atomic<std::uint32_t> _epoch;
+	private: std::atomic<int> _waiters;
+
+#ifndef __linux__
+	private: std::mutex _mutex;
+	private: std::condition_variable _cv;
+#endif
+};
+
+
+}
+
+#endif /* eventcount_h */
@@ -13,11 +13,16 @@
 #include <string>
 #include <thread>
 #include <cmath>
+#include <algorithm>
 #include <cpuid.h>
 
 #include <stdio.h>
 #include <sys/types.h>
+#ifdef __APPLE__
 #include <sys/sysctl.h>
+#else
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -211,6 +216,65 @@ int sched_getaffinity(pid_t pid, size_t cpu_size, cpu_set_t *cpu_set){
 
   return 0;
 }
+
+#else
+
+namespace floyd {
+
+//	No sysctl: use sysconf() and leave what it can't tell us as 0.
+static std::size_t sysconf_size(int name){
+	const auto r = sysconf(name);
+	return r > 0 ? static_cast<std::size_t>(r) : 0;
+}
+
+hardware_info_t read_hardware_info(){
+	const auto logical_count = std::max(1u, std::thread::hardware_concurrency());
+#ifdef _SC_LEVEL1_DCACHE_LINESIZE
+	const auto cacheline_size = sysconf_size(_SC_LEVEL1_DCACHE_LINESIZE);
+#else
+	const std::size_t cacheline_size = 0;
+#endif
+
+	return {
+		._cpu_type = 0,
+		._cpu_type_subtype = 0,
+
+		._processor_packages = 1,
+
+		._physical_processor_count = logical_count,
+		._logical_processor_count = logical_count,
+
+		._cpu_freq_hz = 0,
+		._bus_freq_hz = 0,
+
+		._mem_size = sysconf_size(_SC_PHYS_PAGES) * sysconf_size(_SC_PAGESIZE),
+		._page_size = sysconf_size(_SC_PAGESIZE),
+		._cacheline_size = cacheline_size >= 16 ? cacheline_size : 64,
+		._scalar_align = alignof(std::max_align_t),
+
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+		._l1_data_cache_size = sysconf_size(_SC_LEVEL1_DCACHE_SIZE),
+		._l1_instruction_cache_size = sysconf_size(_SC_LEVEL1_ICACHE_SIZE),
+		._l2_cache_size = sysconf_size(_SC_LEVEL2_CACHE_SIZE),
+		._l3_cache_size = sysconf_size(_SC_LEVEL3_CACHE_SIZE)
+#else
+		._l1_data_cache_size = 0,
+		._l1_instruction_cache_size = 0,
+		._l2_cache_size = 0,
+		._l3_cache_size = 0
+#endif
+	};
+}
+
+QUARK_UNIT_TEST("","read_hardware_info()", "", ""){
+	const auto a = read_hardware_info();
+	QUARK_UT_VERIFY(a._logical_processor_count > 0);
+	QUARK_UT_VERIFY(a._cacheline_size >= 16);
+	QUARK_UT_VERIFY(a._scalar_align >= 4);
+}
+
+}
+
 #endif
 
 /*
@@ -0,0 +1,87 @@
+//
+//  mpsc_queue.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-03-06.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "mpsc_queue.h"
+
+#include <thread>
+#include <string>
+
+namespace floyd {
+
+
+QUARK_UNIT_TEST("mpsc_queue_t", "pop()", "empty", ""){
+	mpsc_queue_t<std::string> q;
+	std::string s;
+	QUARK_UT_VERIFY(q.empty());
+	QUARK_UT_VERIFY(q.pop(s) == false);
+}
+
+QUARK_UNIT_TEST("mpsc_queue_t", "pop()", "FIFO", ""){
+	mpsc_queue_t<std::string> q;
+	q.push("a");
+	q.push("b");
+	q.push("c");
+
+	std::string s;
+	QUARK_UT_VERIFY(q.pop(s) && s == "a");
+	QUARK_UT_VERIFY(q.pop(s) && s == "b");
+	QUARK_UT_VERIFY(q.pop(s) && s == "c");
+	QUARK_UT_VERIFY(q.empty());
+}
+
+QUARK_UNIT_TEST("mpsc_queue_t", "pop_batch()", "", ""){
+	mpsc_queue_t<int> q;
+	for(int i = 0 ; i < 10 ; i++){
+		q.push(i);
+	}
+	std::vector<int> out;
+	QUARK_UT_VERIFY(q.pop_batch(out, 4) == 4);
+	QUARK_UT_VERIFY(q.pop_batch(out, 100) == 6);
+	QUARK_UT_VERIFY((out == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+}
+
+QUARK_UNIT_TEST("mpsc_queue_t", "push()", "4 producers", "each producer's values arrive in order"){
+	const int producer_count = 4;
+	const int per_producer = 20000;
+	mpsc_queue_t<int> q;
+
+	std::vector<std::thread> producers;
+	for(int p = 0 ; p < producer_count ; p++){
+		producers.push_back(std::thread([&q, p](){
+			for(int i = 0 ; i < per_producer ; i++){
+				q.push(p * per_producer + i);
+			}
+		}));
+	}
+
+	std::vector<int> next(producer_count, 0);
+	int received = 0;
+	bool in_order = true;
+	std::vector<int> batch;
+	while(received < producer_count * per_producer){
+		batch.clear();
+		q.pop_batch(batch, 64);
+		for(const auto v: batch){
+			const auto p = v / per_producer;
+			if(v % per_producer != next[p]){
+				in_order = false;
+			}
+			next[p]++;
+		}
+		received += static_cast<int>(batch.size());
+	}
+
+	for(auto& t: producers){
+		t.join();
+	}
+	QUARK_UT_VERIFY(in_order);
+	QUARK_UT_VERIFY(q.empty());
+}
+
+
+}
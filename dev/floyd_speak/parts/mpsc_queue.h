@@ -0,0 +1,110 @@
+//
+//  mpsc_queue.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-03-06.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef mpsc_queue_h
+#define mpsc_queue_h
+
+/*
+	Lock-free FIFO queue with many producers and ONE consumer. Used as process inbox.
+
+	push() is wait-free: one atomic exchange + one store, no matter how many threads push at once.
+	pop() and pop_batch() never block and never take a lock. They may only be called by one thread at a time,
+	but that thread can change over time if there is a happens-before between the consumers, like when the
+	process_scheduler_t moves a process to another worker.
+
+	A push() that is half-way done (exchanged but not linked yet) is invisible to the consumer until it
+	completes. So after push() returns the value is guaranteed visible, which is what matters for anyone
+	that wakes the consumer after pushing.
+
+	This is Dmitry Vyukov's node-based MPSC queue: the consumer's _tail always points to a dummy node and
+	the value is moved out of the node after it, which then becomes the new dummy.
+*/
+
+#include <atomic>
+#include <vector>
+#include <utility>
+
+#include "quark.h"
+
+namespace floyd {
+
+
+template <typename T> struct mpsc_queue_t {
+	public: mpsc_queue_t() :
+		_head(new node_t()),
+		_tail(_head.load())
+	{
+	}
+
+	public: ~mpsc_queue_t(){
+		T temp;
+		while(pop(temp)){
+		}
+		delete _tail;
+	}
+
+	public: mpsc_queue_t(const mpsc_queue_t& other) = delete;
+	public: mpsc_queue_t& operator=(const mpsc_queue_t& other) = delete;
+
+	//	Any thread.
+	public: void push(T value){
+		auto node = new node_t();
+		node->_value = std::move(value);
+		const auto prev = _head.exchange(node, std::memory_order_acq_rel);
+		prev->_next.store(node, std::memory_order_release);
+	}
+
+	//	Consumer only. Returns false if the queue is empty.
+	public: bool pop(T& out){
+		const auto tail = _tail;
+		const auto next = tail->_next.load(std::memory_order_acquire);
+		if(next == nullptr){
+			return false;
+		}
+		out = std::move(next->_value);
+		next->_value = T();
+		_tail = next;
+		delete tail;
+		return true;
+	}
+
+	//	Consumer only. Moves up to max_count values to the end of out, in FIFO order. Returns the count.
+	public: int pop_batch(std::vector<T>& out, int max_count){
+		QUARK_ASSERT(max_count >= 0);
+
+		int count = 0;
+		T temp;
+		while(count < max_count && pop(temp)){
+			out.push_back(std::move(temp));
+			count++;
+		}
+		return count;
+	}
+
+	//	Consumer only.
+	public: bool empty() const {
+		return _tail->_next.load(std::memory_order_acquire) == nullptr;
+	}
+
+
+	////////////////////////		STATE
+
+	private: struct node_t {
+		std::atomic<node_t*> _next { nullptr };
+		T _value;
+	};
+
+	//	Producers append here. Separate cache line from the consumer's end.
+	private: alignas(64) std::atomic<node_t*> _head;
+	private: alignas(64) node_t* _tail;
+};
+
+
+}
+
+#endif /* mpsc_queue_h */
@@ -0,0 +1,472 @@
+//
+//  process_scheduler.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-03-04.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "process_scheduler.h"
+
+#include "hardware_caps.h"
+#include "quark.h"
+
+#include <algorithm>
+
+namespace floyd {
+
+
+//	Which scheduler + worker the current thread belongs to. Null / -1 on threads not owned by a scheduler.
+static thread_local const process_scheduler_t* tl_scheduler = nullptr;
+static thread_local int tl_worker_index = -1;
+
+
+process_scheduler_t::process_scheduler_t(int worker_count) :
+	_f(nullptr),
+	_process_count(0),
+	_queued_count(0),
+	_live_count(0),
+	_next_worker(0),
+	_stop(false),
+	_aborted(false)
+{
+	QUARK_ASSERT(worker_count > 0);
+
+	for(int i = 0 ; i < worker_count ; i++){
+		_workers.push_back(std::make_unique<worker_t>());
+	}
+	for(int i = 0 ; i < worker_count ; i++){
+		_workers[i]->_thread = std::thread([this, i](){ worker_loop(i); });
+	}
+}
+
+process_scheduler_t::~process_scheduler_t(){
+	_stop = true;
+	_wake.notify_all();
+
+	for(auto& w: _workers){
+		w->_thread.join();
+	}
+}
+
+int process_scheduler_t::get_worker_count() const {
+	return static_cast<int>(_workers.size());
+}
+
+void process_scheduler_t::run(int process_count, const run_slice_f& f, const started_f& started){
+	QUARK_ASSERT(process_count >= 0);
+	QUARK_ASSERT(_f == nullptr);
+
+	if(process_count == 0){
+		if(started){
+			started();
+		}
+
+		std::exception_ptr exception;
+		{
+			std::lock_guard<std::mutex> lock(_done_mutex);
+			std::swap(exception, _exception);
+			_aborted = false;
+		}
+		if(exception){
+			std::rethrow_exception(exception);
+		}
+		return;
+	}
+
+	//	Everybody starts out queued, to get their first slice. The states must be queued before notify() and abort()
+	//	can see them, or they would queue / terminate a process that is about to be queued.
+	_f = &f;
+	_process_states = std::make_unique<std::atomic<int>[]>(process_count);
+	for(int process_index = 0 ; process_index < process_count ; process_index++){
+		_process_states[process_index] = k_queued;
+	}
+	_process_count = process_count;
+	{
+		std::lock_guard<std::mutex> lock(_done_mutex);
+		_live_count = process_count;
+	}
+
+	//	Spread them round-robin. Only these pushes queue the processes: notify() sees k_queued and does nothing.
+	const auto worker_count = get_worker_count();
+	for(int process_index = 0 ; process_index < process_count ; process_index++){
+		auto& w = *_workers[process_index % worker_count];
+		std::lock_guard<std::mutex> lock(w._mutex);
+		w._run_queue.push_back(process_index);
+	}
+	_queued_count += process_count;
+	_wake.notify_all();
+
+	if(started){
+		try {
+			started();
+		}
+		catch(...){
+			abort(std::current_exception());
+		}
+	}
+
+	std::exception_ptr exception;
+	{
+		std::unique_lock<std::mutex> lock(_done_mutex);
+		_done.wait(lock, [&](){ return _live_count == 0; });
+		exception = _exception;
+		_exception = nullptr;
+		_aborted = false;
+	}
+
+	_process_count = 0;
+	_f = nullptr;
+
+	if(exception){
+		std::rethrow_exception(exception);
+	}
+}
+
+void process_scheduler_t::cancel(std::exception_ptr e){
+	{
+		std::lock_guard<std::mutex> lock(_done_mutex);
+
+		//	No run() going: remember it for the next one. Its processes are terminated as they are popped.
+		if(_live_count == 0){
+			if(!_exception){
+				_exception = e;
+			}
+			_aborted = true;
+			return;
+		}
+	}
+	abort(e);
+}
+
+void process_scheduler_t::notify(int process_index){
+	QUARK_ASSERT(process_index >= 0);
+
+	if(process_index >= _process_count){
+		return;
+	}
+
+	auto& s = _process_states[process_index];
+	int state = s.load();
+	while(true){
+		if(state == k_idle){
+			if(s.compare_exchange_weak(state, k_queued)){
+				enqueue(tl_scheduler == this ? tl_worker_index : -1, process_index);
+				return;
+			}
+		}
+		else if(state == k_running){
+			if(s.compare_exchange_weak(state, k_running_notified)){
+				return;
+			}
+		}
+
+		//	Already queued, already notified or terminated.
+		else{
+			return;
+		}
+	}
+}
+
+void process_scheduler_t::enqueue(int worker_index, int process_index){
+	const auto worker_count = get_worker_count();
+	const auto worker_index2 = worker_index != -1 ? worker_index : static_cast<int>(_next_worker++ % worker_count);
+	{
+		auto& w = *_workers[worker_index2];
+		std::lock_guard<std::mutex> lock(w._mutex);
+		w._run_queue.push_back(process_index);
+	}
+	_queued_count++;
+	_wake.notify_one();
+}
+
+void process_scheduler_t::worker_loop(int worker_index){
+	tl_scheduler = this;
+	tl_worker_index = worker_index;
+
+	while(true){
+		if(try_run_one(worker_index) == false){
+			const auto key = _wake.prepare_wait();
+			if(_stop || _queued_count > 0){
+				_wake.cancel_wait();
+				if(_stop && _queued_count == 0){
+					return;
+				}
+			}
+			else{
+				_wake.wait(key);
+			}
+		}
+	}
+}
+
+bool process_scheduler_t::try_run_one(int worker_index){
+	const auto worker_count = get_worker_count();
+
+	//	Own queue first, oldest process. Then steal the newest process from the others.
+	for(int i = 0 ; i < worker_count ; i++){
+		auto& victim = *_workers[(worker_index + i) % worker_count];
+
+		int process_index = -1;
+		{
+			std::lock_guard<std::mutex> lock(victim._mutex);
+			if(victim._run_queue.empty() == false){
+				if(i == 0){
+					process_index = victim._run_queue.front();
+					victim._run_queue.pop_front();
+				}
+				else{
+					process_index = victim._run_queue.back();
+					victim._run_queue.pop_back();
+				}
+			}
+		}
+		if(process_index != -1){
+			_queued_count--;
+			if(_aborted){
+				finish(process_index);
+			}
+			else{
+				run_slice(worker_index, process_index);
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+void process_scheduler_t::run_slice(int worker_index, int process_index){
+	auto& s = _process_states[process_index];
+	QUARK_ASSERT(s == k_queued);
+	s = k_running;
+
+	auto result = slice_result::k_done;
+	try {
+		result = (*_f)(worker_index, process_index);
+	}
+	catch(...){
+		abort(std::current_exception());
+		result = slice_result::k_done;
+	}
+
+	if(result == slice_result::k_done || _aborted){
+		finish(process_index);
+	}
+	else if(result == slice_result::k_yield){
+		s = k_queued;
+		enqueue(worker_index, process_index);
+	}
+	else{
+		//	A notify() came in while we were running: run again, the process may not have seen that work.
+		int expected = k_running;
+		if(s.compare_exchange_strong(expected, k_idle) == false){
+			QUARK_ASSERT(expected == k_running_notified);
+			s = k_queued;
+			enqueue(worker_index, process_index);
+		}
+
+		//	abort() may have swept the states before we went idle.
+		else if(_aborted){
+			finish_if_idle(process_index);
+		}
+	}
+}
+
+void process_scheduler_t::finish(int process_index){
+	_process_states[process_index] = k_done;
+
+	std::lock_guard<std::mutex> lock(_done_mutex);
+	_live_count--;
+	if(_live_count == 0){
+		_done.notify_all();
+	}
+}
+
+//	Idle processes will never be popped from a run queue again, terminate them here. Queued and running processes
+//	are terminated by the worker that pops them / finishes their slice.
+void process_scheduler_t::abort(std::exception_ptr e){
+	{
+		std::lock_guard<std::mutex> lock(_done_mutex);
+		if(!_exception){
+			_exception = e;
+		}
+	}
+	_aborted = true;
+
+	for(int process_index = 0 ; process_index < _process_count ; process_index++){
+		finish_if_idle(process_index);
+	}
+}
+
+void process_scheduler_t::finish_if_idle(int process_index){
+	int expected = k_idle;
+	if(_process_states[process_index].compare_exchange_strong(expected, k_done)){
+		std::lock_guard<std::mutex> lock(_done_mutex);
+		_live_count--;
+		if(_live_count == 0){
+			_done.notify_all();
+		}
+	}
+}
+
+
+int get_process_worker_count(int process_count){
+	const auto hardware_threads = static_cast<int>(read_hardware_info()._logical_processor_count);
+	return std::max(1, std::min(hardware_threads, process_count));
+}
+
+
+
+QUARK_UNIT_TEST("process_scheduler_t", "run()", "each process gets a first slice", ""){
+	process_scheduler_t scheduler(3);
+	std::vector<int> result(100, 0);
+	scheduler.run(100, [&](int worker_index, int process_index){
+		result[process_index]++;
+		return process_scheduler_t::slice_result::k_done;
+	});
+	QUARK_UT_VERIFY(std::count(result.begin(), result.end(), 1) == 100);
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "notify()", "ring of processes passing a token", ""){
+	//	Process i hands the token to process i + 1, 1000 times around a ring of 50 processes.
+	const int process_count = 50;
+	process_scheduler_t scheduler(4);
+	std::vector<int> tokens(process_count, 0);
+	std::vector<int> received(process_count, 0);
+	std::mutex tokens_mutex;
+	tokens[0] = 1;
+
+	scheduler.run(process_count, [&](int worker_index, int process_index){
+		int token = 0;
+		{
+			std::lock_guard<std::mutex> lock(tokens_mutex);
+			std::swap(token, tokens[process_index]);
+		}
+		if(token == 0){
+			return process_scheduler_t::slice_result::k_idle;
+		}
+
+		received[process_index]++;
+		const auto next = (process_index + 1) % process_count;
+		if(received[process_index] < 1000 || next != 0){
+			{
+				std::lock_guard<std::mutex> lock(tokens_mutex);
+				tokens[next] = 1;
+			}
+			scheduler.notify(next);
+		}
+		return received[process_index] == 1000 ? process_scheduler_t::slice_result::k_done : process_scheduler_t::slice_result::k_idle;
+	});
+	QUARK_UT_VERIFY(std::count(received.begin(), received.end(), 1000) == process_count);
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "notify()", "process never runs on two workers at once", ""){
+	const int process_count = 8;
+	process_scheduler_t scheduler(4);
+	std::vector<std::atomic<int>> busy(process_count);
+	std::vector<std::atomic<int>> work(process_count);
+	std::atomic<int> consumed(0);
+	std::atomic<int> overlaps(0);
+	std::atomic<bool> produced_all(false);
+
+	std::thread producer;
+	std::once_flag producer_started;
+
+	scheduler.run(process_count, [&](int worker_index, int process_index){
+		//	notify() needs run() to be going, start producing from inside the first slice.
+		std::call_once(producer_started, [&](){
+			producer = std::thread([&](){
+				for(int i = 0 ; i < 10000 ; i++){
+					const auto process_index2 = i % process_count;
+					work[process_index2]++;
+					scheduler.notify(process_index2);
+				}
+				produced_all = true;
+				for(int process_index2 = 0 ; process_index2 < process_count ; process_index2++){
+					scheduler.notify(process_index2);
+				}
+			});
+		});
+
+		if(busy[process_index]++ != 0){
+			overlaps++;
+		}
+		const bool last = produced_all;
+		consumed += work[process_index].exchange(0);
+		busy[process_index]--;
+		return last ? process_scheduler_t::slice_result::k_done : process_scheduler_t::slice_result::k_idle;
+	});
+	producer.join();
+	QUARK_UT_VERIFY(overlaps == 0);
+	QUARK_UT_VERIFY(consumed == 10000);
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "run()", "started", "notify() from a thread started by started reaches the processes"){
+	process_scheduler_t scheduler(2);
+	std::atomic<int> work(0);
+	std::thread producer;
+
+	//	Before run(): ignored.
+	scheduler.notify(0);
+
+	scheduler.run(
+		1,
+		[&](int worker_index, int process_index){
+			return work == 100 ? process_scheduler_t::slice_result::k_done : process_scheduler_t::slice_result::k_idle;
+		},
+		[&](){
+			producer = std::thread([&](){
+				for(int i = 0 ; i < 100 ; i++){
+					work++;
+					scheduler.notify(0);
+				}
+			});
+		}
+	);
+	producer.join();
+	QUARK_UT_VERIFY(work == 100);
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "cancel()", "before run()", "run() throws without running any slice"){
+	process_scheduler_t scheduler(2);
+	scheduler.cancel(std::make_exception_ptr(std::runtime_error("early")));
+
+	std::atomic<int> slices(0);
+	try {
+		scheduler.run(10, [&](int worker_index, int process_index){
+			slices++;
+			return process_scheduler_t::slice_result::k_idle;
+		});
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()) == "early");
+	}
+	QUARK_UT_VERIFY(slices == 0);
+
+	//	Only that run() was cancelled.
+	scheduler.run(10, [&](int worker_index, int process_index){
+		slices++;
+		return process_scheduler_t::slice_result::k_done;
+	});
+	QUARK_UT_VERIFY(slices == 10);
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "run()", "slice throws", "exception reaches caller"){
+	process_scheduler_t scheduler(3);
+	try {
+		scheduler.run(10, [&](int worker_index, int process_index){
+			if(process_index == 5){
+				throw std::runtime_error("five");
+			}
+			return process_scheduler_t::slice_result::k_idle;
+		});
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()) == "five");
+	}
+}
+
+
+}
@@ -0,0 +1,143 @@
+//
+//  process_scheduler.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-03-04.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef process_scheduler_h
+#define process_scheduler_h
+
+/*
+	Runs many long-lived processes (actors) on a fixed set of worker threads: M processes on N threads.
+
+	The scheduler doesn't know about inboxes or messages. The client keeps those and calls notify() when a
+	process gets more work. The scheduler then makes sure the process gets a time slice on some worker,
+	calling run_slice_f. A process is never run by two workers at the same time, and a notify() that arrives
+	while the process is running makes it run again afterwards, so no wakeup is lost.
+
+	Each worker owns a run queue of process indexes. It takes its own work FIFO from the front, so processes
+	on one worker take turns, and steals from the back of the other workers' queues when it runs dry.
+	notify() from inside a slice puts the process on the calling worker's queue: a receiver tends to run on
+	the same core as its sender, where the message is still in the cache. Workers with nothing to do sleep
+	on an eventcount, so notify() only makes a syscall when it has to wake one.
+*/
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <exception>
+
+#include "eventcount.h"
+
+namespace floyd {
+
+
+struct process_scheduler_t {
+	public: enum class slice_result {
+		//	The process has no more work right now. It runs again after the next notify().
+		k_idle,
+
+		//	The process still has work but gives up the worker to let other processes run.
+		k_yield,
+
+		//	The process has terminated. It will never run again and notify() on it is ignored.
+		k_done
+	};
+
+	public: typedef std::function<slice_result(int worker_index, int process_index)> run_slice_f;
+	public: typedef std::function<void()> started_f;
+
+	public: explicit process_scheduler_t(int worker_count);
+	public: ~process_scheduler_t();
+	public: process_scheduler_t(const process_scheduler_t& other) = delete;
+	public: process_scheduler_t& operator=(const process_scheduler_t& other) = delete;
+
+	public: int get_worker_count() const;
+
+	//	Runs processes [0, process_count) until all of them have returned k_done. Each process gets a first
+	//	slice without a notify(). Blocks the calling thread, which is not one of the workers.
+	//	started is called on the calling thread once every process is queued: from there on notify() reaches
+	//	them. Use it to start threads that feed the processes.
+	//	If a slice or started throws, the remaining processes are abandoned and the first exception is rethrown here.
+	public: void run(int process_count, const run_slice_f& f, const started_f& started = nullptr);
+
+	//	Ends a run() from outside, like when something the processes depend on has failed. run() rethrows e once the
+	//	running slices have finished. Called when no run() is going, the next run() ends at once and throws e.
+	public: void cancel(std::exception_ptr e);
+
+	//	Makes process_index runnable. Can be called from any thread, also from inside a slice. Ignored when no
+	//	run() is going: before run() every process is about to get its first slice anyway.
+	public: void notify(int process_index);
+
+
+	////////////////////////		INTERNALS
+
+	private: enum process_state {
+		k_idle,
+		k_queued,
+		k_running,
+
+		//	Running, and notify() was called since the slice started.
+		k_running_notified,
+
+		k_done
+	};
+
+	private: struct worker_t {
+		std::mutex _mutex;
+		std::deque<int> _run_queue;
+		std::thread _thread;
+	};
+
+	private: void worker_loop(int worker_index);
+	private: bool try_run_one(int worker_index);
+	private: void run_slice(int worker_index, int process_index);
+	private: void enqueue(int worker_index, int process_index);
+	private: void finish(int process_index);
+	private: void finish_if_idle(int process_index);
+	private: void abort(std::exception_ptr e);
+
+
+	////////////////////////		STATE
+
+	private: std::vector<std::unique_ptr<worker_t>> _workers;
+
+	private: const run_slice_f* _f;
+	private: std::unique_ptr<std::atomic<int>[]> _process_states;
+
+	//	Set by run() once _process_states is ready, 0 otherwise. notify() looks at nothing else before that.
+	private: std::atomic<int> _process_count;
+
+	//	Processes sitting in the run queues, not counting those already running.
+	private: std::atomic<int> _queued_count;
+	private: std::atomic<int> _live_count;
+	private: std::atomic<unsigned int> _next_worker;
+
+	//	Idle workers park here. Enqueuing work is lock-free unless a worker is asleep.
+	private: eventcount_t _wake;
+	private: std::atomic<bool> _stop;
+
+	private: std::mutex _done_mutex;
+	private: std::condition_variable _done;
+
+	//	Set when a slice has thrown or cancel() was called: the rest of the processes are terminated without
+	//	running. Cleared when run() returns.
+	private: std::atomic<bool> _aborted;
+	private: std::exception_ptr _exception;
+};
+
+
+//	Worker count for a scheduler that runs process_count processes on this computer.
+int get_process_worker_count(int process_count);
+
+
+}
+
+#endif /* process_scheduler_h */
@@ -0,0 +1,345 @@
+//
+//  task_pool.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-02-18.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "task_pool.h"
+
+#include "quark.h"
+
+#include <exception>
+#include <algorithm>
+
+namespace floyd {
+
+
+//	Which pool + worker the current thread belongs to. Null / -1 on threads not owned by a pool.
+static thread_local const task_pool_t* tl_pool = nullptr;
+static thread_local int tl_worker_index = -1;
+
+
+struct task_pool_t::batch_t {
+	const dynamic_task_f* _f;
+
+	//	Only decremented while holding _mutex, so the batch can't be destroyed while a worker still touches it.
+	std::atomic<int> _remaining;
+	std::mutex _mutex;
+	std::condition_variable _done;
+	std::exception_ptr _exception;
+};
+
+
+task_pool_t::task_pool_t(int worker_count) :
+	_queued_count(0),
+	_stop(false)
+{
+	QUARK_ASSERT(worker_count > 0);
+
+	for(int i = 0 ; i < worker_count ; i++){
+		_workers.push_back(std::make_unique<worker_t>());
+	}
+	for(int i = 0 ; i < worker_count ; i++){
+		_workers[i]->_thread = std::thread([this, i](){ worker_loop(i); });
+	}
+}
+
+task_pool_t::~task_pool_t(){
+	{
+		std::lock_guard<std::mutex> lock(_wake_mutex);
+		_stop = true;
+	}
+	_wake.notify_all();
+
+	for(auto& w: _workers){
+		w->_thread.join();
+	}
+}
+
+int task_pool_t::get_worker_count() const {
+	return static_cast<int>(_workers.size());
+}
+
+void task_pool_t::run_batch(int task_count, const task_f& f){
+	QUARK_ASSERT(task_count >= 0);
+
+	std::vector<int> task_indexes(task_count);
+	for(int i = 0 ; i < task_count ; i++){
+		task_indexes[i] = i;
+	}
+	const dynamic_task_f f2 = [&f](int worker_index, int task_index, const spawn_f& spawn){
+		f(worker_index, task_index);
+	};
+	run_dynamic_batch(task_indexes, f2);
+}
+
+void task_pool_t::run_dynamic_batch(const std::vector<int>& initial_task_indexes, const dynamic_task_f& f){
+	const auto task_count = static_cast<int>(initial_task_indexes.size());
+	if(task_count == 0){
+		return;
+	}
+
+	batch_t batch;
+	batch._f = &f;
+	batch._remaining = task_count;
+
+	const int caller_worker_index = tl_pool == this ? tl_worker_index : -1;
+
+	//	Nested batch: keep it on our own deque, other workers steal from it when idle.
+	if(caller_worker_index != -1){
+		auto& w = *_workers[caller_worker_index];
+		std::lock_guard<std::mutex> lock(w._mutex);
+		for(const auto task_index: initial_task_indexes){
+			w._tasks.push_back(task_t{ &batch, task_index });
+		}
+	}
+
+	//	Spread the tasks between the workers, in contiguous runs.
+	else{
+		const auto worker_count = get_worker_count();
+		for(int wi = 0 ; wi < worker_count ; wi++){
+			const auto begin = task_count * wi / worker_count;
+			const auto end = task_count * (wi + 1) / worker_count;
+			auto& w = *_workers[wi];
+			std::lock_guard<std::mutex> lock(w._mutex);
+			for(int i = begin ; i < end ; i++){
+				w._tasks.push_back(task_t{ &batch, initial_task_indexes[i] });
+			}
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_wake_mutex);
+		_queued_count += task_count;
+	}
+	_wake.notify_all();
+
+	//	Help out while waiting, but only with our own batch: running some other task here would nest it inside
+	//	the task that called us, on the same worker_index.
+	if(caller_worker_index != -1){
+		while(batch._remaining > 0){
+			if(try_run_one(caller_worker_index, &batch) == false){
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(batch._mutex);
+		batch._done.wait(lock, [&](){ return batch._remaining == 0; });
+	}
+
+	if(batch._exception){
+		std::rethrow_exception(batch._exception);
+	}
+}
+
+void task_pool_t::worker_loop(int worker_index){
+	tl_pool = this;
+	tl_worker_index = worker_index;
+
+	while(true){
+		if(try_run_one(worker_index, nullptr) == false){
+			std::unique_lock<std::mutex> lock(_wake_mutex);
+			_wake.wait(lock, [&](){ return _stop || _queued_count > 0; });
+			if(_stop && _queued_count == 0){
+				return;
+			}
+		}
+	}
+}
+
+bool task_pool_t::try_run_one(int worker_index, const batch_t* only_batch){
+	const auto worker_count = get_worker_count();
+
+	//	Own deque first, newest task. Then steal the oldest task from the others.
+	for(int i = 0 ; i < worker_count ; i++){
+		const auto victim_index = (worker_index + i) % worker_count;
+		auto& victim = *_workers[victim_index];
+
+		bool found = false;
+		task_t task;
+		{
+			std::lock_guard<std::mutex> lock(victim._mutex);
+			if(only_batch == nullptr){
+				if(victim._tasks.empty() == false){
+					if(i == 0){
+						task = victim._tasks.back();
+						victim._tasks.pop_back();
+					}
+					else{
+						task = victim._tasks.front();
+						victim._tasks.pop_front();
+					}
+					found = true;
+				}
+			}
+			else{
+				if(i == 0){
+					const auto it = std::find_if(victim._tasks.rbegin(), victim._tasks.rend(), [&](const task_t& t){ return t._batch == only_batch; });
+					if(it != victim._tasks.rend()){
+						task = *it;
+						victim._tasks.erase(std::next(it).base());
+						found = true;
+					}
+				}
+				else{
+					const auto it = std::find_if(victim._tasks.begin(), victim._tasks.end(), [&](const task_t& t){ return t._batch == only_batch; });
+					if(it != victim._tasks.end()){
+						task = *it;
+						victim._tasks.erase(it);
+						found = true;
+					}
+				}
+			}
+		}
+		if(found){
+			_queued_count--;
+			execute_task(worker_index, task);
+			return true;
+		}
+	}
+	return false;
+}
+
+void task_pool_t::execute_task(int worker_index, const task_t& task){
+	auto& batch = *task._batch;
+
+	//	The running task keeps _remaining above 0, so the batch can't complete while we add to it.
+	const spawn_f spawn = [&](int task_index){
+		batch._remaining++;
+		{
+			auto& w = *_workers[worker_index];
+			std::lock_guard<std::mutex> lock(w._mutex);
+			w._tasks.push_back(task_t{ &batch, task_index });
+		}
+		{
+			std::lock_guard<std::mutex> lock(_wake_mutex);
+			_queued_count++;
+		}
+		_wake.notify_one();
+	};
+
+	try {
+		(*batch._f)(worker_index, task._task_index, spawn);
+	}
+	catch(...){
+		std::lock_guard<std::mutex> lock(batch._mutex);
+		if(!batch._exception){
+			batch._exception = std::current_exception();
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(batch._mutex);
+	batch._remaining--;
+	if(batch._remaining == 0){
+		batch._done.notify_all();
+	}
+}
+
+
+//	Set by shared_task_pool_override_t.
+static std::atomic<task_pool_t*> g_shared_task_pool_override(nullptr);
+
+task_pool_t& get_shared_task_pool(){
+	const auto override_pool = g_shared_task_pool_override.load();
+	if(override_pool != nullptr){
+		return *override_pool;
+	}
+
+	static task_pool_t pool(std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+	return pool;
+}
+
+
+shared_task_pool_override_t::shared_task_pool_override_t(int worker_count) :
+	_pool(worker_count),
+	_prev(g_shared_task_pool_override.exchange(&_pool))
+{
+}
+
+shared_task_pool_override_t::~shared_task_pool_override_t(){
+	g_shared_task_pool_override = _prev;
+}
+
+
+
+QUARK_UNIT_TEST("task_pool_t", "run_batch()", "", ""){
+	task_pool_t pool(4);
+	std::vector<int> result(1000, 0);
+	pool.run_batch(1000, [&](int worker_index, int task_index){ result[task_index] = task_index * 2; });
+	for(int i = 0 ; i < 1000 ; i++){
+		QUARK_UT_VERIFY(result[i] == i * 2);
+	}
+}
+
+QUARK_UNIT_TEST("task_pool_t", "run_batch()", "nested batches", ""){
+	task_pool_t pool(2);
+	std::atomic<int> count(0);
+	pool.run_batch(8, [&](int worker_index, int task_index){
+		pool.run_batch(8, [&](int worker_index2, int task_index2){
+			QUARK_UT_VERIFY(worker_index2 >= 0 && worker_index2 < 2);
+			count++;
+		});
+	});
+	QUARK_UT_VERIFY(count == 64);
+}
+
+QUARK_UNIT_TEST("task_pool_t", "run_batch()", "nested batches", "worker_index never runs two tasks of a batch at once"){
+	task_pool_t pool(3);
+	std::vector<std::atomic<int>> busy(3);
+	std::atomic<int> overlaps(0);
+	pool.run_batch(12, [&](int worker_index, int task_index){
+		if(busy[worker_index]++ != 0){
+			overlaps++;
+		}
+		pool.run_batch(12, [&](int worker_index2, int task_index2){});
+		busy[worker_index]--;
+	});
+	QUARK_UT_VERIFY(overlaps == 0);
+}
+
+QUARK_UNIT_TEST("task_pool_t", "run_dynamic_batch()", "chain of spawned tasks", ""){
+	task_pool_t pool(3);
+	std::vector<int> result(100, 0);
+	pool.run_dynamic_batch({ 0, 50 }, [&](int worker_index, int task_index, const task_pool_t::spawn_f& spawn){
+		result[task_index] = 1;
+		if(task_index + 1 != 50 && task_index + 1 != 100){
+			spawn(task_index + 1);
+		}
+	});
+	QUARK_UT_VERIFY(std::count(result.begin(), result.end(), 1) == 100);
+}
+
+QUARK_UNIT_TEST("task_pool_t", "run_batch()", "task throws", "exception reaches caller"){
+	task_pool_t pool(3);
+	std::atomic<int> count(0);
+	try {
+		pool.run_batch(10, [&](int worker_index, int task_index){
+			count++;
+			if(task_index == 5){
+				throw std::runtime_error("five");
+			}
+		});
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()) == "five");
+	}
+	QUARK_UT_VERIFY(count == 10);
+}
+
+QUARK_UNIT_TEST("task_pool_t", "shared_task_pool_override_t", "", "shared pool has the override's size, then the old pool is back"){
+	auto& shared = get_shared_task_pool();
+	{
+		const shared_task_pool_override_t pool(3);
+		QUARK_UT_VERIFY(get_shared_task_pool().get_worker_count() == 3);
+		QUARK_UT_VERIFY(&get_shared_task_pool() != &shared);
+	}
+	QUARK_UT_VERIFY(&get_shared_task_pool() == &shared);
+}
+
+
+}
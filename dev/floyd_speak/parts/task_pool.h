@@ -0,0 +1,112 @@
+//
+//  task_pool.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-02-18.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef task_pool_h
+#define task_pool_h
+
+/*
+	A fixed set of worker threads that executes batches of small tasks.
+
+	Each worker owns a deque of tasks. It takes its own work LIFO from the back and, when it runs dry,
+	steals FIFO from the front of the other workers' deques. This keeps chunks of the same batch together
+	on one core while still balancing uneven work between the cores.
+
+	run_batch() blocks until all tasks in the batch are done. When it's called from one of the pool's own
+	workers (a task that starts a nested batch) the calling worker keeps executing tasks of that nested batch
+	while it waits, so the pool never deadlocks on itself.
+*/
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+namespace floyd {
+
+
+struct task_pool_t {
+	//	worker_index is in the range [0, get_worker_count()). Tasks of one batch with the same worker_index run
+	//	one after another on the same thread, never at the same time, so it can be used to index per-worker state.
+	public: typedef std::function<void(int worker_index, int task_index)> task_f;
+
+	//	Adds another task to the batch that is running the calling task.
+	public: typedef std::function<void(int task_index)> spawn_f;
+	public: typedef std::function<void(int worker_index, int task_index, const spawn_f& spawn)> dynamic_task_f;
+
+	public: explicit task_pool_t(int worker_count);
+	public: ~task_pool_t();
+	public: task_pool_t(const task_pool_t& other) = delete;
+	public: task_pool_t& operator=(const task_pool_t& other) = delete;
+
+	public: int get_worker_count() const;
+
+	//	Calls f(worker_index, task_index) for each task_index in [0, task_count). Returns when all are done.
+	//	If tasks throw, the first exception is rethrown here, after the other tasks have finished.
+	public: void run_batch(int task_count, const task_f& f);
+
+	//	Like run_batch() but starts with the tasks in initial_task_indexes, and running tasks can add more tasks
+	//	to the batch using spawn(). Spawned tasks go on the spawning worker's own deque. Returns when all tasks,
+	//	spawned ones included, are done.
+	public: void run_dynamic_batch(const std::vector<int>& initial_task_indexes, const dynamic_task_f& f);
+
+
+	////////////////////////		INTERNALS
+
+	private: struct batch_t;
+	private: struct task_t {
+		batch_t* _batch;
+		int _task_index;
+	};
+	private: struct worker_t {
+		std::mutex _mutex;
+		std::deque<task_t> _tasks;
+		std::thread _thread;
+	};
+
+	private: void worker_loop(int worker_index);
+	private: bool try_run_one(int worker_index, const batch_t* only_batch);
+	private: void execute_task(int worker_index, const task_t& task);
+
+
+	////////////////////////		STATE
+
+	private: std::vector<std::unique_ptr<worker_t>> _workers;
+
+	//	Number of tasks sitting in the worker's deques, not counting those already executing.
+	private: std::atomic<int> _queued_count;
+
+	private: std::mutex _wake_mutex;
+	private: std::condition_variable _wake;
+	private: bool _stop;
+};
+
+
+//	One pool for the whole process, sized to the number of hardware threads. Created on first use.
+task_pool_t& get_shared_task_pool();
+
+
+//	For tests: while one of these is alive, get_shared_task_pool() returns its own pool of worker_count workers.
+//	This makes the parallel paths run on machines with a single hardware thread. Don't nest them across threads.
+struct shared_task_pool_override_t {
+	public: explicit shared_task_pool_override_t(int worker_count);
+	public: ~shared_task_pool_override_t();
+	public: shared_task_pool_override_t(const shared_task_pool_override_t& other) = delete;
+	public: shared_task_pool_override_t& operator=(const shared_task_pool_override_t& other) = delete;
+
+	private: task_pool_t _pool;
+	private: task_pool_t* _prev;
+};
+
+
+}
+
+#endif /* task_pool_h */
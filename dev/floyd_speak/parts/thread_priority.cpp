@@ -0,0 +1,55 @@
+//
+//  thread_priority.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-03-08.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "thread_priority.h"
+
+#include "quark.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <mach/thread_act.h>
+#endif
+
+namespace floyd {
+
+
+bool make_current_thread_realtime(){
+#ifndef __EMSCRIPTEN__
+	//	Middle of the range: above every normal thread, below the OS's own real-time threads.
+	sched_param param;
+	param.sched_priority = (sched_get_priority_min(SCHED_FIFO) + sched_get_priority_max(SCHED_FIFO)) / 2;
+	return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#else
+	return false;
+#endif
+}
+
+bool pin_current_thread_to_cpu(int cpu){
+	QUARK_ASSERT(cpu >= 0);
+
+#if defined(__linux__)
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#elif defined(__APPLE__)
+	//	Threads with the same tag share an L2, different tags are spread out. 0 means no tag.
+	thread_affinity_policy_data_t policy = { cpu + 1 };
+	const auto thread = pthread_mach_thread_np(pthread_self());
+	return thread_policy_set(thread, THREAD_AFFINITY_POLICY, (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT) == KERN_SUCCESS;
+#else
+	return false;
+#endif
+}
+
+
+}
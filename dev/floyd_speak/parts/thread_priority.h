@@ -0,0 +1,30 @@
+//
+//  thread_priority.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-03-08.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef thread_priority_h
+#define thread_priority_h
+
+/*
+	Controls how the OS schedules the calling thread. Used for threads with deadlines, like an audio clock.
+	Both functions return false when the OS refuses, usually because the process lacks the privileges. Then the
+	thread keeps running as before: callers treat these as best effort.
+*/
+
+namespace floyd {
+
+
+//	Fixed real-time priority, SCHED_FIFO: the thread preempts all normal threads until it blocks.
+bool make_current_thread_realtime();
+
+//	Only run the thread on one logical CPU. On macOS this is only an affinity hint.
+bool pin_current_thread_to_cpu(int cpu);
+
+
+}
+
+#endif /* thread_priority_h */
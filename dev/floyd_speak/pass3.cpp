@@ -143,15 +143,16 @@ std::pair<const symbol_t*, floyd::variable_address_t> resolve_env_variable_deep(
 	QUARK_ASSERT(depth >= 0 && depth < a._lexical_scope_stack.size());
 	QUARK_ASSERT(s.size() > 0);
 
+	//	Search from the back: a global that shadows a host function comes after it.
     const auto it = std::find_if(
-    	a._lexical_scope_stack[depth].symbols._symbols.begin(),
-    	a._lexical_scope_stack[depth].symbols._symbols.end(),
+    	a._lexical_scope_stack[depth].symbols._symbols.rbegin(),
+    	a._lexical_scope_stack[depth].symbols._symbols.rend(),
     	[&s](const std::pair<std::string, floyd::symbol_t>& e) { return e.first == s; }
 	);
 
-	if(it != a._lexical_scope_stack[depth].symbols._symbols.end()){
+	if(it != a._lexical_scope_stack[depth].symbols._symbols.rend()){
 		const auto parent_index = depth == 0 ? -1 : (int)(a._lexical_scope_stack.size() - depth - 1);
-		const auto variable_index = (int)(it - a._lexical_scope_stack[depth].symbols._symbols.begin());
+		const auto variable_index = (int)(a._lexical_scope_stack[depth].symbols._symbols.rend() - it - 1);
 		return { &it->second, floyd::variable_address_t::make_variable_address(parent_index, variable_index) };
 	}
 	else if(depth > 0){
@@ -169,8 +170,19 @@ std::pair<const symbol_t*, floyd::variable_address_t> find_symbol_by_name(const
 	return resolve_env_variable_deep(a, static_cast<int>(a._lexical_scope_stack.size() - 1), s);
 }
 
+bool is_host_function_symbol(const analyser_t& a, const symbol_t& symbol){
+	return symbol._const_value.is_function()
+		&& function_id_to_def(a, symbol._const_value.get_function_value())._host_function_id != k_no_host_function_id;
+}
+
+//	Host functions don't count: user definitions may shadow them, so adding a host function never breaks a program
+//	that already uses that name.
 bool does_symbol_exist_shallow(const analyser_t& a, const std::string& s){
-    const auto it = std::find_if(a._lexical_scope_stack.back().symbols._symbols.begin(), a._lexical_scope_stack.back().symbols._symbols.end(),  [&s](const std::pair<std::string, floyd::symbol_t>& e) { return e.first == s; });
+    const auto it = std::find_if(
+    	a._lexical_scope_stack.back().symbols._symbols.begin(),
+    	a._lexical_scope_stack.back().symbols._symbols.end(),
+    	[&](const std::pair<std::string, floyd::symbol_t>& e) { return e.first == s && is_host_function_symbol(a, e.second) == false; }
+	);
 	return it != a._lexical_scope_stack.back().symbols._symbols.end();
 }
 
@@ -1772,6 +1784,9 @@ semantic_ast_t analyse(const analyser_t& a){
 		symbol_map.push_back({function_name, symbol_t::make_constant(function_value)});
 	}
 
+	//	Declared here and not in k_builtin_types_and_constants, its member name can't be written in Floyd.
+	symbol_map.push_back({"channel_t", symbol_t::make_constant(value_t::make_typeid_value(make__channel_t__type()))});
+
 	//	"null" is equivalent to json_value::null
 	symbol_map.push_back({"null", symbol_t::make_constant(value_t::make_json_value(json_t()))});
 
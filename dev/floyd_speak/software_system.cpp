@@ -8,6 +8,9 @@
 
 #include "software_system.h"
 
+#include <sstream>
+#include <cstdlib>
+
 
 using std::string;
 using std::vector;
@@ -26,16 +29,42 @@ vector<person_t> unpack_persons(const json_t& persons_obj){
 }
 
 
+/*
+	"timer": { "period_ms": 2.9, "realtime": true, "cpu": 3 }
+*/
+clock_timer_t unpack_clock_timer(const json_t& timer_obj){
+	const auto period_ms = timer_obj.get_object_element("period_ms").get_number();
+	if(period_ms <= 0.0){
+		quark::throw_runtime_error("Clock timer needs a period_ms above 0.");
+	}
+	const auto cpu = static_cast<int>(timer_obj.get_optional_object_element("cpu", json_t(-1.0)).get_number());
+	if(cpu < -1){
+		quark::throw_runtime_error("Clock timer cpu must be a CPU index.");
+	}
+	return clock_timer_t{
+		._period_ms = period_ms,
+		._realtime = timer_obj.get_optional_object_element("realtime", json_t(false)).is_true(),
+		._cpu = cpu
+	};
+}
+
+//	Each member is a process: "process name": "process function". "timer" is an object that configures the clock instead.
 clock_bus_t unpack_clock_bus(const json_t& clock_bus_obj){
 	std::map<std::string, std::string> processes;
+	clock_timer_t timer;
 
 	const auto processes_map = clock_bus_obj.get_object();
 	for(const auto& process_pair: processes_map){
 		const auto name_key = process_pair.first;
-		const auto process_function_key = process_pair.second.get_string();
-		processes.insert({name_key, process_function_key} );
+		if(name_key == "timer" && process_pair.second.is_object()){
+			timer = unpack_clock_timer(process_pair.second);
+		}
+		else{
+			const auto process_function_key = process_pair.second.get_string();
+			processes.insert({name_key, process_function_key} );
+		}
 	}
-	return clock_bus_t{._processes = processes};
+	return clock_bus_t{._processes = processes, ._timer = timer};
 }
 
 std::map<std::string, clock_bus_t> unpack_clock_busses(const json_t& clocks_obj){
@@ -48,6 +77,72 @@ std::map<std::string, clock_bus_t> unpack_clock_busses(const json_t& clocks_obj)
 	}
 	return result;
 }
+/*
+	"probes_and_tweakers": {
+		"memoize": { "fib": 1000, "lookup": 500 }
+	}
+*/
+std::map<std::string, int64_t> unpack_memoize_tweaks(const json_t& probes_and_tweakers_obj){
+	std::map<std::string, int64_t> result;
+	const auto memoize_obj = probes_and_tweakers_obj.get_optional_object_element("memoize", json_t::make_object());
+	for(const auto& e: memoize_obj.get_object()){
+		const auto max_entries = static_cast<int64_t>(e.second.get_number());
+		if(max_entries <= 0){
+			quark::throw_runtime_error("Memoize tweaker needs a max entry count above 0.");
+		}
+		result.insert({ e.first, max_entries });
+	}
+	return result;
+}
+
+/*
+	"inboxes": {
+		"gui": { "capacity": 64, "policy": "drop_oldest" },
+		"sensor": { "capacity": 16, "policy": "coalesce", "key": "sensor_id" }
+	}
+*/
+std::map<std::string, inbox_config_t> unpack_inboxes(const json_t& inboxes_obj){
+	const std::map<std::string, inbox_policy> policies = {
+		{ "block", inbox_policy::k_block },
+		{ "drop_oldest", inbox_policy::k_drop_oldest },
+		{ "drop_newest", inbox_policy::k_drop_newest },
+		{ "coalesce", inbox_policy::k_coalesce }
+	};
+
+	std::map<std::string, inbox_config_t> result;
+	for(const auto& e: inboxes_obj.get_object()){
+		const auto capacity = static_cast<int64_t>(e.second.get_object_element("capacity").get_number());
+		if(capacity <= 0){
+			quark::throw_runtime_error("Inbox needs a capacity above 0.");
+		}
+		const auto policy_str = e.second.get_optional_object_element("policy", json_t("block")).get_string();
+		const auto policy_it = policies.find(policy_str);
+		if(policy_it == policies.end()){
+			quark::throw_runtime_error("Unknown inbox policy \"" + policy_str + "\", use block, drop_oldest, drop_newest or coalesce.");
+		}
+		const auto key = e.second.get_optional_object_element("key", json_t("")).get_string();
+		result.insert({ e.first, inbox_config_t{ capacity, policy_it->second, key } });
+	}
+	return result;
+}
+
+/*
+	"batches": {
+		"telemetry": 256
+	}
+*/
+std::map<std::string, int64_t> unpack_batch_sizes(const json_t& batches_obj){
+	std::map<std::string, int64_t> result;
+	for(const auto& e: batches_obj.get_object()){
+		const auto max_messages = static_cast<int64_t>(e.second.get_number());
+		if(max_messages <= 0){
+			quark::throw_runtime_error("Batch size needs to be above 0.");
+		}
+		result.insert({ e.first, max_messages });
+	}
+	return result;
+}
+
 container_t unpack_container(const json_t& container_obj){
 	return container_obj.get_object_size() == 0 ?
 		container_t{}
@@ -58,7 +153,10 @@ container_t unpack_container(const json_t& container_obj){
 		._tech = container_obj.get_object_element("tech").get_string(),
 		._clock_busses = unpack_clock_busses(container_obj.get_object_element("clocks")),
 		._connections = {},
-		._components = {}
+		._components = {},
+		._memoize_tweaks = unpack_memoize_tweaks(container_obj.get_optional_object_element("probes_and_tweakers", json_t::make_object())),
+		._inboxes = unpack_inboxes(container_obj.get_optional_object_element("inboxes", json_t::make_object())),
+		._batch_sizes = unpack_batch_sizes(container_obj.get_optional_object_element("batches", json_t::make_object()))
 	};
 }
 
@@ -89,3 +187,132 @@ software_system_t parse_software_system_json(const json_t& value){
 container_t parse_container_def_json(const json_t& value){
 	return unpack_container(value);
 }
+
+std::vector<std::string> get_channel_names(const container_t& container){
+	std::vector<std::string> result;
+	for(const auto& clock_bus: container._clock_busses){
+		for(const auto& process: clock_bus.second._processes){
+			result.push_back(process.first);
+		}
+	}
+	return result;
+}
+
+std::map<std::string, int64_t> parse_memoize_tweaks_arg(const std::string& arg){
+	std::map<std::string, int64_t> result;
+	std::stringstream ss(arg);
+	std::string e;
+	while(std::getline(ss, e, ',')){
+		if(e.empty()){
+			continue;
+		}
+		const auto colon = e.find(':');
+		if(colon == std::string::npos){
+			result.insert({ e, k_default_memoize_max_entries });
+		}
+		else{
+			const auto name = e.substr(0, colon);
+			const auto max_entries = std::atoll(e.substr(colon + 1).c_str());
+			if(name.empty() || max_entries <= 0){
+				quark::throw_runtime_error("Memoize tweaker must be written as function or function:max_entries.");
+			}
+			result.insert({ name, max_entries });
+		}
+	}
+	return result;
+}
+
+QUARK_UNIT_TEST("", "parse_memoize_tweaks_arg()", "", ""){
+	const auto result = parse_memoize_tweaks_arg("fib,lookup:500");
+	QUARK_UT_VERIFY(result.size() == 2);
+	QUARK_UT_VERIFY(result.at("fib") == k_default_memoize_max_entries);
+	QUARK_UT_VERIFY(result.at("lookup") == 500);
+}
+
+QUARK_UNIT_TEST("", "parse_container_def_json()", "probes_and_tweakers", ""){
+	const auto result = parse_container_def_json(
+		json_t::make_object({
+			{ "name", "test" },
+			{ "desc", "" },
+			{ "tech", "" },
+			{ "clocks", json_t::make_object() },
+			{ "probes_and_tweakers", json_t::make_object({ { "memoize", json_t::make_object({ { "fib", 200 } }) } }) }
+		})
+	);
+	QUARK_UT_VERIFY(result._memoize_tweaks.size() == 1);
+	QUARK_UT_VERIFY(result._memoize_tweaks.at("fib") == 200);
+}
+
+QUARK_UNIT_TEST("", "parse_container_def_json()", "clock timer", ""){
+	const auto result = parse_container_def_json(
+		json_t::make_object({
+			{ "name", "test" },
+			{ "desc", "" },
+			{ "tech", "" },
+			{ "clocks", json_t::make_object({
+				{ "audio", json_t::make_object({
+					{ "timer", json_t::make_object({ { "period_ms", 2.5 }, { "realtime", true }, { "cpu", 1 } }) },
+					{ "mixer", "audio_mixer" }
+				}) },
+				{ "main", json_t::make_object({ { "gui", "my_gui" } }) }
+			}) }
+		})
+	);
+	const auto& audio = result._clock_busses.at("audio");
+	QUARK_UT_VERIFY(audio._processes.size() == 1);
+	QUARK_UT_VERIFY(audio._processes.at("mixer") == "audio_mixer");
+	QUARK_UT_VERIFY(audio._timer._period_ms == 2.5);
+	QUARK_UT_VERIFY(audio._timer._realtime == true);
+	QUARK_UT_VERIFY(audio._timer._cpu == 1);
+	QUARK_UT_VERIFY(result._clock_busses.at("main")._timer._period_ms == 0.0);
+	QUARK_UT_VERIFY(result._clock_busses.at("main")._timer._cpu == -1);
+}
+
+QUARK_UNIT_TEST("", "parse_container_def_json()", "inboxes", ""){
+	const auto result = parse_container_def_json(
+		json_t::make_object({
+			{ "name", "test" },
+			{ "desc", "" },
+			{ "tech", "" },
+			{ "clocks", json_t::make_object() },
+			{ "inboxes", json_t::make_object({
+				{ "gui", json_t::make_object({ { "capacity", 64 }, { "policy", "drop_oldest" } }) },
+				{ "sensor", json_t::make_object({ { "capacity", 16 }, { "policy", "coalesce" }, { "key", "sensor_id" } }) }
+			}) }
+		})
+	);
+	QUARK_UT_VERIFY(result._inboxes.size() == 2);
+	QUARK_UT_VERIFY(result._inboxes.at("gui")._capacity == 64);
+	QUARK_UT_VERIFY(result._inboxes.at("gui")._policy == inbox_policy::k_drop_oldest);
+	QUARK_UT_VERIFY(result._inboxes.at("sensor")._policy == inbox_policy::k_coalesce);
+	QUARK_UT_VERIFY(result._inboxes.at("sensor")._coalesce_key == "sensor_id");
+}
+
+QUARK_UNIT_TEST("", "parse_container_def_json()", "batches", ""){
+	const auto result = parse_container_def_json(
+		json_t::make_object({
+			{ "name", "test" },
+			{ "desc", "" },
+			{ "tech", "" },
+			{ "clocks", json_t::make_object() },
+			{ "batches", json_t::make_object({ { "telemetry", 256 } }) }
+		})
+	);
+	QUARK_UT_VERIFY(result._batch_sizes.size() == 1);
+	QUARK_UT_VERIFY(result._batch_sizes.at("telemetry") == 256);
+}
+
+QUARK_UNIT_TEST("", "get_channel_names()", "", ""){
+	const auto result = parse_container_def_json(
+		json_t::make_object({
+			{ "name", "test" },
+			{ "desc", "" },
+			{ "tech", "" },
+			{ "clocks", json_t::make_object({
+				{ "b", json_t::make_object({ { "z", "f" }, { "y", "f" } }) },
+				{ "a", json_t::make_object({ { "x", "f" } }) }
+			}) }
+		})
+	);
+	QUARK_UT_VERIFY((get_channel_names(result) == std::vector<std::string>{ "x", "y", "z" }));
+}
@@ -31,9 +31,45 @@ struct connection_t {
 	std::string _tech_desc;
 };
 
+//	Makes a clock tick by itself at a fixed rate, like an audio or render clock. Each tick sends "tick" to all its processes.
+struct clock_timer_t {
+	//	0 = no timer: the clock only runs when its processes get messages.
+	double _period_ms = 0.0;
+
+	//	Run the clock on its own thread with fixed real-time priority (SCHED_FIFO), not on the shared worker threads.
+	bool _realtime = false;
+
+	//	Run the clock on its own thread, pinned to this logical CPU. -1 = don't pin.
+	int _cpu = -1;
+};
+
 struct clock_bus_t {
 	//	Right now an process is the name of the process-function, will probably get more members.
 	std::map<std::string, std::string> _processes;
+
+	clock_timer_t _timer;
+};
+
+//	What to do when a message arrives at a full inbox.
+enum class inbox_policy {
+	//	The sender waits until the receiver has taken messages. Only senders on other clocks: the receiver can't run
+	//	until a sender on its own clock has finished its tick, so that sender's message is dropped, like k_drop_newest.
+	k_block,
+
+	k_drop_oldest,
+	k_drop_newest,
+
+	//	A message replaces a waiting message with the same key, full or not. When full and no key matches: drop oldest.
+	k_coalesce
+};
+
+//	Limits how many messages can wait in one process's inbox. "stop" is never limited.
+struct inbox_config_t {
+	int64_t _capacity;
+	inbox_policy _policy;
+
+	//	k_coalesce: the struct member or JSON object key that identifies a message. Empty = the whole message.
+	std::string _coalesce_key;
 };
 
 struct container_t {
@@ -43,6 +79,15 @@ struct container_t {
 	std::map<std::string, clock_bus_t> _clock_busses;
 	std::vector<connection_t> _connections;
 	std::vector<std::string> _components;
+
+	//	Memoize tweakers: key is the name of a pure function, value is the max number of results to cache for it.
+	std::map<std::string, int64_t> _memoize_tweaks;
+
+	//	Key is the process name. Processes not listed have unbounded inboxes.
+	std::map<std::string, inbox_config_t> _inboxes;
+
+	//	Key is the process name, value is the max number of messages per call to its __batch function.
+	std::map<std::string, int64_t> _batch_sizes;
 };
 
 struct software_system_t {
@@ -56,6 +101,19 @@ struct software_system_t {
 software_system_t parse_software_system_json(const json_t& value);
 container_t parse_container_def_json(const json_t& value);
 
+//	Every process in the container has a channel ID: its index in this list. Clocks in name order, then their processes
+//	in name order. send() to a channel ID needs no name lookup.
+std::vector<std::string> get_channel_names(const container_t& container);
+
+/*
+	Parses memoize tweakers from the command line: "fib,lookup:500" = cache fib() with the default size, lookup()
+	with max 500 results.
+*/
+std::map<std::string, int64_t> parse_memoize_tweaks_arg(const std::string& arg);
+
+//	Max number of cached results when a memoize tweaker doesn't say.
+const int64_t k_default_memoize_max_entries = 1000;
+
 
 
 #endif /* software_system_hpp */